@@ -0,0 +1,166 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <config.h>
+#include <core/variable.h>
+#include <utils/array.h>
+#include <utils/file.h>
+#include <utils/string.h>
+
+#include "bench.h"
+
+double bench_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+size_t bench_arg(char **argv, const char *name, size_t fallback) {
+    size_t len = strlen(name);
+    for (size_t i = 0; argv && argv[i]; i++) {
+        if (strncmp(argv[i], "--", 2) == 0 && strncmp(argv[i] + 2, name, len) == 0 && argv[i][len + 2] == '=') {
+            return strtoul(argv[i] + len + 3, NULL, 10);
+        }
+    }
+    return fallback;
+}
+
+BenchRepository bench_repository_args(char **argv) {
+    BenchRepository shape;
+    shape.packages = bench_arg(argv, "packages", 5000);
+    shape.fanout = bench_arg(argv, "fanout", 3);
+    shape.group_depth = bench_arg(argv, "group-depth", 3);
+    shape.installed = bench_arg(argv, "installed", 200);
+    if (shape.installed > shape.packages) {
+        shape.installed = shape.packages;
+    }
+    return shape;
+}
+
+void bench_report(const char *suite, const char *name, size_t iterations, double seconds) {
+    double per_op = iterations ? seconds * 1e9 / iterations : 0;
+    printf("{\"suite\":\"%s\",\"name\":\"%s\",\"iterations\":%zu,\"seconds\":%.6f,\"ns_per_op\":%.1f}\n",
+           suite, name, iterations, seconds, per_op);
+    fflush(stdout);
+}
+
+// Knuth's MMIX linear congruential generator, the high bits are the good ones
+static uint64_t bench_random(uint64_t *state) {
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return *state >> 33;
+}
+
+size_t bench_dependency(size_t package, size_t nth) {
+    // Seeded with the package, so the first dependencies do not depend on nth
+    uint64_t state = package;
+    size_t picked[nth + 1];
+    for (size_t k = 0; k <= nth; k++) {
+        size_t dep = bench_random(&state) % package;
+        // Distinct while nth < package, a taken index moves to the next one
+        for (size_t j = 0; j < k; j++) {
+            if (picked[j] == dep) {
+                dep = (dep + 1) % package;
+                j = (size_t) -1;
+            }
+        }
+        picked[k] = dep;
+    }
+    return picked[nth];
+}
+
+size_t bench_fanout(BenchRepository shape, size_t package) {
+    return shape.fanout < package ? shape.fanout : package;
+}
+
+// Body of a package entry, indented by the given prefix
+static void bench_package(array *out, BenchRepository shape, size_t i, const char *indent) {
+    char line[256];
+    snprintf(line, sizeof(line),
+             "%sname: pkg-%zu\n%sversion: 1.%zu\n%srelease: 1\n%suri: p/pkg-%zu.ymp\n",
+             indent, i, indent, i, indent, indent, i);
+    array_add(out, line);
+    if (shape.group_depth > 0) {
+        snprintf(line, sizeof(line), "%sgroup:\n%s  - ", indent, indent);
+        array_add(out, line);
+        size_t level = i;
+        for (size_t d = 0; d < shape.group_depth; d++) {
+            snprintf(line, sizeof(line), d == 0 ? "g%zu" : ".g%zu", level % 4);
+            array_add(out, line);
+            level /= 4;
+        }
+        array_add(out, "\n");
+    }
+    if (i > 0 && shape.fanout > 0) {
+        snprintf(line, sizeof(line), "%sdepends:\n", indent);
+        array_add(out, line);
+        for (size_t d = 0; d < bench_fanout(shape, i); d++) {
+            snprintf(line, sizeof(line), "%s  - pkg-%zu\n", indent, bench_dependency(i, d));
+            array_add(out, line);
+        }
+    }
+}
+
+char *bench_repository_data(BenchRepository shape) {
+    array *out = array_new();
+    array_add(out, "index:\n  name: bench\n  address: http://127.0.0.1/$uri\n");
+    for (size_t i = 0; i < shape.packages; i++) {
+        array_add(out, "  package:\n");
+        bench_package(out, shape, i, "    ");
+    }
+    char *data = array_get_string(out);
+    array_unref(out);
+    return data;
+}
+
+char *bench_destdir(BenchRepository shape) {
+    char template[] = "/tmp/ymp-bench-XXXXXX";
+    if (!mkdtemp(template)) {
+        perror("mkdtemp");
+        return NULL;
+    }
+    char *path = strdup(template);
+
+    char *index_dir = build_string("%s/%s/index", path, STORAGE);
+    char *metadata_dir = build_string("%s/%s/metadata", path, STORAGE);
+    char *sources_dir = build_string("%s/%s/sources.list.d", path, STORAGE);
+    create_dir(index_dir);
+    create_dir(metadata_dir);
+    create_dir(sources_dir);
+
+    char *sources = build_string("%s/bench", sources_dir);
+    writefile(sources, "http://127.0.0.1/$uri\n");
+    free(sources);
+    free(sources_dir);
+
+    char *index = build_string("%s/bench.yaml", index_dir);
+    char *data = bench_repository_data(shape);
+    writefile(index, data);
+    free(data);
+    free(index);
+
+    // The first packages are installed, they only depend on each other
+    for (size_t i = 0; i < shape.installed; i++) {
+        array *out = array_new();
+        array_add(out, "ymp:\n  package:\n");
+        bench_package(out, shape, i, "    ");
+        char *meta = array_get_string(out);
+        char *target = build_string("%s/pkg-%zu.yaml", metadata_dir, i);
+        writefile(target, meta);
+        free(target);
+        free(meta);
+        array_unref(out);
+    }
+    free(index_dir);
+    free(metadata_dir);
+    return path;
+}
+
+void bench_destdir_remove(char *path) {
+    if (path) {
+        remove_all(path);
+        free(path);
+    }
+}
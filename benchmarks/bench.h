@@ -0,0 +1,124 @@
+#ifndef _bench_h
+#define _bench_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @file bench.h
+ * @brief Shared helpers of the benchmark programs
+ *
+ * Every measurement is printed as one JSON object per line, so results of
+ * two releases can be compared with a script:
+ *
+ * @code
+ * {"suite":"utils","name":"split","iterations":1000,"seconds":0.0123,"ns_per_op":12300.0}
+ * @endcode
+ */
+
+/**
+ * @brief Shape of a synthetic repository.
+ */
+typedef struct {
+    size_t packages;    /**< Number of packages. */
+    size_t fanout;      /**< Dependencies of each package. */
+    size_t group_depth; /**< Levels of the group names, like `g1.g2.g3`. */
+    size_t installed;   /**< Packages written as installed into the fake DESTDIR. */
+} BenchRepository;
+
+/**
+ * @brief Monotonic time in seconds.
+ */
+double bench_now();
+
+/**
+ * @brief Read a numeric `--name=value` argument.
+ *
+ * @param argv NULL terminated argument list.
+ * @param name Name of the argument without dashes.
+ * @param fallback Value used when the argument is missing.
+ * @return The value of the argument.
+ */
+size_t bench_arg(char **argv, const char *name, size_t fallback);
+
+/**
+ * @brief Read the repository shape from the arguments.
+ *
+ * Understands `--packages`, `--fanout`, `--group-depth` and `--installed`.
+ */
+BenchRepository bench_repository_args(char **argv);
+
+/**
+ * @brief Print one result line.
+ *
+ * @param suite Name of the benchmark program.
+ * @param name Name of the measurement.
+ * @param iterations Number of operations measured.
+ * @param seconds Time of all operations.
+ */
+void bench_report(const char *suite, const char *name, size_t iterations, double seconds);
+
+/**
+ * @brief Number of dependencies of a synthetic package.
+ *
+ * @param shape Shape of the repository.
+ * @param package Index of the package.
+ * @return `fanout`, or less for the first packages.
+ */
+size_t bench_fanout(BenchRepository shape, size_t package);
+
+/**
+ * @brief Dependency of a synthetic package.
+ *
+ * Deterministic, so every run generates the same repository.
+ *
+ * @param package Index of the package, not 0.
+ * @param nth Number of the dependency, less than bench_fanout().
+ * @return Index of the dependency, lower than `package`.
+ */
+size_t bench_dependency(size_t package, size_t nth);
+
+/**
+ * @brief Generate the index of a synthetic repository.
+ *
+ * Package `pkg-i` depends on `fanout` distinct packages with a lower index,
+ * so the dependency graph has no cycle. Every package is in one group named
+ * like `g1.g0.g2`, four groups on each level.
+ *
+ * @param shape Shape of the repository.
+ * @return Index data in the format of repository_load_from_data(). Free it.
+ */
+char *bench_repository_data(BenchRepository shape);
+
+/**
+ * @brief Create a fake DESTDIR with the repository index and installed packages.
+ *
+ * @param shape Shape of the repository.
+ * @return Path of the new directory. Remove it with bench_destdir_remove().
+ */
+char *bench_destdir(BenchRepository shape);
+
+/**
+ * @brief Remove a directory made by bench_destdir().
+ *
+ * @param path Path of the directory. It is freed.
+ */
+void bench_destdir_remove(char *path);
+
+/**
+ * @brief Measure a statement.
+ *
+ * Runs the statement `iterations` times and reports the total time. The
+ * statement can use `bench_i`, the number of the current iteration.
+ */
+#define bench_run(suite, name, iterations, ...)                           \
+    {                                                                     \
+        size_t bench_count = (iterations);                                \
+        double bench_begin = bench_now();                                 \
+        for (size_t bench_i = 0; bench_i < bench_count; bench_i++) {      \
+            __VA_ARGS__;                                                  \
+        }                                                                 \
+        bench_report(suite, name, bench_count, bench_now() - bench_begin); \
+    }
+
+#endif
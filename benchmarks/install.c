@@ -0,0 +1,313 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <config.h>
+#include <core/operations.h>
+#include <core/stats.h>
+#include <core/variable.h>
+#include <core/ymp.h>
+#include <data/build.h>
+#include <utils/array.h>
+#include <utils/file.h>
+#include <utils/hash.h>
+#include <utils/string.h>
+
+#include "bench.h"
+
+#define SUITE "install"
+
+// Phases reported after each step, see the trace_begin() calls of the library
+static const char *phases[] = {
+    "index load", "resolve", "download", "extract", "hash", "validate", "sync", NULL,
+};
+
+static Ymp *ymp;
+
+static void set(const char *name, const char *value) {
+    variable_set_value(ymp->variables, name, value);
+}
+
+// Run an operation like the command line does and report its wall time
+static bool step(const char *name, const char *operation, char **args, size_t packages) {
+    stats_reset();
+    double begin = bench_now();
+    int status = operation_main(ymp->manager, operation, args);
+    bench_report(SUITE, name, packages, bench_now() - begin);
+    for (size_t i = 0; phases[i]; i++) {
+        uint64_t count = 0;
+        uint64_t wall = stats_phase_get(phases[i], &count);
+        if (count > 0) {
+            char *phase = build_string("%s.%s", name, phases[i]);
+            bench_report(SUITE, phase, count, wall / 1e9);
+            free(phase);
+        }
+    }
+    if (status != 0) {
+        fprintf(stderr, "%s failed: %d\n", name, status);
+        return false;
+    }
+    return true;
+}
+
+// Package build directory, the layout build_binary_from_path() leaves behind
+static char *bench_package_dir(const char *work, BenchRepository shape, size_t i, size_t file_count, size_t file_size) {
+    char *dir = build_string("%s/build/pkg-%zu", work, i);
+    char *share = build_string("%s/output/usr/share/pkg-%zu", dir, i);
+    create_dir(share);
+
+    array *files = array_new();
+    char *data = malloc(file_size + 1);
+    for (size_t f = 0; f < file_count; f++) {
+        for (size_t b = 0; b < file_size; b++) {
+            data[b] = 'a' + (i + f + b) % 26;
+        }
+        data[file_size] = '\0';
+        char *path = build_string("%s/file-%zu", share, f);
+        writefile(path, data);
+        char *hash = calculate_hash(SHA1, path);
+        char *line = build_string("%s usr/share/pkg-%zu/file-%zu\n", hash, i, f);
+        array_add(files, line);
+        free(line);
+        free(hash);
+        free(path);
+    }
+    free(data);
+
+    // One relative symlink, links are "path target" lines
+    char *link = build_string("%s/current", share);
+    if (symlink("file-0", link) < 0) {
+        perror(link);
+    }
+    free(link);
+    char *links = build_string("/usr/share/pkg-%zu/current file-0\n", i);
+
+    array *metadata = array_new();
+    char *line = build_string("ymp:\n  package:\n    name: pkg-%zu\n    version: 1.%zu\n    release: 1\n"
+                              "    arch: %s\n    depends:\n",
+                              i, i, ARCH);
+    array_add(metadata, line);
+    free(line);
+    for (size_t d = 0; i > 0 && d < bench_fanout(shape, i); d++) {
+        line = build_string("      - pkg-%zu\n", bench_dependency(i, d));
+        array_add(metadata, line);
+        free(line);
+    }
+
+#define bench_write(name, content)                            \
+    {                                                         \
+        char *target = build_string("%s/%s", dir, name);      \
+        writefile(target, content);                           \
+        free(target);                                         \
+    }
+    char *text = array_get_string(metadata);
+    bench_write("metadata.yaml", text);
+    free(text);
+    text = array_get_string(files);
+    bench_write("files", text);
+    free(text);
+    bench_write("links", links);
+
+    free(links);
+    free(share);
+    array_unref(files);
+    array_unref(metadata);
+    return dir;
+}
+
+// Ask the kernel for a free port, the server binds it right after
+static int bench_free_port() {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    int port = 0;
+    if (fd >= 0 && bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0 &&
+        getsockname(fd, (struct sockaddr *) &addr, &len) == 0) {
+        port = ntohs(addr.sin_port);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    return port;
+}
+
+static bool bench_wait_port(int port) {
+    for (size_t i = 0; i < 500; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bool ok = connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0;
+        close(fd);
+        if (ok) {
+            return true;
+        }
+        usleep(10000);
+    }
+    return false;
+}
+
+static size_t bench_count_dir(const char *path) {
+    char **items = listdir(path);
+    size_t count = 0;
+    for (size_t i = 0; items && items[i]; i++) {
+        if (items[i][0] != '.') {
+            count++;
+        }
+        free(items[i]);
+    }
+    free(items);
+    return count;
+}
+
+int main(int argc, char **argv) {
+    (void) argc;
+    ymp = ymp_init();
+    stats_set_status(true);
+    BenchRepository shape = bench_repository_args(argv);
+    shape.packages = bench_arg(argv, "packages", 100);
+    size_t file_count = bench_arg(argv, "files", 20);
+    size_t file_size = bench_arg(argv, "file-size", 4096);
+    if (shape.packages == 0) {
+        return 1;
+    }
+
+    // The repository is served by the httpd plugin
+    Operation httpd = get_operation_by_name(ymp->manager, "httpd");
+#ifdef PLUGIN_SUPPORT
+    for (size_t i = 1; argv[i] && !httpd.call; i++) {
+        if (startswith(argv[i], "--httpd=")) {
+            load_plugin(ymp, argv[i] + 8);
+            httpd = get_operation_by_name(ymp->manager, "httpd");
+        }
+    }
+#endif
+    if (!httpd.call) {
+        fprintf(stderr, "httpd plugin not found, use --httpd=path/to/libymp_httpd.so\n");
+        return 77;  // skipped
+    }
+
+    char template[] = "/tmp/ymp-bench-XXXXXX";
+    if (!mkdtemp(template)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    char *mirror = build_string("%s/mirror", template);
+    char *root = build_string("%s/root", template);
+    create_dir(mirror);
+    create_dir(root);
+
+    // Build packages
+    int status = 1;
+    pid_t server = -1;
+    double begin = bench_now();
+    char **names = calloc(shape.packages + 1, sizeof(char *));
+    for (size_t i = 0; i < shape.packages; i++) {
+        names[i] = build_string("pkg-%zu", i);
+        char *dir = bench_package_dir(template, shape, i, file_count, file_size);
+        char *zip = create_package(dir);
+        char *target = build_string("%s/%s.ymp", mirror, names[i]);
+        bool created = zip && move_file(zip, target);
+        free(target);
+        free(zip);
+        free(dir);
+        if (!created) {
+            fprintf(stderr, "Failed to create package: %s\n", names[i]);
+            goto free_main;
+        }
+    }
+    bench_report(SUITE, "create_package", shape.packages, bench_now() - begin);
+
+    set("name", "bench");
+    set("repicent", "bench");
+    set("ignore-gpg", "true");
+    set("no-emerge", "true");
+    set("index", "true");
+    char *index_args[] = { mirror, NULL };
+    bool ok = step("index", "repo", index_args, shape.packages);
+    set("index", "false");
+    // Nothing signs the index without a key, verification is disabled anyway
+    char *signature = build_string("%s/ymp-index.yaml.gpg", mirror);
+    if (!isfile(signature)) {
+        writefile(signature, "");
+    }
+    free(signature);
+    if (!ok) {
+        goto free_main;
+    }
+
+    int port = bench_free_port();
+    server = fork();
+    if (server == 0) {
+        // Do not outlive a crashed benchmark
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+        char *port_str = build_string("%d", port);
+        set("source", mirror);
+        set("port", port_str);
+        char *no_args[] = { NULL };
+        _exit(operation_main(ymp->manager, "httpd", no_args));
+    }
+    if (server < 0 || !bench_wait_port(port)) {
+        fprintf(stderr, "Failed to start httpd on port %d\n", port);
+        goto free_main;
+    }
+
+    // Scratch system
+    set("DESTDIR", root);
+    char *uri = build_string("http://127.0.0.1:%d/$uri", port);
+    char *add_args[] = { uri, NULL };
+    set("add", "true");
+    ok = step("repo_add", "repo", add_args, 1);
+    set("add", "false");
+    free(uri);
+
+    char *no_args[] = { NULL };
+    set("update", "true");
+    ok = ok && step("update", "repo", no_args, 1);
+    set("update", "false");
+
+    ok = ok && step("install", "install", names, shape.packages);
+    char *metadata = build_string("%s/%s/metadata", root, STORAGE);
+    size_t installed = bench_count_dir(metadata);
+    if (ok && installed != shape.packages) {
+        fprintf(stderr, "Installed %zu of %zu packages\n", installed, shape.packages);
+        ok = false;
+    }
+
+    // Every package depends on pkg-0 through its dependencies
+    char *remove_args[] = { names[0], NULL };
+    ok = ok && step("remove", "remove", shape.fanout > 0 ? remove_args : names, shape.packages);
+    size_t left = bench_count_dir(metadata);
+    if (ok && left != 0) {
+        fprintf(stderr, "%zu packages left after remove\n", left);
+        ok = false;
+    }
+    free(metadata);
+    status = ok ? 0 : 1;
+
+free_main:
+    if (server > 0) {
+        kill(server, SIGTERM);
+        waitpid(server, NULL, 0);
+    }
+    for (size_t i = 0; names[i]; i++) {
+        free(names[i]);
+    }
+    free(names);
+    remove_all(template);
+    free(mirror);
+    free(root);
+    return status;
+}
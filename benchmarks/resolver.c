@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <core/ymp.h>
+#include <data/dependency.h>
+#include <data/repository.h>
+#include <utils/string.h>
+
+#include "bench.h"
+
+#define SUITE "resolver"
+
+static void bench_load(Ymp *ymp, BenchRepository shape) {
+    char *data = bench_repository_data(shape);
+    variable_set_value(ymp->variables, "compact-index", "false");
+    bench_run(SUITE, "repository_load_from_data", 3, {
+        Repository *repo = repository_new();
+        repository_load_from_data(repo, data);
+        repository_unref(repo);
+    });
+    variable_set_value(ymp->variables, "compact-index", "true");
+    bench_run(SUITE, "repository_load_from_data_compact", 3, {
+        Repository *repo = repository_new();
+        repository_load_from_data(repo, data);
+        repository_unref(repo);
+    });
+    free(data);
+}
+
+static void bench_resolve(BenchRepository shape) {
+    bench_run(SUITE, "resolve_begin", 1, (void) resolve_begin());
+    Repository **repos = resolve_begin();
+    if (!repos) {
+        return;
+    }
+    // Newest packages first, they have the deepest dependency trees
+    size_t count = shape.packages < 1000 ? shape.packages : 1000;
+    char **names = calloc(count, sizeof(char *));
+    for (size_t i = 0; i < count; i++) {
+        names[i] = build_string("pkg-%zu", shape.packages - 1 - i);
+    }
+    bench_run(SUITE, "resolve_dependency", count, (void) resolve_dependency(names[bench_i]));
+    bench_run(SUITE, "get_group_packages", 10, {
+        char **group = get_group_packages("@g1");
+        for (size_t i = 0; group && group[i]; i++) {
+            free(group[i]);
+        }
+        free(group);
+    });
+    // Reads every installed metadata file for each reverse dependency
+    bench_run(SUITE, "resolve_reverse_dependency", 1, (void) resolve_reverse_dependency("pkg-0"));
+    for (size_t i = 0; i < count; i++) {
+        free(names[i]);
+    }
+    free(names);
+    resolve_end(repos);
+}
+
+int main(int argc, char **argv) {
+    (void) argc;
+    Ymp *ymp = ymp_init();
+    BenchRepository shape = bench_repository_args(argv);
+    char *destdir = bench_destdir(shape);
+    if (!destdir) {
+        return 1;
+    }
+    variable_set_value(ymp->variables, "DESTDIR", destdir);
+    variable_set_value(ymp->variables, "no-emerge", "true");
+
+    bench_load(ymp, shape);
+    bench_resolve(shape);
+
+    bench_destdir_remove(destdir);
+    return 0;
+}
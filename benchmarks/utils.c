@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <core/ymp.h>
+#include <utils/array.h>
+#include <utils/file.h>
+#include <utils/hash.h>
+#include <utils/jobs.h>
+#include <utils/string.h>
+#include <utils/yaml.h>
+
+#include "bench.h"
+
+#define SUITE "utils"
+
+// yaml_get_area_list() results are not NULL terminated, use the count
+static void free_list(char **list, int count) {
+    for (int i = 0; list && (count < 0 ? list[i] != NULL : i < count); i++) {
+        free(list[i]);
+    }
+    free(list);
+}
+
+static int noop_job(void *args) {
+    (void) args;
+    return 0;
+}
+
+static void bench_yaml(BenchRepository shape) {
+    char *data = bench_repository_data(shape);
+    char *index = yaml_get_area(data, "index");
+    int count = 0;
+    char **packages = yaml_get_area_list(index, "package", &count);
+
+    bench_run(SUITE, "yaml_get_area", 10, free(yaml_get_area(data, "index")));
+    bench_run(SUITE, "yaml_get_area_list", 10, {
+        int n = 0;
+        char **areas = yaml_get_area_list(index, "package", &n);
+        free_list(areas, n);
+    });
+    // Per package lookups, like repository_load_from_data does
+    bench_run(SUITE, "yaml_get_value", (size_t) count, free(yaml_get_value(packages[bench_i], "version")));
+    bench_run(SUITE, "yaml_get_array", (size_t) count, {
+        int n = 0;
+        char **depends = yaml_get_array(packages[bench_i], "depends", &n);
+        free_list(depends, n);
+    });
+
+    free_list(packages, count);
+    free(index);
+    free(data);
+}
+
+static void bench_array(size_t items) {
+    char **names = calloc(items, sizeof(char *));
+    for (size_t i = 0; i < items; i++) {
+        // Every name twice, so array_uniq has work to do
+        names[i] = build_string("pkg-%zu", (i * 7919) % (items / 2 + 1));
+    }
+    array *a = array_new();
+    bench_run(SUITE, "array_add", items, array_add(a, names[bench_i]));
+    bench_run(SUITE, "array_has", 1000, (void) array_has(a, names[(bench_i * 31) % items]));
+    bench_run(SUITE, "array_uniq", 1, array_uniq(a));
+    bench_run(SUITE, "array_sort", 1, array_sort(a));
+    bench_run(SUITE, "array_get_string", 10, free(array_get_string(a)));
+    array_unref(a);
+    for (size_t i = 0; i < items; i++) {
+        free(names[i]);
+    }
+    free(names);
+}
+
+static void bench_string(size_t items) {
+    array *a = array_new();
+    for (size_t i = 0; i < items; i++) {
+        char line[64];
+        snprintf(line, sizeof(line), "/usr/lib/pkg-%zu/file.so\n", i);
+        array_add(a, line);
+    }
+    char *text = array_get_string(a);
+    array_unref(a);
+
+    bench_run(SUITE, "split", 10, free_list(split(text, "\n"), -1));
+    bench_run(SUITE, "str_replace", 10, free(str_replace(text, "/usr/lib", "/usr/lib64")));
+    free(text);
+}
+
+static void bench_hash(size_t size) {
+    const char *path = "/tmp/ymp-bench-hash.bin";
+    char *data = malloc(size + 1);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = 'a' + (i * 13) % 26;
+    }
+    data[size] = '\0';
+    writefile(path, data);
+    free(data);
+
+    const struct {
+        int type;
+        const char *name;
+    } algorithms[] = {
+        { SHA512, "calculate_hash_sha512" },
+        { SHA256, "calculate_hash_sha256" },
+        { SHA1, "calculate_hash_sha1" },
+        { MD5, "calculate_hash_md5" },
+    };
+    for (size_t a = 0; a < sizeof(algorithms) / sizeof(algorithms[0]); a++) {
+        bench_run(SUITE, algorithms[a].name, 10, free(calculate_hash(algorithms[a].type, path)));
+    }
+    remove(path);
+}
+
+static void bench_jobs(size_t count) {
+    bench_run(SUITE, "jobs_run", 10, {
+        jobs *j = jobs_new();
+        for (size_t i = 0; i < count; i++) {
+            jobs_add(j, (callback) noop_job, NULL, NULL);
+        }
+        jobs_run(j);
+        jobs_unref(j);
+    });
+}
+
+int main(int argc, char **argv) {
+    (void) argc;
+    (void) ymp_init();
+    BenchRepository shape = bench_repository_args(argv);
+    bench_yaml(shape);
+    bench_array(shape.packages * 4);
+    bench_string(shape.packages * 4);
+    bench_hash(bench_arg(argv, "hash-size", 16 * 1024 * 1024));
+    bench_jobs(bench_arg(argv, "jobs", 1000));
+    return 0;
+}
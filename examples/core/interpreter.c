@@ -1,11 +1,40 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
 #include <core/interpreter.h>
 #include <core/ymp.h>
+#include <utils/file.h>
+#include <utils/string.h>
+
+static Ymp *ymp = NULL;
+static int inside = 0;
+static int peak = 0;
+
+// Not marked thread safe, parallel branches run it one at a time. Every
+// branch sees its own --tag.
+static int serial_fn(char **args) {
+    int now = __atomic_add_fetch(&inside, 1, __ATOMIC_SEQ_CST);
+    if (now > peak) {
+        peak = now;
+    }
+    usleep(20000);
+    int status = iseq(variable_get_value(ymp->variables, "tag"), args[0]) ? 0 : 1;
+    __atomic_sub_fetch(&inside, 1, __ATOMIC_SEQ_CST);
+    return status;
+}
 
 int main(int argc, char **argv) {
     (void) argc;
     (void) argv;
-    (void) ymp_init();
-    return run_script(
+    ymp = ymp_init();
+    Operation op = { 0 };
+    op.name = "serial";
+    op.min_args = 1;
+    op.call = (callback) serial_fn;
+    operation_register(ymp->manager, op);
+
+    int rc = run_script(
         "print hello world\n"
         "set test 123\n"
         "if eq 1 3\n"
@@ -13,5 +42,67 @@ int main(int argc, char **argv) {
         "endif\n"
         "if eq 1 1\n"
         "print test right\n"
-        "endif\n");
+        "endif\n"
+        "set who \"$(print pingu)\"\n"
+        "print operation: $who `printf shell`\n"
+        "parallel\n"
+        "    eq 1 1\n"
+        "    eq 1 2\n"
+        "endparallel\n"
+        "if not eq $STATUS 0 and eq $STATUS_1 0\n"
+        "print second branch failed: $STATUS_2\n"
+        "endif\n"
+        "eq 2 2 &\n"
+        "eq 3 3 &\n"
+        "wait\n"
+        "print background: $STATUS $STATUS_1 $STATUS_2\n"
+        "parallel\n"
+        "    serial a --tag=a\n"
+        "    serial b --tag=b\n"
+        "    serial c --tag=c\n"
+        "endparallel\n"
+        "serial d --tag=d &\n"
+        "serial e --tag=e &\n"
+        "wait\n"
+        "print serial: $STATUS tag: [$tag]\n");
+    printf("serial peak: %d\n", peak);
+
+    // Compile once, run many times
+    Script *script = script_compile(
+        "label greet\n"
+        "    print hello $name\n"
+        "ret\n"
+        "set n x\n"
+        "while not eq $n xxx\n"
+        "    print loop $n\n"
+        "    set n ${n}x\n"
+        "endwhile\n"
+        "goto greet\n"
+        "print after goto\n");
+    if (!script) {
+        return 1;
+    }
+    variable_set_value(ymp->variables, "name", "pingu");
+    rc += script_run(script);
+    variable_set_value(ymp->variables, "name", "tux");
+    rc += script_run(script);
+    script_unref(script);
+
+    // Compiled form is cached next to the file
+    char path[] = "/tmp/ymp-example-XXXXXX.ympsh";
+    int fd = mkstemps(path, 6);
+    if (fd < 0) {
+        return 1;
+    }
+    close(fd);
+    writefile(path, "set cached yes\nget cached\n");
+    variable_set_value(ymp->variables, "ympsh-cache", "true");
+    rc += run_script_file(path);
+    char cache[sizeof(path) + 1];
+    snprintf(cache, sizeof(cache), "%sc", path);
+    printf("cache file: %d\n", isfile(cache));
+    rc += run_script_file(path);
+    unlink(cache);
+    unlink(path);
+    return rc;
 }
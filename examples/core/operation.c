@@ -41,6 +41,14 @@ int main(int argc, char **argv) {
     op2.call = (callback) gen_err;
     operation_register(manager, op2);
 
+    // operation 3 (reachable by its aliases)
+    Operation op4 = { 0 };
+    op4.name = "baz";
+    op4.alias = "bz:qux";
+    op4.min_args = 1;
+    op4.call = (callback) my_print;
+    operation_register(manager, op4);
+
     // error handler
     Operation op3;
     op3.alias = NULL;
@@ -53,6 +61,10 @@ int main(int argc, char **argv) {
     char *bar_args[] = { "hello bar\n", NULL };
     rc += operation_main(manager, "foo", foo_args);
     rc += operation_main(manager, "bar", bar_args);
+    char *qux_args[] = { "hello qux", NULL };
+    rc += operation_main(manager, "qux", qux_args);
+    printf("%s %s\n", get_operation_by_name(manager, "bz").name,
+           get_operation_by_name(manager, "missing").name ? "found" : "missing");
     operation_manager_unref(manager);
 
     if (rc > 0) {
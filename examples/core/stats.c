@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <core/stats.h>
+#include <core/trace.h>
+#include <core/ymp.h>
+#include <utils/file.h>
+#include <utils/hash.h>
+#include <utils/jobs.h>
+#include <utils/string.h>
+#include <utils/yaml.h>
+
+// Overlapping spans of one phase are counted once
+int phase_job(void *ctx) {
+    (void) ctx;
+    trace_begin("sleep", NULL);
+    usleep(50000);
+    trace_end();
+    return 0;
+}
+
+int main() {
+    (void) ymp_init();
+    stats_set_status(true);
+
+    // Counters are incremented by the library
+    writefile("/tmp/ymp-stats-example.txt", "name: stats\nversion: 1.0\n");
+    char *hash = calculate_sha256("/tmp/ymp-stats-example.txt");
+    char *data = readfile("/tmp/ymp-stats-example.txt");
+    char *version = yaml_get_value(data, "version");
+    create_dir("/tmp/ymp-stats-example/a/b");
+
+    // And by callers
+    stats_add(STATS_FORKS_BASH, 2);
+
+    jobs *j = jobs_new();
+    j->parallel = 4;
+    for (size_t i = 0; i < 4; i++) {
+        jobs_add(j, (callback) phase_job, NULL, NULL);
+    }
+    jobs_run(j);
+    jobs_unref(j);
+
+    stats_print();
+    bool ok = stats_get(STATS_BYTES_SHA256) == 25 && stats_get(STATS_BYTES_YAML) == 25 && stats_get(STATS_FORKS_BASH) == 2;
+    printf("Counters: %s\n", ok ? "ok" : "wrong");
+
+    free(hash);
+    free(data);
+    free(version);
+    remove_all("/tmp/ymp-stats-example");
+    remove("/tmp/ymp-stats-example.txt");
+    return ok ? 0 : EXIT_FAILURE;
+}
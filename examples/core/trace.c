@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <core/trace.h>
+#include <core/ymp.h>
+#include <utils/jobs.h>
+#include <utils/string.h>
+
+// Spans may be opened from job workers
+int traced_job(void *ctx) {
+    trace_begin("job", "worker %d \"quoted\"", (int) (size_t) ctx);
+    trace_begin("inner", NULL);
+    trace_end();
+    trace_end();
+    return 0;
+}
+
+static size_t count(const char *data, const char *needle) {
+    size_t n = 0;
+    for (const char *p = strstr(data, needle); p; p = strstr(p + 1, needle)) {
+        n++;
+    }
+    return n;
+}
+
+int main() {
+    (void) ymp_init();
+    const char *path = "/tmp/ymp-trace-example.json";
+
+    // Disabled, nothing is recorded
+    trace_begin("ignored", NULL);
+    trace_end();
+
+    if (!trace_start(path)) {
+        fprintf(stderr, "Failed to start tracing\n");
+        return EXIT_FAILURE;
+    }
+    trace_begin("main", "%s", "example");
+    jobs *j = jobs_new();
+    j->parallel = 4;
+    for (size_t i = 0; i < 16; i++) {
+        jobs_add(j, (callback) traced_job, (void *) i, NULL);
+    }
+    jobs_run(j);
+    jobs_unref(j);
+    trace_end();
+    trace_stop();
+
+    char *data = readfile(path);
+    size_t events = count(data, "\"ph\":\"X\"");
+    bool closed = strstr(data, "\n]}\n") != NULL;
+    printf("Trace events: %ld\n", events);
+    printf("Escaped detail: %s\n", strstr(data, "\\\"quoted\\\"") ? "ok" : "missing");
+    printf("Disabled span skipped: %s\n", strstr(data, "ignored") ? "no" : "ok");
+    free(data);
+    remove(path);
+    return events == 33 && closed ? 0 : EXIT_FAILURE;
+}
@@ -1,3 +1,4 @@
+#include <malloc.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -10,6 +11,44 @@ int main(int argc, char **argv) {
     variable_set_value(vars, "user", "pingu");
     char *user = variable_get_value(vars, "user");
     printf("%s\n", user);
+    // Handles resolve the name once and follow later updates
+    VariableHandle *shell = variable_lookup(vars, "shell");
+    printf("unset: '%s'\n", variable_handle_get(shell));
+    variable_set_value(vars, "shell", "sh");
+    variable_set_value(vars, "shell", "bash");
+    printf("%s\n", variable_handle_get(shell));
+    char *copy = variable_handle_dup(shell);
+    printf("copy: %s\n", copy);
+    free(copy);
+    // Replaced values are freed, a changing counter does not grow memory
+#ifdef __GLIBC__
+    size_t before = mallinfo2().uordblks;
+#endif
+    char counter[32];
+    for (int i = 0; i < 100000; i++) {
+        snprintf(counter, sizeof(counter), "%d", i);
+        variable_set_value(vars, "counter", counter);
+    }
+#ifdef __GLIBC__
+    size_t grown = mallinfo2().uordblks - before;
+    printf("counter: %s grown: %s\n", variable_get_value(vars, "counter"), grown < 64 * 1024 ? "no" : "yes");
+#endif
+    // A pinned value survives updates until the last unpin
+    variable_pin(vars);
+    char *pinned = variable_get_value(vars, "counter");
+    variable_set_value(vars, "counter", "replaced");
+    printf("pinned: %s now: %s\n", pinned, variable_get_value(vars, "counter"));
+    variable_unpin(vars);
+    // Read-only variables ignore normal updates
+    variable_set_value_read_only(vars, "arch", "x86_64");
+    variable_set_value(vars, "arch", "aarch64");
+    printf("%s\n", variable_get_value(vars, "arch"));
+    char **names = variable_get_names(vars);
+    for (size_t i = 0; names[i]; i++) {
+        printf("name: %s\n", names[i]);
+        free(names[i]);
+    }
+    free(names);
     variable_manager_unref(vars);
     Ymp *ymp = ymp_init();
     char *args_set[] = { "name", "pingu", NULL };
@@ -0,0 +1,139 @@
+#include <config.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <core/variable.h>
+#include <core/ymp.h>
+#include <data/build.h>
+#include <utils/file.h>
+#include <utils/hash.h>
+#include <utils/string.h>
+
+static const char *recipe =
+    "name='cachetest'\n"
+    "version='1.0'\n"
+    "release='1'\n"
+    "description='build cache example'\n"
+    "arch=('x86_64')\n"
+    "depends=()\n"
+    "makedepends=(cachedep)\n"
+    "source=('local.txt')\n"
+    "sha256sums=('SKIP')\n"
+    "group=(test)\n"
+    "uses=()\n"
+    "build(){\n"
+    "    :\n"
+    "}\n"
+    "package(){\n"
+    "    mkdir -p $DESTDIR/usr/share/cachetest\n"
+    "    cp local.txt $DESTDIR/usr/share/cachetest/\n"
+    "    date +%s%N > $DESTDIR/usr/share/cachetest/stamp\n"
+    "}\n";
+
+// Build phases switch the terminal to raw mode, give them one
+static bool open_terminal() {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+        return false;
+    }
+    int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    return slave >= 0 && dup2(slave, STDIN_FILENO) == STDIN_FILENO;
+}
+
+static void install_dependency(const char *version) {
+    char *metadata = build_string("ymp:\n  package:\n    name: cachedep\n    version: %s\n    release: 1\n", version);
+    writefile("cache_root/" STORAGE "/metadata/cachedep.yaml", metadata);
+    free(metadata);
+}
+
+// Build the source, return the cache key and the stamp written by package()
+static char *build(const char *src, char **stamp) {
+    char *path = build_binary_from_path(src);
+    if (!path) {
+        return NULL;
+    }
+    char *key_file = build_string("%s/build-key", path);
+    char *stamp_file = build_string("%s/output/usr/share/cachetest/stamp", path);
+    char *key = calculate_sha256(key_file);
+    *stamp = readfile(stamp_file);
+    free(key_file);
+    free(stamp_file);
+    remove_all(path);
+    free(path);
+    return key;
+}
+
+static void remove_cached(const char *key) {
+    char *cached = build_string("%s/binary/%s.ymp", BUILD_DIR, key);
+    unlink(cached);
+    free(cached);
+}
+
+int main() {
+    if (!isatty(STDIN_FILENO) && !open_terminal()) {
+        printf("No terminal\n");
+        return 77;
+    }
+    Ymp *ymp = ymp_init();
+    create_dir("cache_root/" STORAGE "/metadata");
+    char *root = realpath("cache_root", NULL);
+    variable_set_value(ymp->variables, "DESTDIR", root);
+    install_dependency("1.0");
+    create_dir("cache_src");
+    writefile("cache_src/ympbuild", recipe);
+    writefile("cache_src/local.txt", "one\n");
+    char *src = realpath("cache_src", NULL);
+
+    // The first build stores the package, the second restores it
+    char *stamp = NULL, *cached_stamp = NULL;
+    char *key = build(src, &stamp);
+    if (!key) {
+        printf("Build failed\n");
+        return 1;
+    }
+    char *cached = build_string("%s/binary/%s.ymp", BUILD_DIR, key);
+    printf("stored: %d\n", isfile(cached));
+    char *key_again = build(src, &cached_stamp);
+    printf("restored: %d\n", key_again && iseq(key, key_again) && iseq(stamp, cached_stamp));
+
+    // A source without a checked sum still changes the key
+    writefile("cache_src/local.txt", "two\n");
+    char *stamp_source = NULL;
+    char *key_source = build(src, &stamp_source);
+    printf("source changes key: %d\n", key_source && !iseq(key, key_source));
+
+    // So does the installed version of a build dependency
+    install_dependency("2.0");
+    char *stamp_depend = NULL;
+    char *key_depend = build(src, &stamp_depend);
+    printf("makedepends changes key: %d\n", key_depend && !iseq(key_source, key_depend));
+
+    int status = !isfile(cached) || !key_again || !iseq(stamp, cached_stamp) || !key_source ||
+                 iseq(key, key_source) || !key_depend || iseq(key_source, key_depend);
+
+    remove_cached(key);
+    if (key_source) {
+        remove_cached(key_source);
+    }
+    if (key_depend) {
+        remove_cached(key_depend);
+    }
+    free(cached);
+    free(key);
+    free(key_again);
+    free(key_source);
+    free(key_depend);
+    free(stamp);
+    free(cached_stamp);
+    free(stamp_source);
+    free(stamp_depend);
+    remove_all("cache_src");
+    remove_all("cache_root");
+    free(src);
+    free(root);
+    return status;
+}
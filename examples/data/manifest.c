@@ -0,0 +1,119 @@
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <core/variable.h>
+#include <core/ymp.h>
+#include <data/build.h>
+#include <sys/stat.h>
+#include <utils/array.h>
+#include <utils/file.h>
+#include <utils/hash.h>
+#include <utils/string.h>
+
+static const char *recipe =
+    "name='manifest'\n"
+    "version='1.0'\n"
+    "release='1'\n"
+    "description='manifest example'\n"
+    "arch=('x86_64')\n"
+    "depends=()\n"
+    "source=()\n"
+    "sha256sums=()\n"
+    "group=(test)\n"
+    "uses=()\n"
+    "dontstrip=1\n"
+    "build(){\n"
+    "    :\n"
+    "}\n"
+    "package(){\n"
+    "    for d in 1 2 3 4 5 6 7 8 ; do\n"
+    "        mkdir -p $DESTDIR/usr/share/manifest/$d\n"
+    "        for f in 1 2 3 4 5 6 7 8 ; do\n"
+    "            echo $d$f > $DESTDIR/usr/share/manifest/$d/$f\n"
+    "        done\n"
+    "        ln -s $d/1 $DESTDIR/usr/share/manifest/link$d\n"
+    "    done\n"
+    "}\n";
+
+// Build phases switch the terminal to raw mode, give them one
+static bool open_terminal() {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+        return false;
+    }
+    int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    return slave >= 0 && dup2(slave, STDIN_FILENO) == STDIN_FILENO;
+}
+
+int main() {
+    if (!isatty(STDIN_FILENO) && !open_terminal()) {
+        printf("No terminal\n");
+        return 77;
+    }
+    Ymp *ymp = ymp_init();
+    // Build every time, the manifest is written by the build itself
+    variable_set_value(ymp->variables, "no-build-cache", "true");
+    create_dir("manifest_src");
+    writefile("manifest_src/ympbuild", recipe);
+    char *src = realpath("manifest_src", NULL);
+    char *build = src ? build_binary_from_path(src) : NULL;
+    if (!build) {
+        printf("Build failed\n");
+        return 1;
+    }
+
+    // Same walk done serially: find() order, sha1 and relative path for
+    // files, absolute path and target for symlinks
+    char *rootfs = build_string("%s/output", build);
+    char **inodes = find(rootfs);
+    array *files = array_new();
+    array *links = array_new();
+    for (size_t i = 0; inodes[i]; i++) {
+        struct stat st;
+        if (lstat(inodes[i], &st) == 0 && S_ISLNK(st.st_mode)) {
+            char *target = sreadlink(inodes[i]);
+            char *line = build_string("%s %s\n", inodes[i] + strlen(rootfs), target);
+            array_add(links, line);
+            free(line);
+            free(target);
+        } else if (S_ISREG(st.st_mode)) {
+            char *hash = calculate_sha1(inodes[i]);
+            char *line = build_string("%s %s\n", hash, inodes[i] + strlen(rootfs) + 1);
+            array_add(files, line);
+            free(line);
+            free(hash);
+        }
+        free(inodes[i]);
+    }
+    free(inodes);
+
+    char *files_path = build_string("%s/files", build);
+    char *links_path = build_string("%s/links", build);
+    char *files_serial = array_get_string(files);
+    char *links_serial = array_get_string(links);
+    char *files_built = readfile(files_path);
+    char *links_built = readfile(links_path);
+    printf("files: %zu links: %zu\n", array_length(files), array_length(links));
+    printf("files match: %d\n", strcmp(files_serial, files_built) == 0);
+    printf("links match: %d\n", strcmp(links_serial, links_built) == 0);
+    int status = strcmp(files_serial, files_built) || strcmp(links_serial, links_built);
+
+    free(files_serial);
+    free(links_serial);
+    free(files_built);
+    free(links_built);
+    free(files_path);
+    free(links_path);
+    array_unref(files);
+    array_unref(links);
+    free(rootfs);
+    remove_all(build);
+    free(build);
+    remove_all("manifest_src");
+    free(src);
+    return status;
+}
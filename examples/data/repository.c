@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 
 #include <core/ymp.h>
 #include <data/repository.h>
@@ -33,6 +34,35 @@ int main(int argc, char **argv) {
         printf("%s %d\n", pkgs[i]->name, pkgs[i]->is_source);
     }
 
+    // Compact table, packages are created on demand
+    variable_set_value(ymp->variables, "compact-index", "true");
+    Repository *repo3 = repository_new();
+    repository_load_from_data(repo3, "index:\n"
+                                     "  package:\n"
+                                     "    name: bar\n"
+                                     "    version: 2.0\n"
+                                     "    release: 3\n"
+                                     "    depends:\n"
+                                     "      - hello\n"
+                                     "    group:\n"
+                                     "      - sys.base\n"
+                                     "  package:\n"
+                                     "    name: hello\n"
+                                     "    version: 1.0\n"
+                                     "    release: 1\n");
+    for (size_t i = 0; i < repo3->package_count; i++) {
+        printf("%s %d\n", repository_name_at(repo3, i), repository_is_source_at(repo3, i));
+    }
+    Package *bar = repository_get(repo3, "bar", false);
+    if (!bar || bar->release != 3 || !bar->dependencies || strcmp(bar->dependencies[0], "hello") != 0) {
+        printf("Compact table lookup failed\n");
+        return 1;
+    }
+    printf("%s-%s-%d depends: %s group: %s\n", bar->name, bar->version, bar->release, bar->dependencies[0],
+           bar->groups[0]);
+    repository_unref(repo3);
+    variable_set_value(ymp->variables, "compact-index", "false");
+
     Repository *repo2 = repository_new();
     char *index2 = "index:\n"
                    "  address: https://gitlab.com/turkman/packages/binary-repo/-/raw/master/$uri\n"
@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <core/stats.h>
+#include <core/ymp.h>
+#include <data/build.h>
+#include <utils/file.h>
+#include <utils/string.h>
+
+int main() {
+    (void) ymp_init();
+    stats_set_status(true);
+
+    create_dir("/tmp/ymp-ympbuild-example");
+    writefile("/tmp/ymp-ympbuild-example/ympbuild",
+              "#!/usr/bin/env bash\n"
+              "name='hello'\n"
+              "version='1.0'\n"
+              "release='2'\n"
+              "depends=(glibc 'zlib')\n"
+              "source=(\"https://example.org/$name-$version.tar.gz\")\n"
+              "echo noise\n");
+
+    // Every value is read from a single bash run
+    ympbuild ymp = { 0 };
+    ymp.ctx = readfile("/tmp/ymp-ympbuild-example/ympbuild");
+    char *name = ympbuild_get_value(&ymp, "name");
+    char *version = ympbuild_get_value(&ymp, "version");
+    char *missing = ympbuild_get_value(&ymp, "missing");
+    char **depends = ympbuild_get_array(&ymp, "depends");
+    char **sources = ympbuild_get_array(&ymp, "source");
+    printf("name: %s\nversion: %s\nmissing: '%s'\n", name, version, missing);
+    for (size_t i = 0; depends[i]; i++) {
+        printf("depends: %s\n", depends[i]);
+    }
+    for (size_t i = 0; sources[i]; i++) {
+        printf("source: %s\n", sources[i]);
+    }
+    printf("bash forks: %lu\n", (unsigned long) stats_get(STATS_FORKS_BASH));
+
+    char *filename = ympbuild_package_filename("/tmp/ymp-ympbuild-example");
+    printf("package: %s\n", filename);
+
+    free(filename);
+    free(name);
+    free(version);
+    free(missing);
+    for (size_t i = 0; depends[i]; i++) {
+        free(depends[i]);
+    }
+    free(depends);
+    for (size_t i = 0; sources[i]; i++) {
+        free(sources[i]);
+    }
+    free(sources);
+    remove_all("/tmp/ymp-ympbuild-example");
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <utils/arena.h>
+
+int main() {
+    // Create a new arena with a small first chunk
+    arena *a = arena_new(256);
+    if (a == NULL) {
+        fprintf(stderr, "Failed to create arena\n");
+        return EXIT_FAILURE;
+    }
+
+    // Allocate strings, they are released together with the arena
+    char *name = arena_strdup(a, "hello");
+    char *version = arena_strndup(a, "1.0-beta", 3);
+    printf("%s %s\n", name, version);
+
+    // Allocate more than a chunk holds
+    char key[32];
+    char **items = arena_calloc(a, 1000, sizeof(char *));
+    for (int i = 0; i < 1000; i++) {
+        sprintf(key, "item-%d", i);
+        items[i] = arena_strdup(a, key);
+    }
+    char *large = arena_alloc(a, 64 * 1024);
+    memset(large, 'x', 64 * 1024);
+
+    if (!arena_owns(a, items[999]) || !arena_owns(a, large) || strcmp(items[999], "item-999") != 0) {
+        fprintf(stderr, "Unexpected arena contents\n");
+        return EXIT_FAILURE;
+    }
+    char *heap = strdup("heap");
+    printf("Owns heap string: %d\n", arena_owns(a, heap));
+    free(heap);
+    printf("Arena size: %ld\n", arena_size(a));
+
+    // Release everything at once
+    arena_unref(a);
+    return 0;
+}
@@ -64,8 +64,17 @@ int main() {
         free(concatenated);  // Free the concatenated string
     }
 
-    // Clean up and free the dynamic array
-    array_unref(myArray);
+    // Borrow the contents without copying
+    char **view = array_view(myArray, &len);
+    printf("\nBorrowed %ld items, first: %s\n", len, view[0]);
+
+    // Take the contents and release the array
+    contents = array_steal(myArray, &len);
+    printf("Stolen %ld items\n", len);
+    for (size_t i = 0; i < len; i++) {
+        free(contents[i]);
+    }
+    free(contents);
 
     return 0;
 }
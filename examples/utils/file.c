@@ -1,4 +1,5 @@
 #include <dirent.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -10,6 +11,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <utils/file.h>
+#include <utils/string.h>
 
 int main() {
     const char *dir_path = "example_dir/sub_dir";
@@ -105,5 +107,74 @@ int main() {
         return 1;
     }
 
+    // Share the data of a file
+    create_dir("dir1");
+    writefile("dir1/shared.txt", "Shared");
+    if (!link_file("dir1/shared.txt", "dir1/linked/shared.txt")) {
+        return 1;
+    }
+    printf("Linked: %s\n", readfile("dir1/linked/shared.txt"));
+    // An existing file is replaced by a rename, no temporary file is left
+    writefile("dir1/other.txt", "Other");
+    if (!link_file("dir1/other.txt", "dir1/linked/shared.txt")) {
+        return 1;
+    }
+    char **linked = find("dir1/linked");
+    size_t count = 0;
+    while (linked[count]) {
+        free(linked[count++]);
+    }
+    free(linked);
+    printf("Replaced: %s files: %zu\n", readfile("dir1/linked/shared.txt"), count);
+    remove_all("dir1");
+
+    // Copy keeps the data, the mode and symlinks of a tree
+    create_dir("dir1/tree/sub");
+    char *big = malloc(3 * 1024 * 1024 + 1);
+    memset(big, 'y', 3 * 1024 * 1024);
+    big[3 * 1024 * 1024] = '\0';
+    writefile("dir1/tree/sub/big", big);
+    free(big);
+    chmod("dir1/tree/sub/big", 0755);
+    if (symlink("sub/big", "dir1/tree/current") < 0 || !copy_directory("dir1/tree", "dir1/copy")) {
+        return 1;
+    }
+    struct stat st;
+    if (stat("dir1/copy/current", &st) != 0 || st.st_size != 3 * 1024 * 1024 || (st.st_mode & 0777) != 0755 ||
+        !issymlink("dir1/copy/current")) {
+        return 1;
+    }
+    printf("Copied tree: %ld bytes\n", (long) st.st_size);
+    remove_all("dir1");
+
+    // Paths longer than 1024 bytes are found in full
+    char *deep = strdup("deep");
+    char name[101];
+    memset(name, 'd', 100);
+    name[100] = '\0';
+    mkdir(deep, 0755);
+    for (int i = 0; i < 12; i++) {
+        char *next = build_string("%s/%s", deep, name);
+        mkdir(next, 0755);
+        free(deep);
+        deep = next;
+    }
+    char *deep_file = build_string("%s/file", deep);
+    writefile(deep_file, "deep");
+    char **deep_files = find("deep");
+    printf("Deep: %d\n", deep_files[0] && !deep_files[1] && strcmp(deep_files[0], deep_file) == 0);
+    for (size_t i = 0; deep_files[i]; i++) {
+        free(deep_files[i]);
+    }
+    free(deep_files);
+    free(deep_file);
+    free(deep);
+    remove_all("deep");
+
+    // ELF check on a path and on an open file
+    int fd = open("/proc/self/exe", O_RDONLY);
+    printf("ELF: %d %d %d\n", is_elf("/proc/self/exe"), is_elf_fd(fd), is_elf(file_path));
+    close(fd);
+
     return 0;
 }
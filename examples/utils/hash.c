@@ -1,7 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <utils/hash.h>
+#include <utils/string.h>
 
 int main() {
     char *path = "/etc/os-release";
@@ -18,6 +20,20 @@ int main() {
     char *sha512 = calculate_sha512(path);
     printf("SHA512 %s\n", sha512);
 
+    // Same hash from data that arrives in pieces
+    char *data = readfile(path);
+    hash_stream *h = hash_stream_new(SHA256);
+    size_t len = strlen(data);
+    hash_stream_update(h, data, len / 2);
+    hash_stream_update(h, data + len / 2, len - len / 2);
+    char *stream = hash_stream_final(h);
+    printf("SHA256 stream %s\n", stream);
+    if (strcmp(stream, sha256) != 0) {
+        return 1;
+    }
+
+    free(stream);
+    free(data);
     free(sha1);
     free(md5);
     free(sha256);
@@ -1,6 +1,7 @@
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include <utils/jobs.h>
 
@@ -11,6 +12,33 @@ int example_callback(void *args) {
     return 0;
 }
 
+// Uneven jobs, the first one is slow
+int sleep_callback(void *args) {
+    int *num = (int *) args;
+    usleep(*num == 0 ? 200000 : 10000);
+    return 0;
+}
+
+// Fails on one job, later jobs are skipped
+int fail_callback(void *args) {
+    int *num = (int *) args;
+    return *num == 3 ? 1 : 0;
+}
+
+// Runs a job set from inside a job
+int nested_callback(void *args) {
+    int *num = (int *) args;
+    jobs *inner = jobs_new();
+    inner->parallel = 4;
+    for (int i = 0; i < 4; i++) {
+        jobs_add(inner, (callback) sleep_callback, num, NULL);
+    }
+    jobs_run(inner);
+    int failed = inner->failed;
+    jobs_unref(inner);
+    return failed;
+}
+
 int main() {
     // Create a new job manager
     jobs *job_manager = jobs_new();
@@ -31,16 +59,45 @@ int main() {
         jobs_add(job_manager, (callback) example_callback, arg, NULL);
     }
 
-    // Run the jobs in the job manager
+    // Run the jobs in the job manager, in order with a single job at a time
+    job_manager->parallel = 1;
     jobs_run(job_manager);
+    jobs_unref(job_manager);
+
+    // A slow job does not hold back the others
+    jobs *uneven = jobs_new();
+    uneven->parallel = 4;
+    for (int i = 0; i < 10; i++) {
+        jobs_add(uneven, (callback) sleep_callback, args[i], NULL);
+    }
+    jobs_run(uneven);
+    printf("Uneven finished: %d\n", uneven->finished);
+    jobs_unref(uneven);
+
+    // Jobs can run jobs without exhausting the pool
+    jobs *nested = jobs_new();
+    nested->parallel = 2;
+    for (int i = 1; i < 10; i++) {
+        jobs_add(nested, (callback) nested_callback, args[i], NULL);
+    }
+    jobs_run(nested);
+    printf("Nested finished: %d failed: %d\n", nested->finished, nested->failed);
+    jobs_unref(nested);
+
+    // A failure cancels the jobs that did not start
+    jobs *failing = jobs_new();
+    failing->parallel = 1;
+    for (int i = 0; i < 10; i++) {
+        jobs_add(failing, (callback) fail_callback, args[i], NULL);
+    }
+    jobs_run(failing);
+    printf("Failing finished: %d failed: %d\n", failing->finished, failing->failed);
+    jobs_unref(failing);
 
     // The job manager does not own the arguments passed to jobs_add
     for (int i = 0; i < 10; i++) {
         free(args[i]);
     }
 
-    // Release the resources used by the job manager
-    jobs_unref(job_manager);
-
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,103 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <core/variable.h>
+#include <core/ymp.h>
+#include <utils/jobs.h>
+
+static int running[JOBS_CLASS_MAX];
+static int peak[JOBS_CLASS_MAX];
+
+// Track how many jobs of a class run at once
+int class_callback(void *ctx) {
+    JobsClass resource = (JobsClass) (size_t) ctx;
+    int now = __atomic_add_fetch(&running[resource], 1, __ATOMIC_SEQ_CST);
+    int seen = __atomic_load_n(&peak[resource], __ATOMIC_SEQ_CST);
+    while (now > seen && !__atomic_compare_exchange_n(&peak[resource], &seen, now, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+    }
+    usleep(20000);
+    __atomic_sub_fetch(&running[resource], 1, __ATOMIC_SEQ_CST);
+    return 0;
+}
+
+// Runs a set of net jobs from inside a net job
+int nested_callback(void *ctx) {
+    int width = (int) (size_t) ctx;
+    jobs *inner = jobs_new();
+    inner->parallel = width;
+    for (int i = 0; i < width; i++) {
+        int id = jobs_add(inner, (callback) class_callback, (void *) JOBS_CLASS_NET, NULL);
+        jobs_set_class(inner, id, JOBS_CLASS_NET);
+    }
+    jobs_run(inner);
+    int status = inner->failed;
+    jobs_unref(inner);
+    return status;
+}
+
+// A set of net jobs, run from its own thread
+void *net_set(void *arg) {
+    jobs *j = jobs_new();
+    j->parallel = 8;
+    for (int i = 0; i < 8; i++) {
+        int id = jobs_add(j, (callback) class_callback, (void *) JOBS_CLASS_NET, NULL);
+        jobs_set_class(j, id, JOBS_CLASS_NET);
+    }
+    jobs_run(j);
+    bool failed = j->failed;
+    jobs_unref(j);
+    return failed ? arg : NULL;
+}
+
+int main() {
+    Ymp *ymp = ymp_init();
+    variable_set_value(ymp->variables, "jobs-net", "2");
+    variable_set_value(ymp->variables, "jobs-io", "1");
+
+    // The net limit holds across job sets running at the same time
+    pthread_t threads[3];
+    for (size_t i = 0; i < 3; i++) {
+        pthread_create(&threads[i], NULL, net_set, (void *) (i + 1));
+    }
+    bool ok = true;
+    for (size_t i = 0; i < 3; i++) {
+        void *failed;
+        pthread_join(threads[i], &failed);
+        ok = ok && failed == NULL;
+    }
+    printf("Net limit across sets: %s (peak %d)\n", ok && peak[JOBS_CLASS_NET] <= 2 ? "ok" : "wrong", peak[JOBS_CLASS_NET]);
+
+    // Downloads and extractions of one graph use their own limits
+    jobs *j = jobs_new();
+    j->parallel = 8;
+    for (int i = 0; i < 6; i++) {
+        int download = jobs_add(j, (callback) class_callback, (void *) JOBS_CLASS_NET, NULL);
+        int extract = jobs_add(j, (callback) class_callback, (void *) JOBS_CLASS_IO, NULL);
+        jobs_set_class(j, download, JOBS_CLASS_NET);
+        jobs_set_class(j, extract, JOBS_CLASS_IO);
+        int deps[] = { download, JOBS_END };
+        jobs_add_after(j, extract, deps);
+    }
+    jobs_run(j);
+    ok = !j->failed && j->finished == 12 && peak[JOBS_CLASS_NET] <= 2 && peak[JOBS_CLASS_IO] == 1;
+    printf("Mixed graph: %s\n", ok ? "ok" : "wrong");
+    jobs_unref(j);
+
+    // Nested sets take turns on the slot of the calling job instead of
+    // waiting for it, they do not run wider than the limit
+    variable_set_value(ymp->variables, "jobs-net", "1");
+    peak[JOBS_CLASS_NET] = 0;
+    j = jobs_new();
+    j->parallel = 2;
+    for (int i = 0; i < 2; i++) {
+        int id = jobs_add(j, (callback) nested_callback, (void *) 4, NULL);
+        jobs_set_class(j, id, JOBS_CLASS_NET);
+    }
+    jobs_run(j);
+    ok = !j->failed && j->finished == 2 && peak[JOBS_CLASS_NET] == 1;
+    printf("Nested same class: %s (peak %d)\n", ok ? "ok" : "failed", peak[JOBS_CLASS_NET]);
+    jobs_unref(j);
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <utils/jobs.h>
+
+static int order = 0;
+static int finished_at[8];
+
+typedef struct {
+    int id;
+    int delay;
+    int status;
+} task;
+
+int task_callback(task *t) {
+    usleep(t->delay * 1000);
+    finished_at[t->id] = __atomic_add_fetch(&order, 1, __ATOMIC_SEQ_CST);
+    printf("Task %d done\n", t->id);
+    return t->status;
+}
+
+static bool before(int a, int b) {
+    return finished_at[a] > 0 && finished_at[a] < finished_at[b];
+}
+
+int main() {
+    task tasks[8];
+    for (int i = 0; i < 8; i++) {
+        tasks[i].id = i;
+        tasks[i].delay = 10 * (i % 3);
+        tasks[i].status = 0;
+    }
+
+    // Fan-out: 0 releases 1, 2 and 3. Fan-in: 4 waits for all of them.
+    jobs *j = jobs_new();
+    j->parallel = 4;
+    int ids[5];
+    for (int i = 4; i >= 0; i--) {
+        ids[i] = jobs_add(j, (callback) task_callback, &tasks[i], NULL);
+    }
+    int root[] = { ids[0], JOBS_END };
+    jobs_add_after(j, ids[1], root);
+    jobs_add_after(j, ids[2], root);
+    jobs_add_after(j, ids[3], root);
+    int all[] = { ids[1], ids[2], ids[3], JOBS_END };
+    jobs_add_after(j, ids[4], all);
+    jobs_run(j);
+    bool ok = !j->failed && j->finished == 5;
+    for (int i = 1; i <= 3; i++) {
+        ok = ok && before(0, i) && before(i, 4);
+    }
+    printf("Fan-out and fan-in: %s\n", ok ? "ok" : "wrong order");
+    jobs_unref(j);
+
+    // Failure propagation: 5 fails, so 6 never runs
+    tasks[5].status = 1;
+    finished_at[6] = 0;
+    j = jobs_new();
+    j->parallel = 2;
+    int failing = jobs_add(j, (callback) task_callback, &tasks[5], NULL);
+    int dependent = jobs_add(j, (callback) task_callback, &tasks[6], NULL);
+    int deps[] = { failing, JOBS_END };
+    jobs_add_after(j, dependent, deps);
+    jobs_run(j);
+    printf("Failure propagation: %s\n", j->failed && finished_at[6] == 0 ? "ok" : "dependent ran");
+    jobs_unref(j);
+
+    // A cycle fails instead of hanging
+    j = jobs_new();
+    int a = jobs_add(j, (callback) task_callback, &tasks[7], NULL);
+    int b = jobs_add(j, (callback) task_callback, &tasks[7], NULL);
+    int after_a[] = { a, JOBS_END };
+    int after_b[] = { b, JOBS_END };
+    jobs_add_after(j, a, after_b);
+    jobs_add_after(j, b, after_a);
+    jobs_run(j);
+    printf("Cycle: %s\n", j->failed ? "ok" : "not detected");
+    jobs_unref(j);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,31 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <utils/file.h>
+#include <utils/jobserver.h>
+
+int main() {
+    // Four slots, one of them is implicit
+    jobserver *js = jobserver_new("/tmp/ymp-jobserver-example", 4);
+    if (!js) {
+        return 1;
+    }
+    char *makeflags = jobserver_makeflags(js, -1);
+    printf("MAKEFLAGS=%s\n", makeflags);
+    free(makeflags);
+
+    // Take every token like make does, then give them back
+    int fd = open(js->path, O_RDONLY | O_NONBLOCK);
+    char tokens[8];
+    ssize_t taken = read(fd, tokens, sizeof(tokens));
+    printf("tokens: %zd\n", taken);
+    if (taken != 3 || write(js->fd, tokens, taken) != taken) {
+        return 1;
+    }
+    close(fd);
+
+    jobserver_unref(js);
+    return isexists("/tmp/ymp-jobserver-example") ? 1 : 0;
+}
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include <utils/sandbox.h>
@@ -17,13 +18,25 @@ int main(int argc, char *argv[]) {
     }
     sandbox_configure_hostname(handle, "sandbox");
     sandbox_configure_bind(handle, "tmpfs", "/tmp");
+    char *dirs[] = { "/usr", "/lib", "/lib64", "/bin", NULL };
+    for (size_t i = 0; dirs[i]; i++) {
+        sandbox_configure_bind(handle, dirs[i], dirs[i]);
+    }
     sandbox_configure_network(handle, false);
 
-    // Apply the sandbox and run the command inside it.
-    sandbox_apply(handle);
+    // Mount once, then run the command twice in the same sandbox.
+    printf("root: %s prepared: %d\n", handle->root, sandbox_prepare(handle));
+    int status = 0;
+    for (size_t i = 0; i < 2 && status == 0; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            sandbox_apply(handle);
+            execvp(argv[1], &argv[1]);
+            perror("execvp");
+            _exit(EXIT_FAILURE);
+        }
+        (void) waitpid(pid, &status, 0);
+    }
     sandbox_unref(handle);
-
-    execvp(argv[1], &argv[1]);
-    perror("execvp");
-    return EXIT_FAILURE;
+    return status == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
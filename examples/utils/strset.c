@@ -0,0 +1,131 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <utils/strset.h>
+
+// Keys are removed and added again while readers look them up
+#define CHURN_KEYS 64
+static int churn_values[CHURN_KEYS];
+static bool churn_done = false;
+
+static void *churn_reader(void *arg) {
+    strmap *map = arg;
+    char key[32];
+    long wrong = 0;
+    while (!__atomic_load_n(&churn_done, __ATOMIC_ACQUIRE)) {
+        for (int i = 0; i < CHURN_KEYS; i++) {
+            sprintf(key, "key-%d", i);
+            void *value = strmap_get(map, key);
+            // Either missing or the value of this very key
+            if (value && value != &churn_values[i]) {
+                wrong++;
+            }
+        }
+    }
+    return (void *) wrong;
+}
+
+int main() {
+    // Create a new string set
+    strset *set = strset_new(0);
+    if (set == NULL) {
+        fprintf(stderr, "Failed to create string set\n");
+        return EXIT_FAILURE;
+    }
+
+    // Add some strings, duplicates are rejected
+    const char *fruits[] = {"apple", "banana", "orange", "banana", "grape", NULL};
+    for (size_t i = 0; fruits[i]; i++) {
+        if (!strset_add(set, fruits[i])) {
+            printf("Duplicate: %s\n", fruits[i]);
+        }
+    }
+    printf("Set length: %ld\n", strset_length(set));
+
+    // Remove and check membership
+    strset_remove(set, "orange");
+    printf("Has orange: %d\n", strset_has(set, "orange"));
+    printf("Has grape: %d\n", strset_has(set, "grape"));
+
+    // Get the contents of the set
+    size_t len;
+    const char **contents = strset_get(set, &len);
+    for (size_t i = 0; i < len; i++) {
+        printf("%s\n", contents[i]);
+    }
+    free(contents);
+
+    // Grow the set well past its initial capacity
+    char key[32];
+    for (int i = 0; i < 10000; i++) {
+        sprintf(key, "package-%d", i);
+        strset_add(set, key);
+    }
+    for (int i = 0; i < 10000; i += 2) {
+        sprintf(key, "package-%d", i);
+        strset_remove(set, key);
+    }
+    if (strset_length(set) != 5003 || !strset_has(set, "package-9999") || strset_has(set, "package-9998")) {
+        fprintf(stderr, "Unexpected set contents\n");
+        return EXIT_FAILURE;
+    }
+    strset_unref(set);
+
+    // Map package names to values
+    strmap *map = strmap_new(STRSET_LOCKED | STRSET_INTERN);
+    strmap_set(map, "curl", "8.9.1");
+    strmap_set(map, "bash", "5.2");
+    strmap_set(map, "curl", "8.10.0");
+    printf("curl: %s\n", (char *) strmap_get(map, "curl"));
+
+    size_t pos = 0;
+    const char *name;
+    void *version;
+    while (strmap_iter(map, &pos, &name, &version)) {
+        printf("%s => %s\n", name, (char *) version);
+    }
+    strmap_unref(map);
+
+    // Churn a locked map while other threads read it
+    strmap *churn = strmap_new(STRSET_LOCKED);
+    pthread_t readers[2];
+    for (size_t i = 0; i < 2; i++) {
+        pthread_create(&readers[i], NULL, churn_reader, churn);
+    }
+    for (int round = 0; round < 2000; round++) {
+        for (int i = 0; i < CHURN_KEYS; i++) {
+            sprintf(key, "key-%d", (i + round) % CHURN_KEYS);
+            if (round % 2) {
+                strmap_remove(churn, key);
+            } else {
+                strmap_set(churn, key, &churn_values[(i + round) % CHURN_KEYS]);
+            }
+        }
+    }
+    __atomic_store_n(&churn_done, true, __ATOMIC_RELEASE);
+    long wrong = 0;
+    for (size_t i = 0; i < 2; i++) {
+        void *ret;
+        pthread_join(readers[i], &ret);
+        wrong += (long) ret;
+    }
+    // Without readers the next write frees what the churn retired
+    strmap_set(churn, "last", NULL);
+    printf("Churn: wrong %ld retired %d\n", wrong, churn->retired != NULL);
+    if (wrong != 0 || churn->retired != NULL) {
+        return EXIT_FAILURE;
+    }
+    strmap_unref(churn);
+
+    // Interned strings share the same pointer
+    strpool *pool = strpool_new();
+    const char *a = strpool_intern(pool, "glibc");
+    const char *b = strpool_intern(pool, "glibc");
+    printf("Interned: %d\n", a == b);
+    strpool_unref(pool);
+
+    return 0;
+}
@@ -8,6 +8,30 @@
 
 #include <stdbool.h>
 
+/**
+ * @brief Compiled ympsh script.
+ *
+ * A script is tokenized once into an instruction list with resolved jump
+ * targets for `if`, `while`, `label`, `goto` and `ret`. Variables and
+ * command substitutions are expanded each time their line runs.
+ *
+ * Lines between `parallel` and `endparallel` run as concurrent branches on
+ * the jobs pool. A line ending with `&` runs in the background until the
+ * next `wait`. Both set `STATUS_1` ... `STATUS_n` to the status of every
+ * branch and `STATUS` to the first failed status, or 0:
+ *
+ * @code
+ * parallel
+ *     repo --update
+ *     fetch https://example.org/a.tar.gz
+ * endparallel
+ * if eq $STATUS 0
+ *     print done
+ * endif
+ * @endcode
+ */
+typedef struct Script Script;
+
 /**
  * @brief Parses command-line arguments.
  *
@@ -36,4 +60,60 @@ char** parse_args(char** args, bool free_strings);
  */
 int run_script(const char* script);
 
+/**
+ * @brief Executes a script file.
+ *
+ * Like run_script() but loads the script with script_load(), so the compiled
+ * form can be reused from the cache file.
+ *
+ * @param path Path of the ympsh file.
+ * @return The status of the last operation, or the `exit` status.
+ */
+int run_script_file(const char* path);
+
+/**
+ * @brief Compile a script.
+ *
+ * @param source The script text.
+ * @return The compiled script, or NULL on a syntax error. The error is added
+ *         with error_add().
+ *
+ * @code
+ * Script *script = script_compile("while eq $i 0\nread i\nendwhile\n");
+ * script_run(script);
+ * script_run(script); // no second parse
+ * script_unref(script);
+ * @endcode
+ */
+Script* script_compile(const char* source);
+
+/**
+ * @brief Load and compile a script file.
+ *
+ * If the `ympsh-cache` variable is `true`, the compiled form is stored next
+ * to the file with a `c` suffix (`build.ympsh` -> `build.ympshc`) and reused
+ * while the size and modification time of the source match.
+ *
+ * @param path Path of the ympsh file.
+ * @return The compiled script, or NULL if it can not be read or compiled.
+ */
+Script* script_load(const char* path);
+
+/**
+ * @brief Run a compiled script.
+ *
+ * A script can be run any number of times.
+ *
+ * @param script The compiled script.
+ * @return The status of the last operation, or the `exit` status.
+ */
+int script_run(Script* script);
+
+/**
+ * @brief Release a compiled script.
+ *
+ * @param script The compiled script. May be NULL.
+ */
+void script_unref(Script* script);
+
 #endif
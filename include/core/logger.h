@@ -1,6 +1,7 @@
 #ifndef _logger_h
 #define _logger_h
 #include <stdbool.h>
+#include <stdio.h>
 
 /**
  * @file logger.h
@@ -49,6 +50,25 @@
  */
 void logger_set_status(int type, bool status);
 
+/**
+ * @brief Set where PRINT messages of the calling thread go.
+ *
+ * Other threads keep printing to stdout, so output of one thread can be
+ * captured while others run. Children started with run_args() write their
+ * stdout there too.
+ *
+ * @param output Stream for PRINT messages, or NULL for stdout.
+ * @return The previous stream of the thread, restore it when done.
+ */
+FILE* logger_set_output(FILE* output);
+
+/**
+ * @brief Get the stream set by logger_set_output() on the calling thread.
+ *
+ * @return The stream, or NULL if the thread prints to stdout.
+ */
+FILE* logger_get_output();
+
 /**
  * @brief Print a formatted message to the log.
  *
@@ -86,6 +86,18 @@ typedef struct {
  */
 void operation_register(OperationManager *manager, Operation new_op);
 
+/**
+ * @brief Marks an operation as safe to run on several threads at once.
+ *
+ * Operations keep their state in globals, so ympsh parallel blocks and
+ * background lines run them one at a time. Operations marked here run
+ * alongside each other and alongside one of the others.
+ *
+ * @param manager A pointer to the `OperationManager` instance.
+ * @param name Name or alias of a registered operation.
+ */
+void operation_set_thread_safe(OperationManager *manager, const char *name);
+
 /**
  * @brief Creates a new OperationManager instance.
  *
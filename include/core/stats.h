@@ -0,0 +1,116 @@
+#ifndef _stats_h
+#define _stats_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @file stats.h
+ * @brief Process wide I/O and CPU counters
+ *
+ * Counters are plain atomic totals that any thread may increment. They are
+ * printed after a ymp run when the `--stats` option is set, together with
+ * the peak resident set size and the wall time of each phase. A phase is
+ * the time during which at least one trace span of that name is open (see
+ * trace.h), so concurrent downloads count once.
+ */
+
+/**
+ * @brief Counters of the registry.
+ */
+typedef enum {
+    STATS_BYTES_DOWNLOADED, /**< Bytes received from the network. */
+    STATS_BYTES_REUSED,     /**< Bytes taken from a local cache instead of a download. */
+    STATS_BYTES_SHA512,     /**< Bytes hashed with SHA-512. */
+    STATS_BYTES_SHA256,     /**< Bytes hashed with SHA-256. */
+    STATS_BYTES_SHA1,       /**< Bytes hashed with SHA-1. */
+    STATS_BYTES_MD5,        /**< Bytes hashed with MD5. */
+    STATS_BYTES_YAML,       /**< Bytes of YAML data parsed. */
+    STATS_FILES_EXTRACTED,  /**< Archive entries extracted. */
+    STATS_FILES_SYNCED,     /**< Files and links synced from the quarantine. */
+    STATS_FILES_REMOVED,    /**< Installed files removed. */
+    STATS_DIRS_CREATED,     /**< Directories created. */
+    STATS_FORKS_GPG,        /**< gpg processes spawned. */
+    STATS_FORKS_BASH,       /**< bash processes spawned. */
+    STATS_FORKS_OBJCOPY,    /**< objcopy processes spawned. */
+    STATS_MAX
+} StatsCounter;
+
+/**
+ * @brief Add to a counter.
+ *
+ * @param counter The counter.
+ * @param value Amount to add.
+ */
+void stats_add(StatsCounter counter, uint64_t value);
+
+/**
+ * @brief Get the value of a counter.
+ *
+ * @param counter The counter.
+ * @return The current total.
+ */
+uint64_t stats_get(StatsCounter counter);
+
+/**
+ * @brief Start or stop collecting phase wall times.
+ *
+ * Counters are always collected, phases only while this is enabled.
+ *
+ * @param status `true` to collect phases, `false` to stop.
+ */
+void stats_set_status(bool status);
+
+/**
+ * @brief Check whether phase wall times are collected.
+ *
+ * @return `true` if phases are collected, `false` otherwise.
+ */
+bool stats_enabled();
+
+/**
+ * @brief Record that a span of a phase was opened.
+ *
+ * Called by trace_begin().
+ *
+ * @param name Name of the phase.
+ */
+void stats_phase_enter(const char* name);
+
+/**
+ * @brief Record that a span of a phase was closed.
+ *
+ * Called by trace_end().
+ *
+ * @param name Name of the phase, as given to stats_phase_enter().
+ */
+void stats_phase_leave(const char* name);
+
+/**
+ * @brief Get the wall time of a phase.
+ *
+ * @param name Name of the phase.
+ * @param count Set to the number of closed spans of the phase, may be NULL.
+ * @return Wall time in nanoseconds, 0 if the phase is unknown.
+ */
+uint64_t stats_phase_get(const char* name, uint64_t* count);
+
+/**
+ * @brief Reset every counter and phase.
+ */
+void stats_reset();
+
+/**
+ * @brief Print the counters, the peak RSS and the phase wall times.
+ *
+ * Counters that are zero are skipped.
+ *
+ * @code
+ * stats_set_status(true);
+ * ymp_run(ymp);
+ * stats_print();
+ * @endcode
+ */
+void stats_print();
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef _trace_h
+#define _trace_h
+
+#include <stdbool.h>
+
+/**
+ * @file trace.h
+ * @brief Timing spans exported as Chrome trace JSON
+ *
+ * Spans record where the time of an operation goes. Each thread keeps its
+ * own stack of open spans, so spans may be used from job workers. A closed
+ * span is written as a complete event of the Chrome trace format, which
+ * chrome://tracing and Perfetto can open. The `--trace=file.json` option
+ * enables tracing for a ymp run.
+ *
+ * Spans also measure the phase wall times of stats.h. While tracing and
+ * stats are off, trace_begin() and trace_end() only test two flags and
+ * return.
+ */
+
+/**
+ * @brief Start writing spans to a file.
+ *
+ * @param path Path of the JSON file. Nothing is done for NULL or an empty path.
+ * @return `true` if tracing was started by this call, `false` otherwise.
+ */
+bool trace_start(const char* path);
+
+/**
+ * @brief Stop tracing and finish the JSON file.
+ *
+ * Spans still open are not written.
+ */
+void trace_stop();
+
+/**
+ * @brief Check whether tracing is on.
+ *
+ * @return `true` if spans are written, `false` otherwise.
+ */
+bool trace_enabled();
+
+/**
+ * @brief Open a span on the calling thread.
+ *
+ * Spans nest, every trace_begin() must be closed by a trace_end() on the
+ * same thread.
+ *
+ * @param name Name of the span. It must stay valid until the span is
+ *        closed, a string literal is expected.
+ * @param format printf like format of the span detail, or NULL.
+ * @param ... Arguments for the format string.
+ *
+ * @code
+ * trace_begin("extract", "%s", pkg->name);
+ * archive_extract_all(data);
+ * trace_end();
+ * @endcode
+ */
+void trace_begin(const char* name, const char* format, ...);
+
+/**
+ * @brief Close the innermost span of the calling thread.
+ */
+void trace_end();
+
+#endif
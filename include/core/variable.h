@@ -97,8 +97,9 @@ invisible void set_value_read_only(const char* name, const char* value);
  *
  * @param variables Pointer to the `VariableManager` instance.
  * @param name The name of the variable to retrieve.
- * @return A pointer to the value of the variable, or NULL if the variable
- *         does not exist.
+ * @return A pointer to the value of the variable, or an empty string if the
+ *         variable does not exist. Reads do not take a lock. The value
+ *         stays valid until the variables are unpinned, see variable_pin().
  *
  * @code
  * char *val = variable_get_value(vm, "debug");
@@ -113,6 +114,98 @@ invisible char* get_value(const char* name);
 #define get_bool(A) (strcmp(get_value(A), "true") == 0)
 /** @endcond */
 
+/**
+ * @brief Keep replaced values alive.
+ *
+ * Values replaced while the variables are pinned are freed by the last
+ * variable_unpin(), so values read meanwhile stay valid on every thread.
+ * Operations, ympsh branches and job sets pin the global variables while
+ * they run. Without a pin a set frees the old value at once, threads that
+ * read variables while others set them must hold a pin.
+ *
+ * @param variables Pointer to the `VariableManager` instance.
+ */
+void variable_pin(VariableManager* variables);
+
+/**
+ * @brief Release a pin taken by variable_pin().
+ *
+ * @param variables Pointer to the `VariableManager` instance.
+ */
+void variable_unpin(VariableManager* variables);
+
+/**
+ * @brief Set the options of the current thread.
+ *
+ * Variables set in the options shadow the global variables for reads on
+ * this thread, so ympsh branches running at the same time can be given
+ * different `--flags`. Job sets started by the thread read them too.
+ *
+ * @param variables Options of the thread, or NULL for none.
+ * @return The previous options of the thread.
+ */
+VariableManager* variable_set_options(VariableManager* variables);
+
+/**
+ * @brief Get the options of the current thread.
+ *
+ * @return The options set by variable_set_options(), or NULL.
+ */
+VariableManager* variable_get_options();
+
+
+/**
+ * @brief Stable reference to a single variable.
+ *
+ * A handle stays valid until its `VariableManager` is released and always
+ * reads the latest value, so hot paths can resolve a name once and skip the
+ * lookup afterwards.
+ */
+typedef struct VariableHandle VariableHandle;
+
+/**
+ * @brief Get a handle for a variable.
+ *
+ * The variable does not need to exist yet. Until it is set, reading the
+ * handle returns an empty string.
+ *
+ * @param variables Pointer to the `VariableManager` instance.
+ * @param name The name of the variable.
+ * @return The handle, or NULL if the allocation fails.
+ *
+ * @code
+ * VariableHandle *debug = variable_lookup(vm, "debug");
+ * while (work()) {
+ *     if (strcmp(variable_handle_get(debug), "true") == 0) {
+ *         // debug mode enabled
+ *     }
+ * }
+ * @endcode
+ */
+VariableHandle* variable_lookup(VariableManager* variables, const char* name);
+
+/**
+ * @brief Get the current value of a variable handle.
+ *
+ * Reads do not take a lock and are safe while other threads set variables.
+ * The returned string stays valid until the variables are unpinned, see
+ * variable_pin().
+ *
+ * @param handle Handle returned by variable_lookup().
+ * @return The value, or an empty string if the variable is not set.
+ */
+char* variable_handle_get(VariableHandle* handle);
+
+/**
+ * @brief Copy the current value of a variable handle.
+ *
+ * Unlike variable_handle_get(), the copy stays valid after the variables
+ * are unpinned.
+ *
+ * @param handle Handle returned by variable_lookup().
+ * @return A copy of the value, an empty string if it is not set. Free it.
+ */
+char* variable_handle_dup(VariableHandle* handle);
 
 /**
  * @brief Get variable names list.
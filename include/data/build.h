@@ -18,9 +18,11 @@
  * This structure holds the context, path, and header information for a YMP build.
  */
 typedef struct {
-    char* ctx;    /**< Pointer to the context string. */
-    char* path;   /**< Pointer to the path string. */
-    char* header; /**< Pointer to the header string. */
+    char* ctx;       /**< Pointer to the context string. */
+    char* path;      /**< Pointer to the path string. */
+    char* header;    /**< Pointer to the header string. */
+    void* priv_data; /**< Variables evaluated from `ctx`, filled on first lookup. */
+    void* sandbox;   /**< Sandbox shared by the build phases, see ympbuild_run_function(). */
 } ympbuild;
 
 /**
@@ -29,6 +31,9 @@ typedef struct {
  * This function searches for a specific name in the YMP build context and returns
  * the corresponding value as a string. If the name is not found, NULL is returned.
  *
+ * The ympbuild is sourced by a single sandboxed bash on the first lookup and
+ * every variable is cached, later lookups of any value or array do not fork.
+ *
  * @param ymp Pointer to a `ympbuild` structure containing the build context.
  * @param name The name of the value to retrieve.
  * 
@@ -141,6 +146,9 @@ char *create_package(const char* path);
  * such as building, compiling, or processing based on the function's
  * implementation.
  *
+ * The first call prepares a sandbox with its own rootfs, later calls on the
+ * same build join it instead of mounting everything again.
+ *
  * @param ymp Pointer to the YMP build context structure.
  * @param name The name of the function to execute.
  * @return int Returns 0 on success, or a negative error code on failure.
@@ -1,5 +1,6 @@
 #ifndef _package_h
 #define _package_h
+#include <utils/arena.h>
 #include <utils/archive.h>
 
 /**
@@ -32,6 +33,7 @@ typedef struct {
     void* repo; /**< Address of repository */
     array *errors; /**< List of errors encountered during package processing */
     Archive *archive; /**< Pointer to the package archive */
+    arena *owner; /**< Arena holding the package when loaded from an index */
     /** @endcond */
 } Package;
 
@@ -46,6 +48,19 @@ typedef struct {
  */
 Package* package_new();
 
+/**
+ * @brief Initializes a new Package structure inside an arena.
+ *
+ * The package and the strings loaded by package_load_from_metadata() are
+ * allocated from the arena and released with it. The archive is created
+ * on demand when the package is loaded from a file.
+ *
+ * @param a The arena owning the package.
+ * @return A pointer to the newly created Package structure, or NULL if
+ *         the allocation fails.
+ */
+Package* package_new_arena(arena *a);
+
 /**
  * @brief Loads a package from a specified file.
  *
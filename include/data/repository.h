@@ -1,6 +1,8 @@
 #ifndef _repository_h
 #define _repository_h
 
+#include <stdint.h>
+
 #include <data/package.h>
 
 /**
@@ -10,6 +12,49 @@
  * This header defines the Repository structure and functions for
  * loading, querying, and downloading packages from repositories.
  */
+/** @def REPOSITORY_SOURCE
+ * @brief Table row flag for source packages.
+ */
+#define REPOSITORY_SOURCE 1
+
+/** @def REPOSITORY_HAS_NAME
+ * @brief Table row flag set when the package has a name.
+ */
+#define REPOSITORY_HAS_NAME 2
+
+/** @def REPOSITORY_HAS_DEPENDS
+ * @brief Table row flag set when the package has a depends list.
+ */
+#define REPOSITORY_HAS_DEPENDS 4
+
+/** @def REPOSITORY_HAS_GROUPS
+ * @brief Table row flag set when the package has a group list.
+ */
+#define REPOSITORY_HAS_GROUPS 8
+
+/**
+ * @struct RepositoryTable
+ * @brief Compact column storage of a repository index.
+ *
+ * Every string is stored once in `strings` and referenced by id. The
+ * dependencies of row `i` are `depends[depends_index[i]]` up to
+ * `depends[depends_index[i + 1]]`, groups use the same layout.
+ */
+typedef struct {
+    size_t length;          /**< Number of rows. */
+    uint32_t* name;         /**< Name string id of each row. */
+    uint32_t* version;      /**< Version string id of each row. */
+    int* release;           /**< Release number of each row. */
+    uint8_t* flags;         /**< REPOSITORY_* flags of each row. */
+    const char** metadata;  /**< Metadata text of each row. */
+    size_t* depends_index;  /**< Offsets into depends, length + 1 entries. */
+    uint32_t* depends;      /**< Dependency string ids. */
+    size_t* groups_index;   /**< Offsets into groups, length + 1 entries. */
+    uint32_t* groups;       /**< Group string ids. */
+    const char** strings;   /**< String table indexed by id. */
+    size_t string_count;    /**< Number of strings. */
+} RepositoryTable;
+
 /**
  * @struct Repository
  * @brief Represents a package repository.
@@ -22,6 +67,8 @@ typedef struct {
     const char* name;         /**< The name of the repository. */
     Package** packages;      /**< Array of pointers to packages in the repository. */
     size_t package_count;    /**< The number of packages in the repository. */
+    RepositoryTable* table;  /**< Compact package table, NULL unless the compact-index variable is set. */
+    void* priv_data;         /* Private data. Do not touch! */
 } Repository;
 
 /**
@@ -87,6 +134,51 @@ bool repository_download_package(Repository* repo, const char* name, bool is_sou
  */
 Package* repository_get(Repository *repo, const char* name, bool is_source);
 
+/**
+ * @brief Retrieves a package by index.
+ *
+ * With a compact table, `packages[index]` stays NULL until the package is
+ * first requested. Use this function instead of reading `packages` directly.
+ *
+ * @param repo Pointer to the Repository instance.
+ * @param index Package index, lower than `package_count`.
+ * @return A pointer to the Package, or NULL if the index is invalid.
+ *
+ * @code
+ * for (size_t i = 0; i < repo->package_count; i++) {
+ *     Package *pkg = repository_package_at(repo, i);
+ * }
+ * @endcode
+ */
+Package* repository_package_at(Repository *repo, size_t index);
+
+/**
+ * @brief Gets the name of a package by index without materializing it.
+ *
+ * @param repo Pointer to the Repository instance.
+ * @param index Package index, lower than `package_count`.
+ * @return The package name, or NULL if it is not set.
+ */
+const char* repository_name_at(Repository *repo, size_t index);
+
+/**
+ * @brief Gets the metadata of a package by index without materializing it.
+ *
+ * @param repo Pointer to the Repository instance.
+ * @param index Package index, lower than `package_count`.
+ * @return The package metadata text, or NULL if the index is invalid.
+ */
+const char* repository_metadata_at(Repository *repo, size_t index);
+
+/**
+ * @brief Checks whether a package is a source package without materializing it.
+ *
+ * @param repo Pointer to the Repository instance.
+ * @param index Package index, lower than `package_count`.
+ * @return true for source packages, false otherwise.
+ */
+bool repository_is_source_at(Repository *repo, size_t index);
+
 /**
  * @brief Releases the resources associated with the Repository.
  *
@@ -67,6 +67,9 @@ void archive_load(Archive *data, const char* path);
 /**
  * @brief Sets the target extraction path for the archive.
  *
+ * archive_create() reads relative paths added by archive_add() from the
+ * target too, instead of the current directory.
+ *
  * @param data Pointer to the Archive instance.
  * @param target Path where the archive will be extracted.
  *
@@ -0,0 +1,99 @@
+#ifndef _arena_h
+#define _arena_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** @file arena.h
+ * @brief Region allocator for objects sharing one lifetime
+ *
+ * Memory is carved out of large chunks and released all at once by
+ * arena_unref(). There is no per-object free. An arena is not thread-safe;
+ * callers sharing one between threads must serialize access.
+ */
+
+/**
+ * @brief Arena allocator.
+ */
+typedef struct arena arena;
+
+/**
+ * @brief Create a new arena.
+ *
+ * @param chunk_size Size of the first chunk in bytes. Use 0 for the default.
+ *        Later chunks grow geometrically.
+ * @return A pointer to the new arena, or NULL if the allocation fails.
+ *
+ * @code
+ * arena *a = arena_new(0);
+ * char *name = arena_strdup(a, "curl");
+ * arena_unref(a); // releases name too
+ * @endcode
+ */
+arena *arena_new(size_t chunk_size);
+
+/**
+ * @brief Allocate memory from the arena.
+ *
+ * The memory is suitably aligned for any type.
+ *
+ * @param a Pointer to the arena.
+ * @param size Number of bytes to allocate.
+ * @return Pointer to the memory, or NULL if the allocation fails.
+ */
+void *arena_alloc(arena *a, size_t size);
+
+/**
+ * @brief Allocate zero filled memory from the arena.
+ *
+ * @param a Pointer to the arena.
+ * @param count Number of elements.
+ * @param size Size of an element.
+ * @return Pointer to the memory, or NULL if the allocation fails.
+ */
+void *arena_calloc(arena *a, size_t count, size_t size);
+
+/**
+ * @brief Copy a string into the arena.
+ *
+ * @param a Pointer to the arena.
+ * @param str The string to copy. May be NULL.
+ * @return The copy, or NULL if str is NULL or the allocation fails.
+ */
+char *arena_strdup(arena *a, const char *str);
+
+/**
+ * @brief Copy at most len bytes of a string into the arena.
+ *
+ * @param a Pointer to the arena.
+ * @param str The string to copy.
+ * @param len Maximum number of bytes to copy.
+ * @return The NULL terminated copy, or NULL if the allocation fails.
+ */
+char *arena_strndup(arena *a, const char *str, size_t len);
+
+/**
+ * @brief Check whether a pointer was allocated from the arena.
+ *
+ * @param a Pointer to the arena. May be NULL.
+ * @param ptr The pointer to check.
+ * @return `true` if ptr points into the arena, `false` otherwise.
+ */
+bool arena_owns(const arena *a, const void *ptr);
+
+/**
+ * @brief Get the number of bytes reserved by the arena.
+ *
+ * @param a Pointer to the arena.
+ * @return The total size of all chunks.
+ */
+size_t arena_size(const arena *a);
+
+/**
+ * @brief Release the arena and everything allocated from it.
+ *
+ * @param a Pointer to the arena.
+ */
+void arena_unref(arena *a);
+
+#endif
@@ -105,6 +105,44 @@ void array_set(array *arr, char** new_data);
  */
 char **array_get(array *arr, size_t* len);
 
+/**
+ * @brief Take the contents of the dynamic array and release it.
+ *
+ * Unlike array_get(), no string is copied. The NULL terminated vector and
+ * its strings are handed to the caller and the array itself is freed.
+ *
+ * @param arr Pointer to the dynamic array. It must not be used afterwards.
+ * @param len Length of dynamic array.
+ * @return Pointer to the array of strings. Free every string and the vector.
+ *
+ * @code
+ * array *arr = array_new();
+ * array_add(arr, "foo");
+ * char **items = array_steal(arr, NULL);
+ * @endcode
+ */
+char **array_steal(array *arr, size_t* len);
+
+/**
+ * @brief Borrow the contents of the dynamic array.
+ *
+ * No string is copied. The returned NULL terminated vector is owned by the
+ * array and stays valid until the array is modified or released.
+ *
+ * @param arr Pointer to the dynamic array.
+ * @param len Length of dynamic array.
+ * @return Pointer to the array of strings. Do not free it.
+ *
+ * @code
+ * size_t len;
+ * char **items = array_view(arr, &len);
+ * for (size_t i = 0; i < len; i++) {
+ *     printf("%s\n", items[i]);
+ * }
+ * @endcode
+ */
+char **array_view(array *arr, size_t* len);
+
 /**
  * @brief Get a single concatenated string from the dynamic array.
  *
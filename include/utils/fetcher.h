@@ -39,5 +39,21 @@ typedef void (*FetchProgressCallback)(const char* url, size_t downloaded, size_t
 bool fetch_with_progress(const char* url, const char* path, FetchProgressCallback cb, void* userdata);
 #define fetch(A, B) fetch_with_progress(A, B, NULL, NULL)
 
+/**
+ * @brief Downloads a file and hashes it while it is written.
+ *
+ * Same as fetch_with_progress() but the data is hashed as it arrives, so
+ * the file does not have to be read again to verify it.
+ *
+ * @param url The URL to download from.
+ * @param path The local file path to save to.
+ * @param type Hash algorithm, one of the constants of hash.h.
+ * @param hash Set to the hexadecimal hash of the downloaded data on success. Free it.
+ * @param cb Optional progress callback function, may be NULL.
+ * @param userdata User data passed to the progress callback.
+ * @return true if the download succeeded, false otherwise.
+ */
+bool fetch_with_hash(const char* url, const char* path, int type, char** hash, FetchProgressCallback cb, void* userdata);
+
 #endif
 
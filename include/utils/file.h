@@ -164,6 +164,21 @@ void format_size(char *buf, size_t buf_len, size_t bytes);
 char* getoutput_unshare(char* argv[], int flags);
 #define getoutput(A) getoutput_unshare(A, 0)
 
+/**
+ * @brief Executes a command and returns its output with the length.
+ *
+ * Same as getoutput_unshare() but the output may contain NUL bytes, so
+ * commands can print NUL delimited records.
+ *
+ * @param argv NULL terminated command and arguments.
+ * @param flags Unshare flags.
+ * @param size Set to the number of bytes read when not NULL.
+ *
+ * @return Output of the command with a terminating NUL after `size` bytes,
+ *         or NULL on failure. Free it.
+ */
+char* getoutput_unshare_size(char* argv[], int flags, size_t* size);
+
 /**
  * @brief Copies a file from the source path to the destination path.
  *
@@ -171,6 +186,10 @@ char* getoutput_unshare(char* argv[], int flags);
  * the `sourceFile` parameter to the file specified by the `destFile`
  * parameter. If the destination file already exists, it will be overwritten.
  *
+ * The data is copied with the cheapest method the filesystem supports: a
+ * reflink (FICLONE), copy_file_range(), sendfile() and finally a read and
+ * write loop. Symlinks are copied as symlinks and the mode is kept.
+ *
  * @param sourceFile The path to the source file to be copied.
  * @param destFile The path to the destination file where the source file
  *                 will be copied.
@@ -209,6 +228,7 @@ bool copy_file(const char *sourceFile, const char *destFile);
  *
  * @note This function will create the destination directory if it does not already exist.
  *       It will copy all files and subdirectories, preserving the directory structure.
+ *       The tree is walked relative to directory descriptors, so path length is not limited.
  *
  * @warning If the destination directory already exists, its contents will be overwritten
  *          without any confirmation. Ensure that you want to overwrite existing files.
@@ -228,6 +248,21 @@ bool copy_directory(const char *sourceDir, const char *destDir);
  * @return true if the move succeeded, false otherwise.
  */
 bool move_file(const char* src, const char* dest);
+
+/**
+ * @brief Makes a file available at a second path without copying the data.
+ *
+ * Tries a hard link first, then copy_file(), which shares extents where
+ * the filesystem supports reflinks.
+ * Both paths share the data, so neither should be modified in place.
+ * The file is prepared under a temporary name next to `dest` and renamed
+ * over it, so readers never see a partial copy.
+ *
+ * @param src The existing file.
+ * @param dest The new path. Its directory is created, an existing file is replaced.
+ * @return true if the file is available at `dest`, false otherwise.
+ */
+bool link_file(const char* src, const char* dest);
 /**
  * @brief Reads the target of a symbolic link.
  *
@@ -292,4 +327,16 @@ bool remove_all(const char* path);
  */
 bool is_elf(const char* path);
 
+/**
+ * @brief Checks if an open file is an ELF file.
+ *
+ * Reads the magic bytes with pread(), so the file offset is not changed and
+ * callers walking a tree can check a file they already opened.
+ *
+ * @param fd Open file descriptor.
+ *
+ * @return Returns true if the file starts with the ELF magic.
+ */
+bool is_elf_fd(int fd);
+
 #endif
@@ -1,6 +1,8 @@
 #ifndef _hash_h
 #define _hash_h
 
+#include <stddef.h>
+
 /**
  * @file hash.h
  * @brief File hash calculation utilities.
@@ -44,6 +46,46 @@
  */
 char *calculate_hash(int type, const char *path);
 
+/**
+ * @brief Incremental hash of data that arrives in pieces.
+ */
+typedef struct hash_stream hash_stream;
+
+/**
+ * @brief Start an incremental hash.
+ *
+ * @param type The hash algorithm type constant.
+ * @return A new hash stream, or NULL on failure. Finish it with hash_stream_final().
+ */
+hash_stream *hash_stream_new(int type);
+
+/**
+ * @brief Add data to an incremental hash.
+ *
+ * @param h Hash stream, may be NULL.
+ * @param data Data to hash.
+ * @param len Length of the data in bytes.
+ */
+void hash_stream_update(hash_stream *h, const void *data, size_t len);
+
+/**
+ * @brief Finish an incremental hash.
+ *
+ * The stream is released.
+ *
+ * @param h Hash stream, may be NULL.
+ * @return The same hexadecimal string calculate_hash() returns for the
+ *         same data, or NULL on failure. The caller must free it.
+ *
+ * @code
+ * hash_stream *h = hash_stream_new(SHA256);
+ * hash_stream_update(h, "hello", 5);
+ * char *hash = hash_stream_final(h);
+ * free(hash);
+ * @endcode
+ */
+char *hash_stream_final(hash_stream *h);
+
 /**
  * @brief Calculates the SHA-1 hash of a file.
  *
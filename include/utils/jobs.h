@@ -10,6 +10,22 @@
  * @brief parallel job control and management
  */
 
+/**
+ * @brief Resource class of a job.
+ *
+ * Jobs of a class share a process wide limit across every running job set,
+ * set by the `jobs-cpu`, `jobs-io` and `jobs-net` variables
+ * (e.g. `--jobs-net=8`). Jobs of JOBS_CLASS_ANY are only limited by the
+ * `parallel` width of their set.
+ */
+typedef enum {
+    JOBS_CLASS_ANY, /**< No class limit. This is the default. */
+    JOBS_CLASS_CPU, /**< Hashing, compression and other CPU bound work. Defaults to the number of CPUs. */
+    JOBS_CLASS_IO,  /**< Extraction, copying and other disk bound work. Defaults to the number of CPUs. */
+    JOBS_CLASS_NET, /**< Downloads. Defaults to 8. */
+    JOBS_CLASS_MAX
+} JobsClass;
+
 /**
  * @brief Job structure.
  *
@@ -20,6 +36,7 @@ typedef struct {
     void* args;    /**< Arguments to pass to the callback function. */
     void* ctx;     /**< Context for the job, can be used to store additional information. */
     int id;        /**< Unique identifier for the job. */
+    JobsClass resource; /**< Resource class, set by jobs_set_class(). */
 } job;
 
 /**
@@ -37,6 +54,10 @@ typedef struct {
     int total;              /**< Total number of jobs added to the manager. */
     pthread_cond_t cond;    /**< Condition variable for signaling job completion. */
     bool failed;            /**< is Jobs failed */
+    bool isolated;          /**< Runners are not picked up by threads waiting for other sets, for jobs that must not run inside another job. */
+/** @cond */
+    void* priv_data;        /* Private data. Do not touch! */
+/** @endcond */
 } jobs;
 
 /**
@@ -48,6 +69,11 @@ typedef struct {
  */
 void jobs_unref(jobs *j);
 
+/** @def JOBS_END
+ * @brief Terminates the dependency list of jobs_add_after().
+ */
+#define JOBS_END -1
+
 /**
  * @brief Add a job to the job manager.
  *
@@ -59,14 +85,63 @@ void jobs_unref(jobs *j);
  * @param ctx Context for the job.
  * @param args Arguments to pass to the callback function.
  * @param ... Additional arguments for the callback function (if needed).
+ * @return The job id, used with jobs_add_after().
  */
-void jobs_add(jobs* j, callback call, void* ctx, void* args, ...);
+int jobs_add(jobs* j, callback call, void* ctx, void* args, ...);
+
+/**
+ * @brief Make a job wait for other jobs.
+ *
+ * The job starts only after every listed job finished successfully. Jobs
+ * without dependencies start in the order they were added, and each finished
+ * job releases its successors right away, so independent chains overlap
+ * instead of waiting for a whole phase. When a job fails, the set is marked
+ * as failed and its dependents never run.
+ *
+ * @param j Pointer to the job manager.
+ * @param job_id Id of the waiting job, returned by jobs_add().
+ * @param deps Ids of the jobs to wait for, terminated by JOBS_END.
+ *
+ * @code
+ * int fetch = jobs_add(j, (callback) fetch_cb, pkg, NULL);
+ * int extract = jobs_add(j, (callback) extract_cb, pkg, NULL);
+ * int deps[] = { fetch, JOBS_END };
+ * jobs_add_after(j, extract, deps);
+ * jobs_run(j);
+ * @endcode
+ */
+void jobs_add_after(jobs* j, int job_id, const int* deps);
+
+/**
+ * @brief Set the resource class of a job.
+ *
+ * A job of a limited class waits until its class has a free slot. Jobs of
+ * a set started from inside a job take turns on the slot of the calling job,
+ * so nested job sets can not deadlock on the same class. More of them run at
+ * once only when the class has free slots.
+ *
+ * @param j Pointer to the job manager.
+ * @param job_id Id of the job, returned by jobs_add().
+ * @param resource Resource class of the job.
+ *
+ * @code
+ * int fetch = jobs_add(j, (callback) fetch_cb, pkg, NULL);
+ * jobs_set_class(j, fetch, JOBS_CLASS_NET);
+ * @endcode
+ */
+void jobs_set_class(jobs* j, int job_id, JobsClass resource);
 
 /**
  * @brief Run the jobs in the job manager.
  *
- * This function executes the jobs in the job manager, respecting the
- * parallelism constraints.
+ * This function submits the jobs to the process wide worker pool and waits
+ * until they are done. At most `parallel` jobs of the set run at once, and
+ * idle workers steal queued work from busy ones. The calling thread runs
+ * queued jobs while it waits, so jobs may call jobs_run() themselves. With
+ * `parallel` set to 1 the jobs run in order in the calling thread.
+ *
+ * When a job returns a value greater than 0, `failed` is set and jobs that
+ * have not started yet are skipped.
  *
  * @param j Pointer to the job manager.
  */
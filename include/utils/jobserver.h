@@ -0,0 +1,57 @@
+#ifndef _jobserver_h
+#define _jobserver_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @file jobserver.h
+ * @brief GNU make jobserver shared by concurrent builds
+ *
+ * The jobserver is a FIFO holding one byte for every job slot. Every make,
+ * and ninja 1.13 or newer, takes a byte before starting a job and writes it
+ * back when the job ends, so all builds using the same FIFO share one budget.
+ */
+
+/**
+ * @brief Jobserver structure.
+ */
+typedef struct {
+    char *dir;     /**< Directory of the FIFO, expose it to sandboxes. */
+    char *path;    /**< Path of the FIFO. */
+    size_t tokens; /**< Number of job slots. */
+    int fd;        /**< Read-write descriptor, keeps the FIFO open while builds run. */
+    bool fifo;     /**< Clients understand `--jobserver-auth=fifo:`, GNU make 4.4 or newer. */
+} jobserver;
+
+/**
+ * @brief Creates a jobserver.
+ *
+ * Creates the FIFO `dir/fifo` and fills it with `tokens - 1` bytes, every
+ * client owns one implicit slot.
+ *
+ * @param dir Directory of the FIFO, created if missing.
+ * @param tokens Number of job slots, at least 1.
+ * @return A new jobserver, or NULL on failure. Free it with jobserver_unref().
+ */
+jobserver *jobserver_new(const char *dir, size_t tokens);
+
+/**
+ * @brief Builds the MAKEFLAGS value of the clients.
+ *
+ * The FIFO form is used when the installed make supports it. Older make
+ * versions only take inherited descriptors, so `fd` must be a descriptor of
+ * the FIFO that stays open across exec.
+ *
+ * @param js The jobserver.
+ * @param fd A descriptor of the FIFO inherited by the clients, or -1.
+ * @return The value of MAKEFLAGS, like `-j8 --jobserver-auth=fifo:/path`. Free it.
+ */
+char *jobserver_makeflags(jobserver *js, int fd);
+
+/**
+ * @brief Removes the FIFO and frees the jobserver.
+ */
+void jobserver_unref(jobserver *js);
+
+#endif
@@ -23,10 +23,15 @@ typedef struct {
     gid_t gid;          /* host gid mapped to root */
     array *binds;       /* registered mounts as "src target" strings */
     bool network;       /* share the host network */
+    char *root;         /* rootfs, unique for each handle */
+    pid_t holder;       /* process keeping the prepared namespaces, 0 if not prepared */
 } sandbox_handle_t;
 
 /**
  * @brief Creates a sandbox handle with default settings.
+ *
+ * Every handle gets its own rootfs under `/tmp/ymp-root/<uuid>`, so
+ * sandboxes of concurrent builds do not share mount points.
  */
 sandbox_handle_t *sandbox_new();
 
@@ -45,15 +50,34 @@ void sandbox_configure_flags(sandbox_handle_t *sandbox, int flags);
  */
 void sandbox_configure_user(sandbox_handle_t *sandbox, uid_t uid, gid_t gid);
 
+/**
+ * @brief Creates the namespaces and mounts once for many processes.
+ *
+ * A holder process sets up the namespaces and the registered mounts and
+ * keeps them alive until sandbox_unref(). sandbox_apply() of a prepared
+ * handle only joins them, so every phase of a build reuses the same mounts.
+ *
+ * The user, mount, uts, network, ipc and cgroup namespaces can be joined.
+ * A handle with other flags, like CLONE_NEWPID, is not prepared.
+ *
+ * @return true if the sandbox was prepared, false otherwise. sandbox_apply()
+ *         still works on an unprepared handle.
+ */
+bool sandbox_prepare(sandbox_handle_t *sandbox);
+
 /**
  * @brief Applies the configuration and enters the sandbox.
  *
- * Creates the namespaces, sets the hostname and writes the id mappings.
+ * Creates the namespaces, sets the hostname and writes the id mappings,
+ * or joins the namespaces of sandbox_prepare(). The calling process must be
+ * single threaded to join a prepared sandbox.
  */
 void sandbox_apply(sandbox_handle_t *sandbox);
 
 /**
  * @brief Frees a sandbox handle.
+ *
+ * Stops the holder process of a prepared sandbox and removes its rootfs.
  */
 void sandbox_unref(sandbox_handle_t *sandbox);
 
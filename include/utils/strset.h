@@ -0,0 +1,330 @@
+#ifndef _strset_h
+#define _strset_h
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** @file strset.h
+ * @brief Hashed string set, string map and string interning pool
+ *
+ * `array` keeps insertion order but every lookup is a linear scan. The
+ * containers in this file use open addressing so `has`, `add` and `remove`
+ * run in constant time. They are meant for membership tests and lookups;
+ * use `array` when ordering matters.
+ */
+
+/** @def STRSET_LOCKED
+ * @brief Writers take a mutex. Readers never lock and may run concurrently with writers.
+ *
+ * Replaced tables and removed keys are freed by a later write once no reader
+ * is inside the map. A key returned by strmap_key() or strmap_iter() is valid
+ * until it is removed, do not keep it while other threads remove keys.
+ */
+#define STRSET_LOCKED 1
+
+/** @def STRSET_INTERN
+ * @brief Keys are interned into a string pool instead of being duplicated.
+ */
+#define STRSET_INTERN 2
+
+/** @def STRSET_BORROW
+ * @brief Keys are stored as given. The caller keeps them alive while they are in the container.
+ */
+#define STRSET_BORROW 4
+
+/**
+ * @brief String interning pool.
+ *
+ * Every distinct string is stored once and lives until the pool is released,
+ * so interned pointers can be shared freely between containers and threads.
+ */
+typedef struct strpool strpool;
+
+/**
+ * @brief Hashed string to pointer map.
+ */
+typedef struct {
+    /** @cond */
+    void *table;          /* current slot table, replaced atomically on resize */
+    void *retired;        /* replaced tables and keys kept alive for lock-free readers */
+    size_t readers;       /* lock-free readers inside the map, retired memory waits for 0 */
+    strpool *pool;        /* interning pool when STRSET_INTERN is set */
+    pthread_mutex_t lock; /* writer lock when STRSET_LOCKED is set */
+    /** @endcond */
+    size_t length;        /**< Number of live entries. */
+    int flags;            /**< STRSET_* flags given at creation. */
+} strmap;
+
+/**
+ * @brief Hashed string set.
+ *
+ * A set is a map without values and shares its implementation.
+ */
+typedef strmap strset;
+
+/**
+ * @brief Create a new string map.
+ *
+ * @param flags Bitwise OR of STRSET_LOCKED, STRSET_INTERN and STRSET_BORROW.
+ *        STRSET_INTERN uses the process wide pool returned by strpool_default().
+ * @return A pointer to the new map, or NULL if the allocation fails.
+ *
+ * @code
+ * strmap *m = strmap_new(0);
+ * strmap_set(m, "curl", pkg);
+ * Package *p = strmap_get(m, "curl");
+ * strmap_unref(m);
+ * @endcode
+ */
+strmap *strmap_new(int flags);
+
+/**
+ * @brief Create a new string map that interns its keys into the given pool.
+ *
+ * @param flags Bitwise OR of STRSET_* flags. STRSET_INTERN is implied.
+ * @param pool The pool used for the keys. It must outlive the map.
+ * @return A pointer to the new map, or NULL if the allocation fails.
+ */
+strmap *strmap_new_pool(int flags, strpool *pool);
+
+/**
+ * @brief Insert or replace a value.
+ *
+ * @param map Pointer to the map.
+ * @param key The key to set.
+ * @param value The value stored for the key.
+ */
+void strmap_set(strmap *map, const char *key, void *value);
+
+/**
+ * @brief Look up a value.
+ *
+ * @param map Pointer to the map.
+ * @param key The key to look up.
+ * @return The stored value, or NULL if the key is not in the map.
+ */
+void *strmap_get(strmap *map, const char *key);
+
+/**
+ * @brief Check whether a key is in the map.
+ *
+ * @param map Pointer to the map.
+ * @param key The key to look up.
+ * @return `true` if the key exists, `false` otherwise.
+ */
+bool strmap_has(strmap *map, const char *key);
+
+/**
+ * @brief Look up the stored copy of a key.
+ *
+ * @param map Pointer to the map.
+ * @param key The key to look up.
+ * @return The key owned by the map, or NULL if the key is not in the map.
+ */
+const char *strmap_key(strmap *map, const char *key);
+
+/**
+ * @brief Remove a key from the map.
+ *
+ * @param map Pointer to the map.
+ * @param key The key to remove.
+ * @return `true` if the key was removed, `false` if it was not in the map.
+ */
+bool strmap_remove(strmap *map, const char *key);
+
+/**
+ * @brief Start a lock-free read of memory retired through the map.
+ *
+ * Memory passed to strmap_retire() is not freed while a read is running.
+ * The lookups of the map do this themselves, use it for values the caller
+ * publishes and reads outside of the map.
+ *
+ * @param map Pointer to the map.
+ */
+void strmap_read_begin(strmap *map);
+
+/**
+ * @brief End a read started by strmap_read_begin().
+ *
+ * @param map Pointer to the map.
+ */
+void strmap_read_end(strmap *map);
+
+/**
+ * @brief Free memory once no lock-free reader of the map can see it.
+ *
+ * Unlink the memory first. Without STRSET_LOCKED it is freed at once,
+ * otherwise by a later write which finds no reader inside the map.
+ *
+ * @param map Pointer to the map.
+ * @param ptr Memory allocated with malloc().
+ */
+void strmap_retire(strmap *map, void *ptr);
+
+/**
+ * @brief Iterate over the entries of the map.
+ *
+ * Entries are returned in slot order, not insertion order.
+ *
+ * @param map Pointer to the map.
+ * @param pos Iteration cursor. Set it to 0 before the first call.
+ * @param key Receives the key of the next entry. May be NULL.
+ * @param value Receives the value of the next entry. May be NULL.
+ * @return `true` while an entry was returned, `false` at the end.
+ *
+ * @code
+ * size_t pos = 0;
+ * const char *key;
+ * void *value;
+ * while (strmap_iter(m, &pos, &key, &value)) {
+ *     printf("%s\n", key);
+ * }
+ * @endcode
+ */
+bool strmap_iter(strmap *map, size_t *pos, const char **key, void **value);
+
+/**
+ * @brief Get the number of entries in the map.
+ *
+ * @param map Pointer to the map.
+ * @return The number of entries.
+ */
+size_t strmap_length(const strmap *map);
+
+/**
+ * @brief Remove all entries from the map.
+ *
+ * @param map Pointer to the map.
+ */
+void strmap_clear(strmap *map);
+
+/**
+ * @brief Release the map and the keys it owns.
+ *
+ * Values are not freed.
+ *
+ * @param map Pointer to the map.
+ */
+void strmap_unref(strmap *map);
+
+/**
+ * @brief Create a new string set.
+ *
+ * @param flags Bitwise OR of STRSET_LOCKED, STRSET_INTERN and STRSET_BORROW.
+ * @return A pointer to the new set, or NULL if the allocation fails.
+ *
+ * @code
+ * strset *seen = strset_new(0);
+ * if (strset_add(seen, "curl")) {
+ *     // first time we see curl
+ * }
+ * strset_unref(seen);
+ * @endcode
+ */
+strset *strset_new(int flags);
+
+/**
+ * @brief Add a string to the set.
+ *
+ * @param set Pointer to the set.
+ * @param item The string to add.
+ * @return `true` if the string was added, `false` if it was already in the set.
+ */
+bool strset_add(strset *set, const char *item);
+
+/**
+ * @brief Check whether a string is in the set.
+ *
+ * @param set Pointer to the set.
+ * @param item The string to look up.
+ * @return `true` if the string exists, `false` otherwise.
+ */
+bool strset_has(strset *set, const char *item);
+
+/**
+ * @brief Remove a string from the set.
+ *
+ * @param set Pointer to the set.
+ * @param item The string to remove.
+ * @return `true` if the string was removed, `false` if it was not in the set.
+ */
+bool strset_remove(strset *set, const char *item);
+
+/**
+ * @brief Get the contents of the set.
+ *
+ * @param set Pointer to the set.
+ * @param len Receives the number of items. May be NULL.
+ * @return A NULL terminated vector of strings owned by the set. Free the
+ *         vector only, not the strings.
+ */
+const char **strset_get(strset *set, size_t *len);
+
+/**
+ * @brief Get the number of strings in the set.
+ *
+ * @param set Pointer to the set.
+ * @return The number of strings.
+ */
+size_t strset_length(const strset *set);
+
+/**
+ * @brief Release the set and the strings it owns.
+ *
+ * @param set Pointer to the set.
+ */
+void strset_unref(strset *set);
+
+/**
+ * @brief Create a new string pool.
+ *
+ * @return A pointer to the new pool, or NULL if the allocation fails.
+ */
+strpool *strpool_new();
+
+/**
+ * @brief Get the process wide string pool.
+ *
+ * The pool is created on first use and is never released.
+ *
+ * @return The shared pool.
+ */
+strpool *strpool_default();
+
+/**
+ * @brief Intern a string.
+ *
+ * This function is thread-safe.
+ *
+ * @param pool Pointer to the pool.
+ * @param str The string to intern.
+ * @return The pooled copy of the string. Equal strings return the same pointer.
+ *
+ * @code
+ * const char *a = strpool_intern(strpool_default(), "curl");
+ * const char *b = strpool_intern(strpool_default(), "curl");
+ * // a == b
+ * @endcode
+ */
+const char *strpool_intern(strpool *pool, const char *str);
+
+/**
+ * @brief Release the pool and every string interned into it.
+ *
+ * @param pool Pointer to the pool.
+ */
+void strpool_unref(strpool *pool);
+
+/**
+ * @brief Hash a string.
+ *
+ * This is the hash used by the containers in this file.
+ *
+ * @param str The string to hash.
+ * @return The 32 bit FNV-1a hash of the string.
+ */
+uint32_t strset_hash(const char *str);
+
+#endif
@@ -1,6 +1,7 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -136,7 +137,7 @@ static void *handle_client(void *arg) {
     memset(buffer, 0, sizeof(buffer));
     // Read the request from the client
     char *res;
-    char *path = "/";
+    char *path = NULL;  // requested path, "/" if the request has no GET line
     char *serve_path = realpath(serve, NULL);
     int bytes_read = read(client_fd, buffer, sizeof(buffer) - 1);
     if (bytes_read < 0) {
@@ -185,7 +186,7 @@ static void *handle_client(void *arg) {
         free(lines[i]);
     }
     // build requested path
-    char* tmp = build_string("%s/%s", serve_path, path);
+    char* tmp = build_string("%s/%s", serve_path, path ? path : "/");
     free(path);
     // decode url
     path = url_decode(tmp);
@@ -254,6 +255,8 @@ static int httpd(char **args) {
     }
     struct sockaddr_in addr;
     int addrlen = sizeof(addr);
+    // A client closing early must not kill the server
+    signal(SIGPIPE, SIG_IGN);
     int fd = socket(AF_INET, SOCK_STREAM, 0);
     if (fd < 0) {
         print(_("Error opening socket\n"));
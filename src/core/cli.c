@@ -4,6 +4,8 @@
 
 #include <core/interpreter.h>
 #include <core/logger.h>
+#include <core/stats.h>
+#include <core/trace.h>
 #include <core/ymp.h>
 #include <utils/color.h>
 #include <utils/error.h>
@@ -32,7 +34,18 @@ visible int ymp_main(int argc, char **argv) {
             return 0;
         }
         if (isfile(argv[1])) {
-            return run_script(readfile(argv[1]));
+            (void) parse_args(argv + 2, false);
+            bool tracing = trace_start(variable_get_value(ymp->variables, "trace"));
+            bool stats = iseq(variable_get_value(ymp->variables, "stats"), "true");
+            stats_set_status(stats);
+            int status = run_script_file(argv[1]);
+            if (tracing) {
+                trace_stop();
+            }
+            if (stats) {
+                stats_print();
+            }
+            return status;
         }
         ymp_add(ymp, argv[1], parse_args(argv + 2, false));
     } else {
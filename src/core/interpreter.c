@@ -1,80 +1,182 @@
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
+#include <core/interpreter.h>
 #include <core/logger.h>
+#include <core/variable.h>
 #include <core/ymp.h>
-#include <utils/array.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <utils/arena.h>
 #include <utils/error.h>
+#include <utils/jobs.h>
 #include <utils/string.h>
+#include <utils/strset.h>
 
+#define SCRIPT_CACHE_MAGIC 0x32434853504d59ULL  // "YMPSHC2"
+#define NO_JUMP SIZE_MAX
+
+typedef enum {
+    SEGMENT_TEXT,
+    SEGMENT_VARIABLE,
+    SEGMENT_COMMAND,
+} SegmentType;
+
+typedef struct Token Token;
+
+// Part of a token. Variables and commands are expanded when the line runs.
+typedef struct {
+    SegmentType type;
+    char *text;             // literal text, variable name or command
+    VariableHandle *handle; // bound variable, SEGMENT_VARIABLE only
+    Token *tokens;          // tokenized command, SEGMENT_COMMAND only
+    size_t count;
+} Segment;
+
+struct Token {
+    Segment *segments;
+    size_t count;
+};
+
+typedef enum {
+    INSTR_CALL,
+    INSTR_IF,
+    INSTR_ENDIF,
+    INSTR_WHILE,
+    INSTR_ENDWHILE,
+    INSTR_PARALLEL,
+    INSTR_ENDPARALLEL,
+    INSTR_WAIT,
+    INSTR_LABEL,
+    INSTR_GOTO,
+    INSTR_RET,
+    INSTR_READ,
+    INSTR_EXIT,
+    INSTR_MAX,
+} InstructionType;
+
+typedef struct {
+    InstructionType type;
+    size_t line;   // source line for messages
+    size_t jump;   // pre-resolved target, see script_link()
+    char *name;    // label name, INSTR_LABEL only
+    Token *tokens; // first token is the keyword or operation name
+    size_t count;
+    bool background; // line ends with '&'
+} Instruction;
+
+struct Script {
+    Instruction *code;
+    size_t length;
+    size_t capacity;
+    strmap *labels;              // label name -> body index + 1
+    arena *mem;                  // tokens, segments and strings
+    VariableManager *variables;  // manager the segment handles belong to
+};
+
+// Line tokenizer state. Buffers are reused for every line of a script.
 typedef struct {
-    const char *name;
-    size_t line;
-} label;
+    arena *mem;
+    char *text;
+    size_t text_len;
+    size_t text_cap;
+    Segment *segments;
+    size_t segment_len;
+    size_t segment_cap;
+    Token *tokens;
+    size_t token_len;
+    size_t token_cap;
+} Lexer;
 
-static label *labels;
-size_t label_max = 32;
-size_t label_cur = 0;
+static bool grow(void **data, size_t *cap, size_t need, size_t size) {
+    if (need <= *cap) {
+        return true;
+    }
+    size_t new_cap = *cap ? *cap * 2 : 32;
+    while (new_cap < need) {
+        new_cap *= 2;
+    }
+    void *tmp = realloc(*data, new_cap * size);
+    if (!tmp) {
+        print(_("Memory allocation failed\n"));
+        return false;
+    }
+    *data = tmp;
+    *cap = new_cap;
+    return true;
+}
 
-static size_t *while_stack = NULL;
-static size_t while_stack_max = 32;
-static size_t while_depth = 0;
+static Token *compile_tokens(arena *mem, const char *text, size_t *count);
 
-static size_t *ret_stack = NULL;
-static size_t ret_stack_max = 32;
-static size_t ret_depth = 0;
+static void lexer_putc(Lexer *lx, char c) {
+    if (grow((void **) &lx->text, &lx->text_cap, lx->text_len + 1, 1)) {
+        lx->text[lx->text_len++] = c;
+    }
+}
 
-static void labels_unref() {
-    if (!labels) {
+static void lexer_segment(Lexer *lx, SegmentType type, const char *text, size_t len) {
+    if (!grow((void **) &lx->segments, &lx->segment_cap, lx->segment_len + 1, sizeof(Segment))) {
         return;
     }
-    for (size_t i = 0; i < label_cur; i++) {
-        free((char *) labels[i].name);
+    Segment *seg = &lx->segments[lx->segment_len++];
+    seg->type = type;
+    seg->text = arena_strndup(lx->mem, text, len);
+    seg->handle = NULL;
+    seg->tokens = NULL;
+    seg->count = 0;
+    if (type == SEGMENT_COMMAND) {
+        seg->tokens = compile_tokens(lx->mem, seg->text, &seg->count);
     }
-    free(labels);
-    label_cur = 0;
 }
 
-static char *exec_capture(const char *cmd) {
-    char buf[4096];
-    FILE *fp = popen(cmd, "r");
-    if (!fp)
-        return strdup("");
-    size_t n = fread(buf, 1, sizeof(buf) - 1, fp);
-    pclose(fp);
-    buf[n] = '\0';
-    while (n > 0 && (buf[n - 1] == '\n' || buf[n - 1] == '\r'))
-        buf[--n] = '\0';
-    return strdup(buf);
+static void lexer_flush_text(Lexer *lx) {
+    if (lx->text_len > 0) {
+        lexer_segment(lx, SEGMENT_TEXT, lx->text, lx->text_len);
+        lx->text_len = 0;
+    }
+}
+
+static bool lexer_token_empty(Lexer *lx) {
+    return lx->text_len == 0 && lx->segment_len == 0;
+}
+
+static void lexer_end_token(Lexer *lx) {
+    lexer_flush_text(lx);
+    if (lx->segment_len == 0) {
+        return;
+    }
+    if (!grow((void **) &lx->tokens, &lx->token_cap, lx->token_len + 1, sizeof(Token))) {
+        return;
+    }
+    Token *tok = &lx->tokens[lx->token_len++];
+    tok->count = lx->segment_len;
+    tok->segments = arena_alloc(lx->mem, sizeof(Segment) * lx->segment_len);
+    memcpy(tok->segments, lx->segments, sizeof(Segment) * lx->segment_len);
+    lx->segment_len = 0;
+}
+
+static bool is_name_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
 }
 
-static char **tokenize_line(const char *line, bool *stop_expr) {
-    size_t cap = 32, cnt = 0;
-    char **args = calloc(cap, sizeof(char *));
-    char tok[4096];
-    size_t tpos = 0;
+// Split a line into tokens. Expansions are kept as segments for run time.
+static Token *tokenize_line(Lexer *lx, const char *line, size_t *count) {
     bool dq = false, sq = false, literal = false;
-    if (stop_expr)
-        *stop_expr = false;
+    lx->token_len = 0;
 
     while (*line) {
         char c = *line;
 
         if (!dq && !sq && (c == ' ' || c == '\t')) {
             line++;
-            if (tpos > 0) {
-                tok[tpos] = '\0';
-                args[cnt] = strdup(tok);
-                cnt++;
-                tpos = 0;
-                if (cnt >= cap - 1) {
-                    cap += 32;
-                    char **tmp = realloc(args, cap * sizeof(char *));
-                    if (tmp)
-                        args = tmp;
-                }
-            }
+            lexer_end_token(lx);
             continue;
         }
 
@@ -89,13 +191,8 @@ static char **tokenize_line(const char *line, bool *stop_expr) {
             continue;
         }
 
-        if (sq) {
-            tok[tpos++] = c;
-            line++;
-            continue;
-        }
-        if (literal) {
-            tok[tpos++] = c;
+        if (sq || literal) {
+            lexer_putc(lx, c);
             line++;
             continue;
         }
@@ -103,7 +200,7 @@ static char **tokenize_line(const char *line, bool *stop_expr) {
         if (c == '\\') {
             line++;
             if (*line) {
-                tok[tpos++] = *line;
+                lexer_putc(lx, *line);
                 line++;
             }
             continue;
@@ -123,69 +220,29 @@ static char **tokenize_line(const char *line, bool *stop_expr) {
                     if (depth > 0)
                         line++;
                 }
-                size_t clen = line - start;
-                char *cmd = calloc(1, clen + 1);
-                if (!cmd)
-                    continue;
-                memcpy(cmd, start, clen);
-                cmd[clen] = '\0';
+                lexer_flush_text(lx);
+                lexer_segment(lx, SEGMENT_COMMAND, start, line - start);
                 if (*line == ')')
                     line++;
-                char *out = exec_capture(cmd);
-                size_t olen = strlen(out);
-                if (tpos + olen < sizeof(tok) - 1) {
-                    memcpy(tok + tpos, out, olen);
-                    tpos += olen;
-                }
-                free(out);
-                free(cmd);
-                continue;
             } else if (*line == '{') {
                 line++;
                 const char *start = line;
                 while (*line && *line != '}')
                     line++;
-                size_t vlen = line - start;
-                char *vname = calloc(1, vlen + 1);
-                if (!vname)
-                    continue;
-                memcpy(vname, start, vlen);
-                vname[vlen] = '\0';
-                const char *val = get_value(vname);
-                if (val) {
-                    size_t vallen = strlen(val);
-                    if (tpos + vallen < sizeof(tok) - 1) {
-                        memcpy(tok + tpos, val, vallen);
-                        tpos += vallen;
-                    }
-                }
-                free(vname);
+                lexer_flush_text(lx);
+                lexer_segment(lx, SEGMENT_VARIABLE, start, line - start);
                 if (*line == '}')
                     line++;
-                continue;
             } else {
                 const char *start = line;
-                while (*line && ((*line >= 'a' && *line <= 'z') || (*line >= 'A' && *line <= 'Z') || (*line >= '0' && *line <= '9') || *line == '_'))
+                while (*line && is_name_char(*line))
                     line++;
                 if (line > start) {
-                    size_t vlen = line - start;
-                    char *vname = calloc(1, vlen + 1);
-                    if (!vname)
-                        continue;
-                    memcpy(vname, start, vlen);
-                    vname[vlen] = '\0';
-                    const char *val = get_value(vname);
-                    if (val) {
-                        size_t vallen = strlen(val);
-                        if (tpos + vallen < sizeof(tok) - 1) {
-                            memcpy(tok + tpos, val, vallen);
-                            tpos += vallen;
-                        }
-                    }
-                    free(vname);
+                    lexer_flush_text(lx);
+                    lexer_segment(lx, SEGMENT_VARIABLE, start, line - start);
                 }
-                continue;
             }
+            continue;
         }
 
         if (c == '`') {
@@ -193,50 +250,176 @@ static char **tokenize_line(const char *line, bool *stop_expr) {
             const char *start = line;
             while (*line && *line != '`')
                 line++;
-            size_t clen = line - start;
-            char *cmd = calloc(1, clen + 1);
-            if (!cmd)
-                continue;
-            memcpy(cmd, start, clen);
-            cmd[clen] = '\0';
+            lexer_flush_text(lx);
+            lexer_segment(lx, SEGMENT_COMMAND, start, line - start);
             if (*line == '`')
                 line++;
-            char *out = exec_capture(cmd);
-            size_t olen = strlen(out);
-            if (tpos + olen < sizeof(tok) - 1) {
-                memcpy(tok + tpos, out, olen);
-                tpos += olen;
-            }
-            free(out);
-            free(cmd);
             continue;
         }
 
-        if (c == '-' && tpos == 0 && line[1] == '-') {
+        if (c == '-' && lexer_token_empty(lx) && line[1] == '-') {
             line += 2;
             if (*line == ' ' || *line == '\t' || *line == '\0') {
-                if (stop_expr)
-                    *stop_expr = true;
                 literal = true;
                 continue;
             }
-            tok[tpos++] = '-';
-            tok[tpos++] = '-';
-            line++;
+            lexer_putc(lx, '-');
+            lexer_putc(lx, '-');
             continue;
         }
 
-        tok[tpos++] = c;
+        lexer_putc(lx, c);
         line++;
     }
+    lexer_end_token(lx);
+
+    *count = lx->token_len;
+    Token *tokens = arena_alloc(lx->mem, sizeof(Token) * lx->token_len);
+    memcpy(tokens, lx->tokens, sizeof(Token) * lx->token_len);
+    return tokens;
+}
+
+// Tokenize a command substitution with its own lexer buffers.
+static Token *compile_tokens(arena *mem, const char *text, size_t *count) {
+    Lexer lx = { 0 };
+    lx.mem = mem;
+    Token *tokens = tokenize_line(&lx, text, count);
+    free(lx.text);
+    free(lx.segments);
+    free(lx.tokens);
+    return tokens;
+}
 
-    if (tpos > 0) {
-        tok[tpos] = '\0';
-        args[cnt] = strdup(tok);
-        cnt++;
+static char *trim_newlines(char *buf, size_t len) {
+    buf[len] = '\0';
+    while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == '\r'))
+        buf[--len] = '\0';
+    return buf;
+}
+
+static char *exec_capture(const char *cmd) {
+    FILE *fp = popen(cmd, "r");
+    if (!fp)
+        return strdup("");
+    char *buf = NULL;
+    size_t len = 0, cap = 0;
+    while (grow((void **) &buf, &cap, len + 4096 + 1, 1)) {
+        size_t n = fread(buf + len, 1, 4096, fp);
+        if (n == 0)
+            break;
+        len += n;
     }
-    args[cnt] = NULL;
-    return args;
+    pclose(fp);
+    if (!buf)
+        return strdup("");
+    return trim_newlines(buf, len);
+}
+
+// Run an operation in-process and return what it printed. Only this thread
+// prints into the capture, branches running meanwhile keep their output.
+static char *operation_capture(char **args) {
+    int fd = memfd_create("ympsh-capture", MFD_CLOEXEC);
+    int wfd = fd < 0 ? -1 : fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    FILE *out = wfd < 0 ? NULL : fdopen(wfd, "w");
+    if (!out) {
+        if (wfd >= 0) {
+            close(wfd);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        warning(_("Failed to capture output of %s\n"), args[0]);
+        return strdup("");
+    }
+    FILE *prev = logger_set_output(out);
+    (void) operation_main(global->manager, args[0], args + 1);
+    (void) logger_set_output(prev);
+    fclose(out);
+
+    off_t size = lseek(fd, 0, SEEK_END);
+    char *buf = malloc(size > 0 ? size + 1 : 1);
+    size_t len = 0;
+    while (buf && (off_t) len < size) {
+        ssize_t n = pread(fd, buf + len, size - len, len);
+        if (n <= 0)
+            break;
+        len += n;
+    }
+    close(fd);
+    if (!buf)
+        return strdup("");
+    return trim_newlines(buf, len);
+}
+
+static size_t expand_tokens(const Token *tokens, size_t count, char **args, char **owned);
+
+// Substitutions naming a registered operation run in-process, anything else
+// goes through the shell.
+static char *command_capture(const Segment *seg) {
+    if (seg->count > 0 && seg->tokens[0].count == 1 && seg->tokens[0].segments[0].type == SEGMENT_TEXT &&
+        get_operation_by_name(global->manager, seg->tokens[0].segments[0].text).call) {
+        char *args[seg->count + 1];
+        char *owned[seg->count + 1];
+        size_t owned_len = expand_tokens(seg->tokens, seg->count, args, owned);
+        parse_args(args, false);
+        char *out = args[0] ? operation_capture(args) : strdup("");
+        for (size_t i = 0; i < owned_len; i++) {
+            free(owned[i]);
+        }
+        return out;
+    }
+    return exec_capture(seg->text);
+}
+
+// Expand a token. Plain text is borrowed from the script, anything else is
+// allocated and flagged as owned. Returns NULL if the token expands to nothing.
+static char *expand_token(const Token *tok, bool *owned) {
+    *owned = false;
+    if (tok->count == 1 && tok->segments[0].type == SEGMENT_TEXT) {
+        return tok->segments[0].text;
+    }
+    char *buf = NULL;
+    size_t len = 0, cap = 0;
+    for (size_t i = 0; i < tok->count; i++) {
+        const Segment *seg = &tok->segments[i];
+        char *out = NULL;
+        const char *val = seg->text;
+        if (seg->type == SEGMENT_VARIABLE) {
+            // Parallel branches may set the variable meanwhile
+            out = variable_handle_dup(seg->handle);
+            val = out;
+        } else if (seg->type == SEGMENT_COMMAND) {
+            out = command_capture(seg);
+            val = out;
+        }
+        size_t vlen = strlen(val);
+        if (vlen > 0 && grow((void **) &buf, &cap, len + vlen + 1, 1)) {
+            memcpy(buf + len, val, vlen);
+            len += vlen;
+            buf[len] = '\0';
+        }
+        free(out);
+    }
+    *owned = buf != NULL;
+    return buf;
+}
+
+// Expand tokens into a NULL terminated argument list. Allocated arguments
+// are stored in owned, the return value is their count.
+static size_t expand_tokens(const Token *tokens, size_t count, char **args, char **owned) {
+    size_t argc = 0, owned_len = 0;
+    for (size_t t = 0; t < count; t++) {
+        bool is_owned = false;
+        char *arg = expand_token(&tokens[t], &is_owned);
+        if (arg) {
+            args[argc++] = arg;
+        }
+        if (is_owned) {
+            owned[owned_len++] = arg;
+        }
+    }
+    args[argc] = NULL;
+    return owned_len;
 }
 
 visible char **parse_args(char **args, bool free_strings) {
@@ -247,6 +430,11 @@ visible char **parse_args(char **args, bool free_strings) {
     for (len = 0; args[len]; len++) {
     }
 
+    // Branches of ympsh keep their options to themselves
+    VariableManager *target = variable_get_options();
+    if (!target) {
+        target = global->variables;
+    }
     for (size_t i = 0; i < len; i++) {
         debug("parse: %s\n", args[i]);
         if (strlen(args[i]) > 2 && args[i][0] == '-' && args[i][1] == '-') {
@@ -257,12 +445,12 @@ visible char **parse_args(char **args, bool free_strings) {
             var[offset - 2] = '\0';
             debug("offset=%lld len=%lld\n", offset, strlen(args[i]));
             if (offset >= strlen(args[i])) {
-                set_bool(var, true);
+                variable_set_value(target, var, "true");
             } else {
                 char val[strlen(args[i]) - offset - 1];
                 strncpy(val, args[i] + offset + 1, strlen(args[i]) - offset - 1);
                 val[strlen(args[i]) - offset - 1] = '\0';
-                set_value(var, val);
+                variable_set_value(target, var, val);
             }
             if (free_strings) {
                 free(args[i]);
@@ -284,12 +472,6 @@ visible char **parse_args(char **args, bool free_strings) {
     return args;
 }
 
-static char **parse_line(const char *line) {
-    bool stop_expr = false;
-    char **ret = tokenize_line(line, &stop_expr);
-    return parse_args(ret, true);
-}
-
 static bool is_cond_op(const char *s) {
     return s && (iseq(s, "and") || iseq(s, "or") || iseq(s, "not"));
 }
@@ -349,200 +531,756 @@ static bool eval_conditions(char **args) {
     return result == 0;
 }
 
-visible int run_script(const char *script) {
-    char **lines = split(script, "\n");
-    int rc = 0;
-    int iflevel = 0;
-    if (!labels) {
-        labels = calloc(label_max, sizeof(label));
-    }
-    if (!while_stack) {
-        while_stack = calloc(while_stack_max, sizeof(size_t));
-    }
-    if (!ret_stack) {
-        ret_stack = calloc(ret_stack_max, sizeof(size_t));
-    }
-    for (size_t i = 0; lines[i]; i++) {
-        char *ltmp = strip(lines[i]);
-        free(lines[i]);
-        lines[i] = ltmp;
-        if (startswith(lines[i], "label ")) {
-            if (label_cur >= label_max) {
-                label_max += 32;
-                label *tmp = realloc(labels, sizeof(label) * label_max);
-                if (tmp)
-                    labels = tmp;
+static const char *keywords[INSTR_MAX] = {
+    [INSTR_IF] = "if",
+    [INSTR_ENDIF] = "endif",
+    [INSTR_WHILE] = "while",
+    [INSTR_ENDWHILE] = "endwhile",
+    [INSTR_PARALLEL] = "parallel",
+    [INSTR_ENDPARALLEL] = "endparallel",
+    [INSTR_WAIT] = "wait",
+    [INSTR_LABEL] = "label",
+    [INSTR_GOTO] = "goto",
+    [INSTR_RET] = "ret",
+    [INSTR_READ] = "read",
+    [INSTR_EXIT] = "exit",
+};
+
+static InstructionType instruction_type(const Token *tok) {
+    if (tok->count != 1 || tok->segments[0].type != SEGMENT_TEXT) {
+        return INSTR_CALL;
+    }
+    for (size_t i = INSTR_CALL + 1; i < INSTR_MAX; i++) {
+        if (iseq(tok->segments[0].text, keywords[i])) {
+            return (InstructionType) i;
+        }
+    }
+    return INSTR_CALL;
+}
+
+static Script *script_new() {
+    Script *script = calloc(1, sizeof(Script));
+    if (!script) {
+        print(_("Memory allocation failed\n"));
+        return NULL;
+    }
+    script->mem = arena_new(0);
+    script->labels = strmap_new(0);
+    return script;
+}
+
+visible void script_unref(Script *script) {
+    if (!script) {
+        return;
+    }
+    free(script->code);
+    strmap_unref(script->labels);
+    arena_unref(script->mem);
+    free(script);
+}
+
+static void script_add(Script *script, const Instruction *ins) {
+    if (grow((void **) &script->code, &script->capacity, script->length + 1, sizeof(Instruction))) {
+        script->code[script->length++] = *ins;
+    }
+}
+
+// Register the label at pc. The first label with a name wins.
+static void script_add_label(Script *script, size_t pc) {
+    const char *name = script->code[pc].name;
+    if (!strmap_has(script->labels, name)) {
+        strmap_set(script->labels, name, (void *) (pc + 2));
+    }
+}
+
+static size_t script_find_label(Script *script, const char *name) {
+    size_t body = (size_t) strmap_get(script->labels, name);
+    return body ? body - 1 : NO_JUMP;
+}
+
+// Report a block without terminator. Terminators follow their block in InstructionType.
+static bool script_syntax_error(const Instruction *ins) {
+    char *syntax_err = build_string("syntax error at line %zu : %s missing", ins->line, keywords[ins->type + 1]);
+    error_add(syntax_err);
+    free(syntax_err);
+    return false;
+}
+
+// Parallel blocks run each line as a branch, so they can only hold operations.
+static bool script_check_parallel(Script *script, size_t start, size_t end) {
+    for (size_t pc = start + 1; pc < end; pc++) {
+        if (script->code[pc].type != INSTR_CALL) {
+            char *syntax_err = build_string("syntax error at line %zu : only operations are allowed in parallel block",
+                                            script->code[pc].line);
+            error_add(syntax_err);
+            free(syntax_err);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Resolve jump targets:
+//  if, while, parallel: instruction after the matching terminator
+//  endwhile:  the matching while
+//  label:     instruction after the next ret, the body is skipped
+//  goto:      first body instruction of a literal label
+static bool script_link(Script *script) {
+    size_t *blocks = NULL, *pending = NULL;
+    size_t depth = 0, block_cap = 0, waiting = 0, pending_cap = 0;
+    bool ok = true;
+    for (size_t pc = 0; ok && pc < script->length; pc++) {
+        Instruction *ins = &script->code[pc];
+        ins->jump = NO_JUMP;
+        switch (ins->type) {
+        case INSTR_IF:
+        case INSTR_WHILE:
+        case INSTR_PARALLEL:
+            if (grow((void **) &blocks, &block_cap, depth + 1, sizeof(size_t))) {
+                blocks[depth++] = pc;
+            }
+            break;
+        case INSTR_ENDIF:
+        case INSTR_ENDWHILE:
+        case INSTR_ENDPARALLEL:
+            // A terminator without an open block is ignored
+            if (depth == 0) {
+                break;
+            }
+            Instruction *start = &script->code[blocks[depth - 1]];
+            if (start->type + 1 != ins->type) {
+                ok = script_syntax_error(start);
+                break;
+            }
+            depth--;
+            start->jump = pc + 1;
+            if (ins->type == INSTR_ENDWHILE) {
+                ins->jump = blocks[depth];
+            } else if (ins->type == INSTR_ENDPARALLEL) {
+                ok = script_check_parallel(script, blocks[depth], pc);
+            }
+            break;
+        case INSTR_LABEL:
+            script_add_label(script, pc);
+            if (grow((void **) &pending, &pending_cap, waiting + 1, sizeof(size_t))) {
+                pending[waiting++] = pc;
+            }
+            break;
+        case INSTR_RET:
+            while (waiting > 0) {
+                script->code[pending[--waiting]].jump = pc + 1;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    if (ok && depth > 0) {
+        ok = script_syntax_error(&script->code[blocks[depth - 1]]);
+    }
+    while (waiting > 0) {
+        script->code[pending[--waiting]].jump = script->length;
+    }
+    for (size_t pc = 0; pc < script->length; pc++) {
+        Instruction *ins = &script->code[pc];
+        if (ins->type == INSTR_GOTO && ins->count > 1 && ins->tokens[1].count == 1 &&
+            ins->tokens[1].segments[0].type == SEGMENT_TEXT) {
+            ins->jump = script_find_label(script, ins->tokens[1].segments[0].text);
+        }
+    }
+    free(blocks);
+    free(pending);
+    return ok;
+}
+
+visible Script *script_compile(const char *source) {
+    Script *script = script_new();
+    if (!script) {
+        return NULL;
+    }
+    Lexer lx = { 0 };
+    lx.mem = script->mem;
+    size_t line_no = 0;
+    const char *cur = source;
+    while (cur && *cur) {
+        const char *end = strchr(cur, '\n');
+        const char *next = end ? end + 1 : cur + strlen(cur);
+        if (!end) {
+            end = next;
+        }
+        line_no++;
+        while (cur < end && isspace((unsigned char) *cur)) {
+            cur++;
+        }
+        while (end > cur && isspace((unsigned char) end[-1])) {
+            end--;
+        }
+        if (cur == end || *cur == '#') {
+            cur = next;
+            continue;
+        }
+        char *line = strndup(cur, end - cur);
+        cur = next;
+        Instruction ins = { 0 };
+        ins.line = line_no;
+        ins.tokens = tokenize_line(&lx, line, &ins.count);
+        if (ins.count > 0) {
+            ins.type = instruction_type(&ins.tokens[0]);
+            const Token *last = &ins.tokens[ins.count - 1];
+            if (ins.type == INSTR_CALL && ins.count > 1 && last->count == 1 &&
+                last->segments[0].type == SEGMENT_TEXT && iseq(last->segments[0].text, "&")) {
+                ins.background = true;
+                ins.count--;
+            }
+            if (ins.type == INSTR_LABEL) {
+                // Label names are taken verbatim from the rest of the line
+                char *name = line + 5;
+                while (*name == ' ' || *name == '\t') {
+                    name++;
+                }
+                ins.name = arena_strdup(script->mem, name);
+            }
+            script_add(script, &ins);
+        }
+        free(line);
+    }
+    free(lx.text);
+    free(lx.segments);
+    free(lx.tokens);
+    if (!script_link(script)) {
+        script_unref(script);
+        return NULL;
+    }
+    return script;
+}
+
+static void bind_tokens(Token *tokens, size_t count) {
+    for (size_t t = 0; t < count; t++) {
+        for (size_t s = 0; s < tokens[t].count; s++) {
+            Segment *seg = &tokens[t].segments[s];
+            if (seg->type == SEGMENT_VARIABLE) {
+                seg->handle = variable_lookup(global->variables, seg->text);
+            } else if (seg->type == SEGMENT_COMMAND) {
+                bind_tokens(seg->tokens, seg->count);
             }
-            labels[label_cur].name = strdup(lines[i] + 6);
-            labels[label_cur].line = i;
-            label_cur++;
         }
     }
-    for (size_t i = 0; lines[i]; i++) {
-        if (strlen(lines[i]) == 0)
+}
+
+// Resolve variable segments to handles of the current variable manager.
+static void script_bind(Script *script) {
+    script->variables = global->variables;
+    for (size_t pc = 0; pc < script->length; pc++) {
+        bind_tokens(script->code[pc].tokens, script->code[pc].count);
+    }
+}
+
+// A line running on the jobs pool. Arguments are expanded by the script thread.
+typedef struct {
+    char **args;
+    char **owned;
+    size_t owned_len;
+    VariableManager *options; // --flags of the line, not seen by other branches
+    int status;
+} Branch;
+
+// Branches started together.
+typedef struct {
+    jobs *pool;
+    Branch *branches;
+    size_t count;
+    size_t capacity;
+    pthread_t thread;
+    bool started;
+    FILE *output; // output of the script thread, branches of a capture print into it
+    bool pinned;  // holds a pin of the global variables until it is finished
+} Batch;
+
+// Background batches of one script run.
+typedef struct {
+    Batch **batches;
+    size_t count;
+    size_t capacity;
+    Batch *pending; // consecutive '&' lines, started when the run of them ends
+} Background;
+
+static int branch_run(Branch *branch, Batch *batch) {
+    FILE *prev = logger_set_output(batch->output);
+    VariableManager *options = variable_set_options(branch->options);
+    if (branch->args[0]) {
+        branch->status = operation_main(global->manager, branch->args[0], branch->args + 1);
+    }
+    (void) variable_set_options(options);
+    (void) logger_set_output(prev);
+    // Keep the other branches running
+    return 0;
+}
+
+static void batch_add(Batch *batch, const Instruction *ins) {
+    if (!grow((void **) &batch->branches, &batch->capacity, batch->count + 1, sizeof(Branch))) {
+        return;
+    }
+    Branch *branch = &batch->branches[batch->count++];
+    branch->args = calloc(ins->count + 1, sizeof(char *));
+    branch->owned = calloc(ins->count + 1, sizeof(char *));
+    branch->owned_len = expand_tokens(ins->tokens, ins->count, branch->args, branch->owned);
+    branch->status = 0;
+    // Start from the options of the script thread, a script may run inside
+    // a branch itself
+    branch->options = variable_manager_new();
+    VariableManager *parent = variable_set_options(branch->options);
+    if (parent) {
+        char **names = variable_get_names(parent);
+        for (size_t i = 0; names && names[i]; i++) {
+            variable_set_value(branch->options, names[i], variable_get_value(parent, names[i]));
+            free(names[i]);
+        }
+        free(names);
+    }
+    parse_args(branch->args, false);
+    (void) variable_set_options(parent);
+}
+
+static void batch_prepare(Batch *batch) {
+    batch->pool = jobs_new();
+    batch->pool->parallel = batch->count;
+    // A thread inside a job must not pick up a branch, operations are not
+    // reentrant
+    batch->pool->isolated = true;
+    batch->output = logger_get_output();
+    // Branches read values the script thread may replace meanwhile
+    variable_pin(global->variables);
+    batch->pinned = true;
+    for (size_t i = 0; i < batch->count; i++) {
+        jobs_add(batch->pool, (callback) branch_run, &batch->branches[i], batch);
+    }
+}
+
+static void *batch_thread(void *arg) {
+    jobs_run(((Batch *) arg)->pool);
+    return NULL;
+}
+
+// Wait for a batch and store branch statuses as STATUS_<n>, counting from
+// *index. Returns the first failed status, or 0.
+static int batch_finish(Batch *batch, size_t *index) {
+    if (batch->started) {
+        pthread_join(batch->thread, NULL);
+    }
+    int combined = 0;
+    char name[32], value[16];
+    for (size_t i = 0; i < batch->count; i++) {
+        Branch *branch = &batch->branches[i];
+        snprintf(name, sizeof(name), "STATUS_%zu", ++(*index));
+        snprintf(value, sizeof(value), "%d", branch->status);
+        set_value(name, value);
+        if (combined == 0) {
+            combined = branch->status;
+        }
+        for (size_t j = 0; j < branch->owned_len; j++) {
+            free(branch->owned[j]);
+        }
+        free(branch->owned);
+        free(branch->args);
+        if (branch->options) {
+            variable_manager_unref(branch->options);
+        }
+    }
+    if (batch->pool) {
+        jobs_unref(batch->pool);
+    }
+    if (batch->pinned) {
+        variable_unpin(global->variables);
+    }
+    free(batch->branches);
+    free(batch);
+    return combined;
+}
+
+static void publish_status(int status) {
+    char value[16];
+    snprintf(value, sizeof(value), "%d", status);
+    set_value("STATUS", value);
+}
+
+static void background_start(Background *bg) {
+    Batch *batch = bg->pending;
+    if (!batch) {
+        return;
+    }
+    bg->pending = NULL;
+    batch_prepare(batch);
+    if (!grow((void **) &bg->batches, &bg->capacity, bg->count + 1, sizeof(Batch *))) {
+        // Nowhere to keep it for the wait, run it in the foreground
+        jobs_run(batch->pool);
+        size_t index = 0;
+        (void) batch_finish(batch, &index);
+        return;
+    }
+    batch->started = pthread_create(&batch->thread, NULL, batch_thread, batch) == 0;
+    if (!batch->started) {
+        jobs_run(batch->pool);
+    }
+    bg->batches[bg->count++] = batch;
+}
+
+// Wait for every background line started since the last wait.
+static int background_wait(Background *bg) {
+    background_start(bg);
+    int combined = 0;
+    size_t index = 0;
+    for (size_t i = 0; i < bg->count; i++) {
+        int status = batch_finish(bg->batches[i], &index);
+        if (combined == 0) {
+            combined = status;
+        }
+    }
+    bg->count = 0;
+    publish_status(combined);
+    return combined;
+}
+
+visible int script_run(Script *script) {
+    if (!script) {
+        return 1;
+    }
+    if (script->variables != global->variables) {
+        script_bind(script);
+    }
+    size_t *ret_stack = NULL;
+    size_t ret_depth = 0, ret_cap = 0;
+    Background bg = { 0 };
+    int rc = 0;
+    size_t pc = 0;
+    while (pc < script->length) {
+        Instruction *ins = &script->code[pc];
+        if (ins->background) {
+            if (!bg.pending) {
+                bg.pending = calloc(1, sizeof(Batch));
+            }
+            if (bg.pending) {
+                batch_add(bg.pending, ins);
+            }
+            pc++;
+            continue;
+        }
+        background_start(&bg);
+        // Block markers do not expand their arguments
+        if (ins->type == INSTR_PARALLEL) {
+            Batch *batch = calloc(1, sizeof(Batch));
+            if (batch) {
+                for (size_t i = pc + 1; i + 1 < ins->jump; i++) {
+                    batch_add(batch, &script->code[i]);
+                }
+                batch_prepare(batch);
+                jobs_run(batch->pool);
+                size_t index = 0;
+                rc = batch_finish(batch, &index);
+                publish_status(rc);
+            }
+            pc = ins->jump;
+            continue;
+        } else if (ins->type == INSTR_WAIT) {
+            rc = background_wait(&bg);
+            pc++;
+            continue;
+        } else if (ins->type == INSTR_LABEL) {
+            pc = ins->jump;
+            continue;
+        } else if (ins->type == INSTR_ENDIF) {
+            pc++;
             continue;
-        if (lines[i][0] == '#')
+        } else if (ins->type == INSTR_ENDWHILE) {
+            pc = ins->jump == NO_JUMP ? pc + 1 : ins->jump;
             continue;
-        debug("script:%s\n", lines[i]);
-        char **args = parse_line(lines[i]);
-        if (!args[0]) {
-            free(args);
+        } else if (ins->type == INSTR_RET) {
+            pc = ret_depth > 0 ? ret_stack[--ret_depth] : pc + 1;
             continue;
         }
 
-        if (iseq(args[0], "label")) {
-            for (i++; lines[i]; i++) {
-                char *t = strip(lines[i]);
-                if (strlen(t) == 0 || t[0] == '#') {
-                    free(t);
-                    continue;
+        char *args[ins->count + 1];
+        char *owned[ins->count + 1];
+        size_t owned_len = expand_tokens(ins->tokens, ins->count, args, owned);
+        parse_args(args, false);
+
+        size_t next = pc + 1;
+        if (args[0]) {
+            debug("script:%zu %s\n", ins->line, args[0]);
+            switch (ins->type) {
+            case INSTR_IF:
+            case INSTR_WHILE:
+                if (!eval_conditions(args + 1)) {
+                    next = ins->jump;
                 }
-                free(t);
-                char **la = parse_line(lines[i]);
-                if (la && iseq(la[0], "ret")) {
-                    for (size_t j = 0; la[j]; j++)
-                        free(la[j]);
-                    free(la);
+                break;
+            case INSTR_GOTO:
+                if (!args[1]) {
                     break;
                 }
-                for (size_t j = 0; la[j]; j++)
-                    free(la[j]);
-                free(la);
-            }
-            if (lines[i] == NULL) {
-                i--;  // keep the outer loop's i++ on the NULL terminator
-            }
-            goto args_cleanup;
-        }
-        if (iseq(args[0], "if")) {
-            if (!eval_conditions(args + 1)) {
-                iflevel++;
-                int cur = i;
-                for (i = i + 1; lines[i]; i++) {
-                    if (strlen(lines[i]) == 0)
-                        continue;
-                    if (startswith(lines[i], "endif"))
-                        iflevel--;
-                    if (startswith(lines[i], "if "))
-                        iflevel++;
-                    if (iflevel == 0)
-                        goto found_endif;
+                size_t target = ins->jump;
+                if (target == NO_JUMP) {
+                    target = script_find_label(script, args[1]);
                 }
-                char *syntax_err = build_string("syntax error at line %d : endif missing", cur);
-                error_add(syntax_err);
-                free(syntax_err);
-                error(1);
-                goto args_cleanup_err;
-            found_endif:;
-            }
-            goto args_cleanup;
-        }
-        if (iseq(args[0], "while")) {
-            if (while_depth >= while_stack_max) {
-                while_stack_max += 32;
-                size_t *tmp = realloc(while_stack, while_stack_max * sizeof(size_t));
-                if (tmp)
-                    while_stack = tmp;
-            }
-            while_stack[while_depth++] = i;
-            if (!eval_conditions(args + 1)) {
-                int wl = 1;
-                for (i++; lines[i]; i++) {
-                    if (strlen(lines[i]) == 0)
-                        continue;
-                    if (startswith(lines[i], "while "))
-                        wl++;
-                    if (startswith(lines[i], "endwhile")) {
-                        wl--;
-                        if (wl == 0)
-                            break;
-                    }
+                if (target == NO_JUMP) {
+                    warning(_("Label not found: %s\n"), args[1]);
+                    break;
+                }
+                // ret continues after the goto
+                if (grow((void **) &ret_stack, &ret_cap, ret_depth + 1, sizeof(size_t))) {
+                    ret_stack[ret_depth++] = pc + 1;
                 }
-                while_depth--;
-                if (lines[i] == NULL) {
-                    i--;  // keep the outer loop's i++ on the NULL terminator
+                next = target;
+                break;
+            case INSTR_READ: {
+                char buf[1024];
+                if (fgets(buf, sizeof(buf), stdin)) {
+                    size_t blen = strlen(buf);
+                    while (blen > 0 && (buf[blen - 1] == '\n' || buf[blen - 1] == '\r'))
+                        buf[--blen] = '\0';
+                    if (args[1])
+                        set_value(args[1], buf);
                 }
+                break;
             }
-            goto args_cleanup;
-        }
-        if (iseq(args[0], "endwhile")) {
-            if (while_depth > 0) {
-                i = while_stack[--while_depth] - 1;
+            case INSTR_EXIT:
+                rc = args[1] ? atoi(args[1]) : 0;
+                next = script->length;
+                break;
+            default:
+                rc = operation_main(global->manager, args[0], args + 1);
+                break;
             }
-            goto args_cleanup;
-        }
-        if (iseq(args[0], "goto")) {
-            if (args[1]) {
-                if (ret_depth >= ret_stack_max) {
-                    ret_stack_max += 32;
-                    size_t *tmp = realloc(ret_stack, ret_stack_max * sizeof(size_t));
-                    if (tmp)
-                        ret_stack = tmp;
-                }
-                ret_stack[ret_depth++] = i;
-                for (size_t li = 0; li < label_cur; li++) {
-                    if (iseq(labels[li].name, args[1])) {
-                        i = labels[li].line - 1;
-                        break;
-                    }
-                }
+        }
+        for (size_t i = 0; i < owned_len; i++) {
+            free(owned[i]);
+        }
+        pc = next;
+    }
+    if (bg.count > 0 || bg.pending) {
+        (void) background_wait(&bg);
+    }
+    free(bg.batches);
+    free(ret_stack);
+    return rc;
+}
+
+static void cache_put(FILE *fp, uint64_t value) {
+    fwrite(&value, sizeof(value), 1, fp);
+}
+
+static void cache_put_string(FILE *fp, const char *str) {
+    if (!str) {
+        cache_put(fp, UINT64_MAX);
+        return;
+    }
+    size_t len = strlen(str);
+    cache_put(fp, len);
+    fwrite(str, 1, len, fp);
+}
+
+static void script_cache_write(Script *script, const char *path, const struct stat *st) {
+    char *tmp = build_string("%s.%d", path, getpid());
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp) {
+        debug("script cache not writable: %s\n", path);
+        free(tmp);
+        return;
+    }
+    cache_put(fp, SCRIPT_CACHE_MAGIC);
+    cache_put(fp, st->st_size);
+    cache_put(fp, st->st_mtim.tv_sec);
+    cache_put(fp, st->st_mtim.tv_nsec);
+    cache_put(fp, script->length);
+    for (size_t pc = 0; pc < script->length; pc++) {
+        Instruction *ins = &script->code[pc];
+        cache_put(fp, ins->type);
+        cache_put(fp, ins->line);
+        cache_put(fp, ins->jump);
+        cache_put_string(fp, ins->name);
+        cache_put(fp, ins->count);
+        cache_put(fp, ins->background);
+        for (size_t t = 0; t < ins->count; t++) {
+            cache_put(fp, ins->tokens[t].count);
+            for (size_t s = 0; s < ins->tokens[t].count; s++) {
+                cache_put(fp, ins->tokens[t].segments[s].type);
+                cache_put_string(fp, ins->tokens[t].segments[s].text);
             }
-            goto args_cleanup;
         }
-        if (iseq(args[0], "ret")) {
-            if (ret_depth > 0) {
-                i = ret_stack[--ret_depth] - 1;
+    }
+    bool ok = !ferror(fp);
+    ok = fclose(fp) == 0 && ok;
+    if (!ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+    }
+    free(tmp);
+}
+
+typedef struct {
+    const char *data;
+    size_t len;
+    size_t pos;
+    bool ok;
+} CacheReader;
+
+static uint64_t cache_get(CacheReader *r) {
+    uint64_t value = 0;
+    if (r->len - r->pos < sizeof(value)) {
+        r->ok = false;
+        return 0;
+    }
+    memcpy(&value, r->data + r->pos, sizeof(value));
+    r->pos += sizeof(value);
+    return value;
+}
+
+// Read an element count, at least one and bounded by the remaining data.
+static size_t cache_get_count(CacheReader *r) {
+    uint64_t count = cache_get(r);
+    if (count == 0 || count > (r->len - r->pos) / sizeof(uint64_t)) {
+        r->ok = false;
+        return 0;
+    }
+    return count;
+}
+
+static char *cache_get_string(CacheReader *r, arena *mem) {
+    uint64_t len = cache_get(r);
+    if (!r->ok || len == UINT64_MAX) {
+        return NULL;
+    }
+    if (len > r->len - r->pos) {
+        r->ok = false;
+        return NULL;
+    }
+    char *str = arena_strndup(mem, r->data + r->pos, len);
+    r->pos += len;
+    return str;
+}
+
+static Script *script_cache_read(const char *path, const struct stat *st) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return NULL;
+    }
+    char *data = NULL;
+    long len = -1;
+    if (fseek(fp, 0, SEEK_END) == 0 && (len = ftell(fp)) > 0 && fseek(fp, 0, SEEK_SET) == 0) {
+        data = malloc(len);
+        if (data && fread(data, 1, len, fp) != (size_t) len) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(fp);
+    if (!data) {
+        return NULL;
+    }
+    CacheReader r = { data, len, 0, true };
+    if (cache_get(&r) != SCRIPT_CACHE_MAGIC || cache_get(&r) != (uint64_t) st->st_size ||
+        cache_get(&r) != (uint64_t) st->st_mtim.tv_sec || cache_get(&r) != (uint64_t) st->st_mtim.tv_nsec) {
+        free(data);
+        return NULL;
+    }
+    Script *script = script_new();
+    if (!script) {
+        free(data);
+        return NULL;
+    }
+    uint64_t length = cache_get(&r);
+    for (uint64_t pc = 0; r.ok && pc < length; pc++) {
+        Instruction ins = { 0 };
+        ins.type = cache_get(&r);
+        ins.line = cache_get(&r);
+        ins.jump = cache_get(&r);
+        ins.name = cache_get_string(&r, script->mem);
+        ins.count = cache_get_count(&r);
+        ins.background = cache_get(&r) != 0;
+        if (ins.type >= INSTR_MAX || (ins.jump != NO_JUMP && ins.jump > length) ||
+            (ins.type == INSTR_LABEL && !ins.name)) {
+            r.ok = false;
+        }
+        if (r.ok) {
+            ins.tokens = arena_calloc(script->mem, ins.count, sizeof(Token));
+        }
+        for (size_t t = 0; r.ok && t < ins.count; t++) {
+            Token *tok = &ins.tokens[t];
+            tok->count = cache_get_count(&r);
+            if (r.ok) {
+                tok->segments = arena_calloc(script->mem, tok->count, sizeof(Segment));
             }
-            goto args_cleanup;
-        }
-        if (iseq(args[0], "read")) {
-            char buf[1024];
-            if (fgets(buf, sizeof(buf), stdin)) {
-                size_t blen = strlen(buf);
-                while (blen > 0 && (buf[blen - 1] == '\n' || buf[blen - 1] == '\r'))
-                    buf[--blen] = '\0';
-                if (args[1])
-                    set_value(args[1], buf);
+            for (size_t s = 0; r.ok && s < tok->count; s++) {
+                tok->segments[s].type = cache_get(&r);
+                tok->segments[s].text = cache_get_string(&r, script->mem);
+                if (tok->segments[s].type > SEGMENT_COMMAND || !tok->segments[s].text) {
+                    r.ok = false;
+                } else if (tok->segments[s].type == SEGMENT_COMMAND) {
+                    tok->segments[s].tokens = compile_tokens(script->mem, tok->segments[s].text,
+                                                             &tok->segments[s].count);
+                }
             }
-            goto args_cleanup;
-        }
-        if (iseq(args[0], "exit")) {
-            if (args[1])
-                rc = atoi(args[1]);
-            else
-                rc = 0;
-            for (size_t j = 0; args[j]; j++)
-                free(args[j]);
-            free(args);
-            break;
         }
-        rc = operation_main(global->manager, args[0], args + 1);
-    args_cleanup:
-        for (size_t j = 0; args[j]; j++)
-            free(args[j]);
-        free(args);
-        continue;
-    args_cleanup_err:
-        for (size_t j = 0; args[j]; j++)
-            free(args[j]);
-        free(args);
+        if (r.ok) {
+            script_add(script, &ins);
+        }
+    }
+    for (size_t pc = 0; r.ok && pc < script->length; pc++) {
+        if (script->code[pc].type == INSTR_LABEL) {
+            script_add_label(script, pc);
+        }
+    }
+    free(data);
+    if (!r.ok || script->length != length) {
+        debug("script cache invalid: %s\n", path);
+        script_unref(script);
+        return NULL;
+    }
+    return script;
+}
+
+visible Script *script_load(const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        char *msg = build_string("script not found: %s", path);
+        error_add(msg);
+        free(msg);
+        return NULL;
+    }
+    bool use_cache = get_bool("ympsh-cache");
+    char *cache = build_string("%sc", path);
+    Script *script = NULL;
+    if (use_cache) {
+        script = script_cache_read(cache, &st);
+    }
+    if (!script) {
+        char *data = readfile(path);
+        script = script_compile(data);
+        free(data);
+        if (script && use_cache) {
+            script_cache_write(script, cache, &st);
+        }
+    }
+    free(cache);
+    return script;
+}
+
+visible int run_script(const char *script) {
+    Script *compiled = script_compile(script);
+    if (!compiled) {
+        error(1);
+        return 1;
+    }
+    int rc = script_run(compiled);
+    script_unref(compiled);
+    return rc;
+}
+
+visible int run_script_file(const char *path) {
+    Script *script = script_load(path);
+    if (!script) {
+        error(1);
         return 1;
     }
-    labels_unref();
-    if (while_stack) {
-        free(while_stack);
-        while_stack = NULL;
-        while_stack_max = 32;
-        while_depth = 0;
-    }
-    if (ret_stack) {
-        free(ret_stack);
-        ret_stack = NULL;
-        ret_stack_max = 32;
-        ret_depth = 0;
-    }
-    for (size_t i = 0; lines[i]; i++)
-        free(lines[i]);
-    free(lines);
+    int rc = script_run(script);
+    script_unref(script);
     return rc;
 }
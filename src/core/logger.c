@@ -28,6 +28,19 @@ visible void logger_set_status(int type, bool status) {
 
 static size_t cur_time = 0;
 
+// Output of PRINT messages, per thread so captures do not mix
+static __thread FILE *output = NULL;
+
+visible FILE *logger_set_output(FILE *stream) {
+    FILE *prev = output;
+    output = stream;
+    return prev;
+}
+
+visible FILE *logger_get_output() {
+    return output;
+}
+
 visible int print_fn(const char *caller, const char *filename, int line, int type, const char *format, ...) {
     (void) caller;
     if (print_functions[type] == NULL) {
@@ -50,7 +63,12 @@ visible int print_fn(const char *caller, const char *filename, int line, int typ
         color_print(BOLD, COLOR_RED, "%s: ", "ERROR");
     }
 
-    int status = print_functions[type](format, args);
+    int status;
+    if (type == PRINT && output) {
+        status = vfprintf(output, format, args);
+    } else {
+        status = print_functions[type](format, args);
+    }
 
     va_end(args);
     return status;
@@ -1,3 +1,4 @@
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -5,15 +6,59 @@
 
 #include <core/logger.h>
 #include <core/operations.h>
+#include <core/trace.h>
 #include <core/variable.h>
 #include <core/ymp.h>
 #include <sys/stat.h>
-#include <utils/string.h>
+#include <utils/strset.h>
 
 typedef struct {
-    bool running;
+    int running;  // operations in progress, they may run on several threads
+    mode_t umask;  // umask before the first running operation
+    pthread_mutex_t lock;  // guards running, umask and OPERATION
+    pthread_mutex_t serial;  // held by operations that are not thread safe, recursive
+    bool *thread_safe;  // by index in operations, set by operation_set_thread_safe()
+    strmap *dispatch;  // name and aliases -> index + 1 in operations
 } OperationManagerPriv;
 
+// Operations in progress on this thread
+static __thread int depth = 0;
+
+// umask and OPERATION are process wide. The first operation sets the umask
+// and the last one restores it. OPERATION follows the operations of a single
+// thread, it is left alone while operations of other threads are running.
+static bool operation_enter(OperationManagerPriv *priv, const char *name, char **previous) {
+    // Values read by the operation stay valid while other threads set them
+    variable_pin(global->variables);
+    pthread_mutex_lock(&priv->lock);
+    if (priv->running == 0) {
+        priv->umask = umask(0022);
+    }
+    bool owner = name && priv->running == depth;
+    priv->running++;
+    if (owner) {
+        *previous = strdup(get_value("OPERATION"));
+        set_value("OPERATION", name);
+    }
+    pthread_mutex_unlock(&priv->lock);
+    depth++;
+    return owner;
+}
+
+static void operation_leave(OperationManagerPriv *priv, bool owner, char *previous) {
+    depth--;
+    pthread_mutex_lock(&priv->lock);
+    if (owner) {
+        set_value("OPERATION", previous ? previous : "");
+        free(previous);
+    }
+    if (--priv->running == 0) {
+        (void) umask(priv->umask);
+    }
+    pthread_mutex_unlock(&priv->lock);
+    variable_unpin(global->variables);
+}
+
 visible OperationManager *operation_manager_new() {
     // Allocate memory for the OperationManager instance
     OperationManager *manager = (OperationManager *) calloc(1, sizeof(OperationManager));
@@ -34,13 +79,31 @@ visible OperationManager *operation_manager_new() {
 
     // Private area
     OperationManagerPriv *priv = (OperationManagerPriv *) manager->priv_data;
-    priv->running = false;
+    priv->running = 0;
+    pthread_mutex_init(&priv->lock, NULL);
+    // Operations may run other operations from inside
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&priv->serial, &attr);
+    pthread_mutexattr_destroy(&attr);
+    priv->dispatch = strmap_new(0);
+    if (priv->dispatch == NULL) {
+        free(priv);
+        free(manager);
+        return NULL;  // Memory allocation failed
+    }
 
     return manager;  // Return the pointer to the newly created instance
 }
 
 visible void operation_manager_unref(OperationManager *manager) {
-    free(manager->priv_data);
+    OperationManagerPriv *priv = (OperationManagerPriv *) manager->priv_data;
+    strmap_unref(priv->dispatch);
+    pthread_mutex_destroy(&priv->lock);
+    pthread_mutex_destroy(&priv->serial);
+    free(priv->thread_safe);
+    free(priv);
     for (size_t i = 0; i < manager->length; i++) {
         if (manager->operations[i].help) {
             help_unref(manager->operations[i].help);
@@ -51,26 +114,23 @@ visible void operation_manager_unref(OperationManager *manager) {
 }
 
 Operation visible get_operation_by_name(OperationManager *manager, const char *name) {
-    for (size_t i = 0; i < manager->length; i++) {
-        if (strcmp(manager->operations[i].name, name) == 0) {
-            return manager->operations[i];
-        }
-        if (manager->operations[i].alias) {
-            char **alias = split(manager->operations[i].alias, ":");
-            for (size_t a = 0; alias[a]; a++) {
-                if (strcmp(alias[a], name) == 0) {
-                    for (size_t b = 0; alias[b]; b++)
-                        free(alias[b]);
-                    free(alias);
-                    return manager->operations[i];
-                }
-            }
-            for (size_t b = 0; alias[b]; b++)
-                free(alias[b]);
-            free(alias);
-        }
+    OperationManagerPriv *priv = (OperationManagerPriv *) manager->priv_data;
+    size_t index = (size_t) strmap_get(priv->dispatch, name);
+    if (index == 0) {
+        return (Operation){ 0 };
     }
-    return (Operation){ 0 };
+    return manager->operations[index - 1];
+}
+
+// Map a name to an operation. The first registration of a name wins.
+static void operation_dispatch_add(OperationManagerPriv *priv, const char *name, size_t len, size_t index) {
+    char key[len + 1];
+    memcpy(key, name, len);
+    key[len] = '\0';
+    if (len == 0 || strmap_has(priv->dispatch, key)) {
+        return;
+    }
+    strmap_set(priv->dispatch, key, (void *) (index + 1));
 }
 
 void visible operation_register(OperationManager *manager, Operation new_op) {
@@ -84,15 +144,45 @@ void visible operation_register(OperationManager *manager, Operation new_op) {
             print(_("Memory allocation failed\n"));
             return;
         }
-
-        // Update the manager's ops and capacity
         manager->operations = new_ops;
+        OperationManagerPriv *priv = (OperationManagerPriv *) manager->priv_data;
+        bool *thread_safe = realloc(priv->thread_safe, sizeof(bool) * new_capacity);
+        if (thread_safe == NULL) {
+            print(_("Memory allocation failed\n"));
+            return;
+        }
+        memset(thread_safe + manager->capacity, 0, sizeof(bool) * (new_capacity - manager->capacity));
+        priv->thread_safe = thread_safe;
+
+        // Update the manager's capacity
         manager->capacity = new_capacity;
     }
 
     // Add the new operation to the array
     manager->operations[manager->length] = new_op;  // Assuming Operation has a proper assignment operator
-    manager->length++;                              // Increment the count of operations
+
+    // Index the name and every ':' separated alias
+    OperationManagerPriv *priv = (OperationManagerPriv *) manager->priv_data;
+    if (new_op.name) {
+        operation_dispatch_add(priv, new_op.name, strlen(new_op.name), manager->length);
+    }
+    for (const char *alias = new_op.alias; alias && *alias;) {
+        const char *end = strchr(alias, ':');
+        size_t len = end ? (size_t) (end - alias) : strlen(alias);
+        operation_dispatch_add(priv, alias, len, manager->length);
+        alias += end ? len + 1 : len;
+    }
+    manager->length++;  // Increment the count of operations
+}
+
+void visible operation_set_thread_safe(OperationManager *manager, const char *name) {
+    OperationManagerPriv *priv = (OperationManagerPriv *) manager->priv_data;
+    size_t index = (size_t) strmap_get(priv->dispatch, name);
+    if (index == 0) {
+        warning("Operation not found: %s\n", name);
+        return;
+    }
+    priv->thread_safe[index - 1] = true;
 }
 
 int visible operation_main(OperationManager *manager, const char *name, void *args) {
@@ -115,20 +205,30 @@ int visible operation_main(OperationManager *manager, const char *name, void *ar
         debug("Min arguments error\n");
         goto operation_main_on_error;
     }
-    priv->running = true;
-    mode_t u = umask(0022);
-    set_value("OPERATION", op.name);
+    // Operations keep their state in globals, parallel blocks and background
+    // lines of ympsh run them one at a time unless they are thread safe
+    bool serial = !priv->thread_safe[(size_t) strmap_get(priv->dispatch, name) - 1];
+    if (serial) {
+        pthread_mutex_lock(&priv->serial);
+    }
+    char *previous = NULL;
+    bool owner = operation_enter(priv, op.name, &previous);
+    trace_begin(op.name, NULL);
     status = op.call(args);
-    set_value("OPERATION", "");
-    (void) umask(u);
-    priv->running = false;
+    trace_end();
+    operation_leave(priv, owner, previous);
+    if (serial) {
+        pthread_mutex_unlock(&priv->serial);
+    }
     if (status > 0) {
     operation_main_on_error:
         warning("Operation failed: %s Exited with : %d\n", op.name, status);
         if (manager->on_error.call) {
-            mode_t ue = umask(0022);
+            pthread_mutex_lock(&priv->serial);
+            (void) operation_enter(priv, NULL, NULL);
             manager->on_error.call(NULL);
-            (void) umask(ue);
+            operation_leave(priv, false, NULL);
+            pthread_mutex_unlock(&priv->serial);
         }
     }
     return status;
@@ -0,0 +1,183 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <core/logger.h>
+#include <core/stats.h>
+#include <core/ymp.h>
+#include <sys/resource.h>
+#include <utils/file.h>
+
+#define STATS_MAX_PHASES 32
+#define STATS_NAME_SIZE 32
+
+static uint64_t counters[STATS_MAX];
+
+static const struct {
+    const char *name;
+    bool bytes;
+} counter_info[STATS_MAX] = {
+    [STATS_BYTES_DOWNLOADED] = { "downloaded", true },
+    [STATS_BYTES_REUSED] = { "reused", true },
+    [STATS_BYTES_SHA512] = { "hashed sha512", true },
+    [STATS_BYTES_SHA256] = { "hashed sha256", true },
+    [STATS_BYTES_SHA1] = { "hashed sha1", true },
+    [STATS_BYTES_MD5] = { "hashed md5", true },
+    [STATS_BYTES_YAML] = { "yaml parsed", true },
+    [STATS_FILES_EXTRACTED] = { "files extracted", false },
+    [STATS_FILES_SYNCED] = { "files synced", false },
+    [STATS_FILES_REMOVED] = { "files removed", false },
+    [STATS_DIRS_CREATED] = { "dirs created", false },
+    [STATS_FORKS_GPG] = { "forks gpg", false },
+    [STATS_FORKS_BASH] = { "forks bash", false },
+    [STATS_FORKS_OBJCOPY] = { "forks objcopy", false },
+};
+
+// Wall time of a phase, the union of its open spans
+typedef struct {
+    char name[STATS_NAME_SIZE];
+    int open;       // spans of the phase open right now
+    uint64_t since; // when open became non zero
+    uint64_t wall;
+    uint64_t count;
+} Phase;
+
+static struct {
+    pthread_mutex_t lock;
+    int enabled;
+    Phase items[STATS_MAX_PHASES];
+    size_t length;
+} phases = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static uint64_t stats_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+visible void stats_add(StatsCounter counter, uint64_t value) {
+    if (counter < STATS_MAX) {
+        __atomic_add_fetch(&counters[counter], value, __ATOMIC_RELAXED);
+    }
+}
+
+visible uint64_t stats_get(StatsCounter counter) {
+    return counter < STATS_MAX ? __atomic_load_n(&counters[counter], __ATOMIC_RELAXED) : 0;
+}
+
+visible void stats_set_status(bool status) {
+    __atomic_store_n(&phases.enabled, status, __ATOMIC_RELEASE);
+}
+
+visible bool stats_enabled() {
+    return __atomic_load_n(&phases.enabled, __ATOMIC_ACQUIRE) != 0;
+}
+
+// Find or add a phase, lock must be held
+static Phase *stats_phase(const char *name, bool create) {
+    for (size_t i = 0; i < phases.length; i++) {
+        if (strncmp(phases.items[i].name, name, STATS_NAME_SIZE - 1) == 0) {
+            return &phases.items[i];
+        }
+    }
+    if (!create || phases.length == STATS_MAX_PHASES) {
+        return NULL;
+    }
+    Phase *phase = &phases.items[phases.length++];
+    memset(phase, 0, sizeof(Phase));
+    snprintf(phase->name, sizeof(phase->name), "%s", name);
+    return phase;
+}
+
+visible void stats_phase_enter(const char *name) {
+    if (!name || !stats_enabled()) {
+        return;
+    }
+    uint64_t now = stats_now();
+    pthread_mutex_lock(&phases.lock);
+    Phase *phase = stats_phase(name, true);
+    if (phase && phase->open++ == 0) {
+        phase->since = now;
+    }
+    pthread_mutex_unlock(&phases.lock);
+}
+
+visible void stats_phase_leave(const char *name) {
+    if (!name || !stats_enabled()) {
+        return;
+    }
+    uint64_t now = stats_now();
+    pthread_mutex_lock(&phases.lock);
+    Phase *phase = stats_phase(name, false);
+    // Spans opened before stats were enabled are not open here
+    if (phase && phase->open > 0) {
+        phase->count++;
+        if (--phase->open == 0) {
+            phase->wall += now - phase->since;
+        }
+    }
+    pthread_mutex_unlock(&phases.lock);
+}
+
+visible uint64_t stats_phase_get(const char *name, uint64_t *count) {
+    uint64_t wall = 0;
+    if (count) {
+        *count = 0;
+    }
+    uint64_t now = stats_now();
+    pthread_mutex_lock(&phases.lock);
+    Phase *phase = name ? stats_phase(name, false) : NULL;
+    if (phase) {
+        wall = phase->wall + (phase->open > 0 ? now - phase->since : 0);
+        if (count) {
+            *count = phase->count;
+        }
+    }
+    pthread_mutex_unlock(&phases.lock);
+    return wall;
+}
+
+visible void stats_reset() {
+    for (size_t i = 0; i < STATS_MAX; i++) {
+        __atomic_store_n(&counters[i], 0, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_lock(&phases.lock);
+    phases.length = 0;
+    pthread_mutex_unlock(&phases.lock);
+}
+
+visible void stats_print() {
+    char size[32];
+    print("%s:\n", _("Statistics"));
+    for (size_t i = 0; i < STATS_MAX; i++) {
+        uint64_t value = stats_get(i);
+        if (value == 0) {
+            continue;
+        }
+        if (counter_info[i].bytes) {
+            format_size(size, sizeof(size), value);
+            print("  %-16s: %lu (%s)\n", counter_info[i].name, value, size);
+        } else {
+            print("  %-16s: %lu\n", counter_info[i].name, value);
+        }
+    }
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        // ru_maxrss is in kilobytes
+        format_size(size, sizeof(size), (size_t) usage.ru_maxrss * 1024);
+        print("  %-16s: %s\n", "peak rss", size);
+    }
+    pthread_mutex_lock(&phases.lock);
+    uint64_t now = stats_now();
+    for (size_t i = 0; i < phases.length; i++) {
+        Phase *phase = &phases.items[i];
+        uint64_t wall = phase->wall + (phase->open > 0 ? now - phase->since : 0);
+        print("  %-16s: %lu.%03lu ms (%lu spans)\n", phase->name, wall / 1000000, (wall / 1000) % 1000, phase->count);
+    }
+    pthread_mutex_unlock(&phases.lock);
+}
@@ -0,0 +1,212 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <core/logger.h>
+#include <core/stats.h>
+#include <core/trace.h>
+#include <core/ymp.h>
+
+#define TRACE_MAX_DEPTH 64
+#define TRACE_FLUSH_SIZE (64 * 1024)
+#define trace_append_literal(S) trace_append(S, sizeof(S) - 1)
+
+typedef struct {
+    const char *name;
+    char *detail;
+    uint64_t start;
+} Span;
+
+// Open spans of the current thread
+static __thread Span spans[TRACE_MAX_DEPTH];
+static __thread int depth = 0;
+static __thread long tid = 0;
+
+// Events are collected in a buffer and written with write(2), so a forked
+// child that exits does not flush a copy of them.
+static struct {
+    pthread_mutex_t lock;
+    int enabled;
+    int fd;
+    pid_t pid;
+    uint64_t begin;
+    char *buffer;
+    size_t length;
+    size_t capacity;
+} trace = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .fd = -1,
+};
+
+static uint64_t trace_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void trace_flush() {
+    size_t done = 0;
+    while (done < trace.length) {
+        ssize_t written = write(trace.fd, trace.buffer + done, trace.length - done);
+        if (written <= 0) {
+            break;
+        }
+        done += written;
+    }
+    trace.length = 0;
+}
+
+// Append to the event buffer, lock must be held
+static void trace_append(const char *data, size_t len) {
+    if (trace.length + len > trace.capacity) {
+        size_t capacity = trace.capacity ? trace.capacity : TRACE_FLUSH_SIZE;
+        while (capacity < trace.length + len) {
+            capacity *= 2;
+        }
+        char *buffer = realloc(trace.buffer, capacity);
+        if (!buffer) {
+            return;
+        }
+        trace.buffer = buffer;
+        trace.capacity = capacity;
+    }
+    memcpy(trace.buffer + trace.length, data, len);
+    trace.length += len;
+}
+
+static void trace_append_escaped(const char *str) {
+    char esc[8];
+    for (const char *c = str; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            esc[0] = '\\';
+            esc[1] = *c;
+            trace_append(esc, 2);
+        } else if ((unsigned char) *c < 0x20) {
+            int len = snprintf(esc, sizeof(esc), "\\u%04x", (unsigned char) *c);
+            trace_append(esc, len);
+        } else {
+            trace_append(c, 1);
+        }
+    }
+}
+
+visible bool trace_start(const char *path) {
+    if (!path || path[0] == '\0' || trace_enabled()) {
+        return false;
+    }
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        warning("Failed to open trace file: %s\n", path);
+        return false;
+    }
+    pthread_mutex_lock(&trace.lock);
+    trace.fd = fd;
+    trace.pid = getpid();
+    trace.begin = trace_now();
+    trace.length = 0;
+    char head[128];
+    int len = snprintf(head, sizeof(head),
+                       "{\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"ymp\"}}",
+                       trace.pid);
+    trace_append(head, len);
+    __atomic_store_n(&trace.enabled, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&trace.lock);
+    return true;
+}
+
+visible void trace_stop() {
+    pthread_mutex_lock(&trace.lock);
+    if (trace.enabled) {
+        __atomic_store_n(&trace.enabled, 0, __ATOMIC_RELEASE);
+        trace_append_literal("\n]}\n");
+        trace_flush();
+        close(trace.fd);
+        trace.fd = -1;
+        free(trace.buffer);
+        trace.buffer = NULL;
+        trace.capacity = 0;
+    }
+    pthread_mutex_unlock(&trace.lock);
+}
+
+visible bool trace_enabled() {
+    return __atomic_load_n(&trace.enabled, __ATOMIC_ACQUIRE) != 0;
+}
+
+visible void trace_begin(const char *name, const char *format, ...) {
+    bool tracing = trace_enabled();
+    // Spans also measure the phases of stats
+    if (!tracing && !stats_enabled()) {
+        return;
+    }
+    stats_phase_enter(name);
+    if (depth < TRACE_MAX_DEPTH) {
+        Span *span = &spans[depth];
+        span->name = name;
+        span->detail = NULL;
+        if (format && tracing) {
+            va_list args;
+            va_start(args, format);
+            if (vasprintf(&span->detail, format, args) < 0) {
+                span->detail = NULL;
+            }
+            va_end(args);
+        }
+        span->start = trace_now();
+    }
+    depth++;
+}
+
+visible void trace_end() {
+    if (depth == 0) {
+        return;
+    }
+    depth--;
+    if (depth >= TRACE_MAX_DEPTH) {
+        return;
+    }
+    Span *span = &spans[depth];
+    stats_phase_leave(span->name);
+    if (!trace_enabled()) {
+        free(span->detail);
+        span->detail = NULL;
+        return;
+    }
+    uint64_t end = trace_now();
+    if (tid == 0) {
+        tid = syscall(SYS_gettid);
+    }
+    pthread_mutex_lock(&trace.lock);
+    // Spans of forked children would end up in the file of the parent
+    if (trace.enabled && getpid() == trace.pid && span->start >= trace.begin) {
+        char event[160];
+        int len = snprintf(event, sizeof(event),
+                           ",\n{\"ph\":\"X\",\"pid\":%d,\"tid\":%ld,\"ts\":%.3f,\"dur\":%.3f,\"name\":\"",
+                           trace.pid, tid, (span->start - trace.begin) / 1000.0,
+                           (end - span->start) / 1000.0);
+        trace_append(event, len);
+        trace_append_escaped(span->name);
+        trace_append_literal("\"");
+        if (span->detail) {
+            trace_append_literal(",\"args\":{\"detail\":\"");
+            trace_append_escaped(span->detail);
+            trace_append_literal("\"}");
+        }
+        trace_append_literal("}");
+        if (trace.length >= TRACE_FLUSH_SIZE) {
+            trace_flush();
+        }
+    }
+    pthread_mutex_unlock(&trace.lock);
+    free(span->detail);
+    span->detail = NULL;
+}
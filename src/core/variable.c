@@ -1,3 +1,4 @@
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -6,74 +7,157 @@
 #include <core/logger.h>
 #include <core/variable.h>
 #include <core/ymp.h>
+#include <utils/strset.h>
 
-typedef struct {
-    char *name;
-    char *value;
+// Entries are never moved or freed before the manager, so handles stay valid.
+struct VariableHandle {
+    const char *name;
+    char *value; // NULL until set, swapped atomically
     bool read_only;
-} YmpVariable;
+};
+
+// Options of the current thread, read before the global variables
+static __thread VariableManager *options = NULL;
+
+typedef struct {
+    strmap *index;        // name -> VariableHandle, lock-free reads
+    strpool *strings;     // names, there are few of them
+    pthread_mutex_t lock; // serializes writers, guards pins and retired
+    int pins;             // sections whose readers may still use replaced values
+    char **retired;       // values replaced while pinned
+    size_t retired_len;
+    size_t retired_cap;
+} VariablePriv;
 
 visible VariableManager *variable_manager_new() {
     VariableManager *variables = (VariableManager *) calloc(1, sizeof(VariableManager));
     if (!variables) {
         return NULL;  // Handle memory allocation failure
     }
-    variables->capacity = 32;  // Initialize with a reasonable capacity
-    variables->length = 0;
-    variables->priv_data = calloc(variables->capacity, sizeof(YmpVariable));
-    if (!variables->priv_data) {
+    VariablePriv *priv = calloc(1, sizeof(VariablePriv));
+    if (!priv) {
+        free(variables);
+        return NULL;  // Handle memory allocation failure
+    }
+    priv->strings = strpool_new();
+    priv->index = strmap_new(STRSET_LOCKED | STRSET_BORROW);
+    if (!priv->strings || !priv->index) {
+        strpool_unref(priv->strings);
+        strmap_unref(priv->index);
+        free(priv);
         free(variables);
         return NULL;  // Handle memory allocation failure
     }
+    priv->lock = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
+    variables->priv_data = priv;
+    variables->length = 0;
+    variables->capacity = 0;
     return variables;
 }
 
 visible void variable_manager_unref(VariableManager *variables) {
-    YmpVariable *vars = (YmpVariable *) variables->priv_data;
-    for (size_t i = 0; i < variables->length; i++) {
-        free(vars[i].value);
-        free(vars[i].name);
+    VariablePriv *priv = (VariablePriv *) variables->priv_data;
+    size_t pos = 0;
+    void *handle;
+    while (strmap_iter(priv->index, &pos, NULL, &handle)) {
+        free(((VariableHandle *) handle)->value);
+        free(handle);
+    }
+    for (size_t i = 0; i < priv->retired_len; i++) {
+        free(priv->retired[i]);
     }
-    free(vars);
+    free(priv->retired);
+    strmap_unref(priv->index);
+    strpool_unref(priv->strings);
+    pthread_mutex_destroy(&priv->lock);
+    free(priv);
     free(variables);
 }
 
+// Find or create the entry of a variable. Writer lock must be held.
+static VariableHandle *variable_entry(VariableManager *variables, const char *name) {
+    VariablePriv *priv = (VariablePriv *) variables->priv_data;
+    VariableHandle *handle = strmap_get(priv->index, name);
+    if (handle) {
+        return handle;
+    }
+    handle = calloc(1, sizeof(VariableHandle));
+    if (!handle) {
+        print(_("Memory allocation failed\n"));
+        return NULL;
+    }
+    handle->name = strpool_intern(priv->strings, name);
+    strmap_set(priv->index, handle->name, handle);
+    variables->length++;
+    return handle;
+}
+
 static void variable_set_value_fn(VariableManager *variables, const char *name, const char *value, bool read_only) {
     if (!variables) {
         print(_("Invalid VariableManager\n"));
         return;
     }
-    YmpVariable *vars = (YmpVariable *) variables->priv_data;
-
-    // Search for existing variable
-    for (size_t i = 0; i < variables->length; i++) {
-        if (!read_only && vars[i].read_only) {
-            continue;
-        }
-        if (strcmp(name, vars[i].name) == 0) {
-            free(vars[i].value);            // Free old value
-            vars[i].value = strdup(value);  // Allocate new memory for the value
-            return;
+    VariablePriv *priv = (VariablePriv *) variables->priv_data;
+    pthread_mutex_lock(&priv->lock);
+    VariableHandle *handle = variable_entry(variables, name);
+    if (!handle) {
+        pthread_mutex_unlock(&priv->lock);
+        return;
+    }
+    // Read-only variables can only be changed by another read-only set
+    if (!read_only && handle->read_only) {
+        pthread_mutex_unlock(&priv->lock);
+        return;
+    }
+    if (handle->value == NULL) {
+        handle->read_only = read_only;
+    }
+    debug("variable set: %s => %s\n", name, value);
+    // Pinned readers may still use the old value, it is freed by the last unpin
+    char *copy = value ? strdup(value) : NULL;
+    char *old = __atomic_exchange_n(&handle->value, copy, __ATOMIC_ACQ_REL);
+    if (old && priv->pins > 0) {
+        if (priv->retired_len == priv->retired_cap) {
+            size_t capacity = priv->retired_cap ? priv->retired_cap * 2 : 32;
+            char **retired = realloc(priv->retired, sizeof(char *) * capacity);
+            if (!retired) {
+                // Leak it rather than free it under a reader
+                pthread_mutex_unlock(&priv->lock);
+                return;
+            }
+            priv->retired = retired;
+            priv->retired_cap = capacity;
         }
+        priv->retired[priv->retired_len++] = old;
+    } else {
+        free(old);
     }
+    pthread_mutex_unlock(&priv->lock);
+}
 
-    if (variables->length >= variables->capacity) {
-        // Reallocate variable storage
-        variables->capacity += 32;
-        YmpVariable *new_vars = realloc(variables->priv_data, sizeof(YmpVariable) * variables->capacity);
-        if (!new_vars) {
-            print(_("Memory allocation failed\n"));
-            return;
-        }
-        variables->priv_data = new_vars;
-        vars = new_vars;  // Update local pointer
+visible void variable_pin(VariableManager *variables) {
+    if (!variables) {
+        return;
     }
+    VariablePriv *priv = (VariablePriv *) variables->priv_data;
+    pthread_mutex_lock(&priv->lock);
+    priv->pins++;
+    pthread_mutex_unlock(&priv->lock);
+}
 
-    debug("variable set: %s => %s\n", name, value);
-    vars[variables->length].name = strdup(name);    // Allocate memory for the name
-    vars[variables->length].value = strdup(value);  // Allocate memory for the value
-    vars[variables->length].read_only = read_only;
-    variables->length++;
+visible void variable_unpin(VariableManager *variables) {
+    if (!variables) {
+        return;
+    }
+    VariablePriv *priv = (VariablePriv *) variables->priv_data;
+    pthread_mutex_lock(&priv->lock);
+    if (--priv->pins == 0) {
+        for (size_t i = 0; i < priv->retired_len; i++) {
+            free(priv->retired[i]);
+        }
+        priv->retired_len = 0;
+    }
+    pthread_mutex_unlock(&priv->lock);
 }
 
 void visible variable_set_value(VariableManager *variables, const char *name, const char *value) {
@@ -84,19 +168,66 @@ void visible variable_set_value_read_only(VariableManager *variables, const char
     variable_set_value_fn(variables, name, value, true);
 }
 
+visible VariableHandle *variable_lookup(VariableManager *variables, const char *name) {
+    if (!variables) {
+        print(_("Invalid VariableManager\n"));
+        return NULL;
+    }
+    VariablePriv *priv = (VariablePriv *) variables->priv_data;
+    VariableHandle *handle = strmap_get(priv->index, name);
+    if (handle) {
+        return handle;
+    }
+    pthread_mutex_lock(&priv->lock);
+    handle = variable_entry(variables, name);
+    pthread_mutex_unlock(&priv->lock);
+    return handle;
+}
+
+visible char *variable_handle_get(VariableHandle *handle) {
+    if (!handle) {
+        return "";
+    }
+    char *value = __atomic_load_n(&handle->value, __ATOMIC_ACQUIRE);
+    if (value == NULL) {
+        return "";  // Return empty string if not set
+    }
+    return value;
+}
+
+visible char *variable_handle_dup(VariableHandle *handle) {
+    if (!handle) {
+        return strdup("");
+    }
+    char *value = __atomic_load_n(&handle->value, __ATOMIC_ACQUIRE);
+    return strdup(value ? value : "");
+}
+
 visible char *variable_get_value(VariableManager *variables, const char *name) {
     if (!variables) {
         print(_("Invalid VariableManager\n"));
         return "";
     }
-    YmpVariable *vars = (YmpVariable *) variables->priv_data;
     debug("variable get: %s\n", name);
-    for (size_t i = 0; i < variables->length; i++) {
-        if (strcmp(name, vars[i].name) == 0) {
-            return vars[i].value;  // Return the value if found
+    if (options && options != variables && global && variables == global->variables) {
+        VariablePriv *opriv = (VariablePriv *) options->priv_data;
+        VariableHandle *handle = strmap_get(opriv->index, name);
+        if (handle && __atomic_load_n(&handle->value, __ATOMIC_ACQUIRE)) {
+            return variable_handle_get(handle);
         }
     }
-    return "";  // Return empty string if not found
+    VariablePriv *priv = (VariablePriv *) variables->priv_data;
+    return variable_handle_get(strmap_get(priv->index, name));
+}
+
+visible VariableManager *variable_set_options(VariableManager *variables) {
+    VariableManager *previous = options;
+    options = variables;
+    return previous;
+}
+
+visible VariableManager *variable_get_options() {
+    return options;
 }
 
 visible char **variable_get_names(VariableManager *variables) {
@@ -104,16 +235,21 @@ visible char **variable_get_names(VariableManager *variables) {
         print(_("Invalid VariableManager\n"));
         return NULL;
     }
-    YmpVariable *vars = (YmpVariable *) variables->priv_data;
+    VariablePriv *priv = (VariablePriv *) variables->priv_data;
     array *a = array_new();
-    for (size_t i = 0; i < variables->length; i++) {
-        debug("variable : %s\n", vars[i].name);
-        array_add(a, vars[i].name);
+    size_t pos = 0;
+    const char *name;
+    void *handle;
+    while (strmap_iter(priv->index, &pos, &name, &handle)) {
+        // Skip handles looked up before the variable was set
+        if (__atomic_load_n(&((VariableHandle *) handle)->value, __ATOMIC_ACQUIRE) == NULL) {
+            continue;
+        }
+        debug("variable : %s\n", name);
+        array_add(a, name);
     }
     array_sort(a);
-    char **ret = array_get(a, NULL);
-    array_unref(a);
-    return ret;
+    return array_steal(a, NULL);
 }
 
 char *get_value(const char *name) {
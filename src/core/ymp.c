@@ -11,6 +11,8 @@
 #include <config.h>
 
 #include <core/logger.h>
+#include <core/stats.h>
+#include <core/trace.h>
 #include <core/ymp.h>
 #include <utils/error.h>
 #include <utils/file.h>
@@ -182,6 +184,9 @@ visible int ymp_run(Ymp *ymp) {
     size_t begin_time = get_epoch();
 #endif
     ymp_set_logger_status();
+    bool tracing = trace_start(get_value("trace"));
+    bool stats = get_bool("stats");
+    stats_set_status(stats);
     YmpPrivate *queue = (YmpPrivate *) ymp->priv_data;
     int rc = 0;
     for (size_t i = 0; i < queue->length; i++) {
@@ -193,6 +198,13 @@ visible int ymp_run(Ymp *ymp) {
     free(queue->item);
     free(queue);
     ymp->priv_data = (void *) queue_init();
+    if (tracing) {
+        trace_stop();
+    }
+    if (stats) {
+        stats_print();
+        stats_set_status(false);
+    }
 #ifndef NDEBUG
     debug("ymp run done in %ld µs\n", get_epoch() - begin_time);
 #endif
@@ -1,7 +1,10 @@
 #define _GNU_SOURCE
 #include <config.h>
+#include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <libgen.h>
+#include <pthread.h>
 #include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,8 +12,13 @@
 
 #include <core/logger.h>
 #include <core/operations.h>
+#include <core/stats.h>
+#include <core/trace.h>
 #include <core/ymp.h>
 #include <data/build.h>
+#include <data/package.h>
+#include <sys/stat.h>
+#include <sys/sysinfo.h>
 #include <sys/types.h>
 #include <sys/utsname.h>
 #include <sys/wait.h>
@@ -19,35 +27,149 @@
 #include <utils/file.h>
 #include <utils/gui.h>
 #include <utils/hash.h>
+#include <utils/jobs.h>
+#include <utils/jobserver.h>
 #include <utils/sandbox.h>
+#include <utils/strset.h>
 #include <utils/string.h>
 #include <utils/tty.h>
 #include <utils/yaml.h>
 
-visible char *ympbuild_get_value(ympbuild *ymp, const char *name) {
+// Variables of a ympbuild, evaluated once and cached in priv_data
+typedef struct {
+    const char *ctx; // context the variables were read from
+    char *data;      // NUL delimited output, the maps point into it
+    strmap *values;  // name -> ${name}
+    strmap *arrays;  // name -> ${name[@]}
+} ympbuild_variables;
+
+static void ympbuild_free_variables(ympbuild *ymp) {
+    ympbuild_variables *vars = ymp->priv_data;
+    if (!vars) {
+        return;
+    }
+    strmap_unref(vars->values);
+    strmap_unref(vars->arrays);
+    free(vars->data);
+    free(vars);
+    ymp->priv_data = NULL;
+}
+
+// Make jobserver of the builds running at the same time, they share one
+// CPU budget of build:jobs slots. Every sandbox holds a reference.
+static pthread_mutex_t build_jobserver_lock = PTHREAD_MUTEX_INITIALIZER;
+static jobserver *build_jobserver = NULL;
+static size_t build_jobserver_users = 0;
+
+static jobserver *build_jobserver_ref() {
+    pthread_mutex_lock(&build_jobserver_lock);
+    if (build_jobserver_users++ == 0) {
+        size_t tokens = strtoul(variable_get_value(global->variables, "build:jobs"), NULL, 10);
+        if (tokens == 0) {
+            tokens = get_nprocs_conf();
+        }
+        char *dir = build_string("%s/jobserver-%d", BUILD_DIR, getpid());
+        build_jobserver = jobserver_new(dir, tokens);
+        free(dir);
+    }
+    jobserver *js = build_jobserver;
+    pthread_mutex_unlock(&build_jobserver_lock);
+    return js;
+}
+
+static void build_jobserver_unref() {
+    pthread_mutex_lock(&build_jobserver_lock);
+    if (build_jobserver_users > 0 && --build_jobserver_users == 0) {
+        jobserver_unref(build_jobserver);
+        build_jobserver = NULL;
+    }
+    pthread_mutex_unlock(&build_jobserver_lock);
+}
+
+// Free the state ympbuild_get_value() and ympbuild_run_function() attach
+static void ympbuild_release(ympbuild *ymp) {
+    ympbuild_free_variables(ymp);
+    if (ymp->sandbox) {
+        sandbox_unref(ymp->sandbox);
+        ymp->sandbox = NULL;
+        build_jobserver_unref();
+    }
+}
+
+static ympbuild_variables *ympbuild_load_variables(ympbuild *ymp) {
+    ympbuild_variables *vars = ymp->priv_data;
+    if (vars && vars->ctx == ymp->ctx) {
+        return vars;
+    }
+    ympbuild_free_variables(ymp);
+    // Source the ympbuild once and print every variable as
+    // "name\0value\0array\0", words are joined like echo does
     char *command = build_string(
         "exec <&-\n"
         "{\n%s\n} &>/dev/null\n"
-        "echo -n ${%s}",
-        ymp->ctx, name);
+        "set +eu\n"
+        "for __ymp_name in $(compgen -v) ; do\n"
+        "    __ymp_array=\"${__ymp_name}[@]\"\n"
+        "    printf '%%s\\0' \"$__ymp_name\"\n"
+        "    printf '%%s ' ${!__ymp_name}\n"
+        "    printf '\\0'\n"
+        "    printf '%%s ' ${!__ymp_array}\n"
+        "    printf '\\0'\n"
+        "done\n",
+        ymp->ctx ? ymp->ctx : "");
     char *args[] = { "/bin/bash", "-c", command, NULL };
-    char *output = strip(getoutput_unshare(args, CLONE_NEWNS | CLONE_NEWUTS | CLONE_NEWUSER | CLONE_NEWNET | CLONE_NEWPID));
-    debug("variable: %s -> %s\n", name, output);
+    stats_add(STATS_FORKS_BASH, 1);
+    size_t size = 0;
+    char *data = getoutput_unshare_size(args, CLONE_NEWNS | CLONE_NEWUTS | CLONE_NEWUSER | CLONE_NEWNET | CLONE_NEWPID, &size);
     free(command);
+    if (!data) {
+        return NULL;
+    }
+    vars = calloc(1, sizeof(ympbuild_variables));
+    if (!vars) {
+        free(data);
+        return NULL;
+    }
+    vars->ctx = ymp->ctx;
+    vars->data = data;
+    vars->values = strmap_new(STRSET_BORROW);
+    vars->arrays = strmap_new(STRSET_BORROW);
+    char *end = data + size;
+    char *pos = data;
+    while (pos < end) {
+        char *fields[3];
+        size_t i = 0;
+        for (i = 0; i < 3 && pos < end; i++) {
+            fields[i] = pos;
+            pos += strlen(pos) + 1;
+        }
+        if (i < 3) {
+            break;  // truncated record
+        }
+        strmap_set(vars->values, fields[0], fields[1]);
+        strmap_set(vars->arrays, fields[0], fields[2]);
+    }
+    debug("variables: %zu\n", strmap_length(vars->values));
+    ymp->priv_data = vars;
+    return vars;
+}
+
+visible char *ympbuild_get_value(ympbuild *ymp, const char *name) {
+    ympbuild_variables *vars = ympbuild_load_variables(ymp);
+    const char *value = vars ? strmap_get(vars->values, name) : NULL;
+    char *output = strip(value ? value : "");
+    debug("variable: %s -> %s\n", name, output);
     return output;
 }
 
 visible char **ympbuild_get_array(ympbuild *ymp, const char *name) {
-    char *command = build_string(
-        "exec <&-\n"
-        "{\n%s\n} &>/dev/null\n"
-        "echo -n ${%s[@]}",
-        ymp->ctx, name);
-    char *args[] = { "/bin/bash", "-c", command, NULL };
-    char *output = strip(getoutput_unshare(args, CLONE_NEWNS | CLONE_NEWUTS | CLONE_NEWUSER | CLONE_NEWNET | CLONE_NEWPID));
+    ympbuild_variables *vars = ympbuild_load_variables(ymp);
+    const char *value = vars ? strmap_get(vars->arrays, name) : NULL;
+    char *output = strip(value ? value : "");
     debug("variable: %s -> %s\n", name, output);
-    free(command);
-    return split(output, " ");
+    char **ret = split(output, " ");
+    free(output);
+    return ret;
 }
 
 visible char *ympbuild_package_filename(const char *path) {
@@ -77,6 +199,7 @@ ympbuild_package_filename_free:
     free(name);
     free(version);
     free(release);
+    ympbuild_release(ymp);
     free(ymp->ctx);
     free(ymp);
     free(ympfile);
@@ -110,6 +233,7 @@ ympbuild_source_filename_free:
     free(name);
     free(version);
     free(release);
+    ympbuild_release(ymp);
     free(ymp->ctx);
     free(ymp);
     free(ympfile);
@@ -117,6 +241,7 @@ ympbuild_source_filename_free:
 }
 
 visible int ympbuild_check(char *ympfile) {
+    stats_add(STATS_FORKS_BASH, 1);
     pid_t pid = fork();
     if (pid == 0) {
         char *args[] = { "/bin/bash", "-n", ympfile, NULL };
@@ -130,12 +255,14 @@ visible int ympbuild_check(char *ympfile) {
     }
 }
 
-static void sandbox_build(ympbuild *ymp) {
+// Sandbox of the build phases, the mounts are prepared once per build
+static sandbox_handle_t *sandbox_build(ympbuild *ymp, jobserver *js) {
     // Create and configure the sandbox.
     char *uuid = generate_uuid();
     sandbox_handle_t *handle = sandbox_new();
     if (!handle) {
-        exit(EXIT_FAILURE);
+        free(uuid);
+        return NULL;
     }
     sandbox_configure_hostname(handle, uuid);
     sandbox_configure_bind(handle, "tmpfs", "/tmp");
@@ -147,21 +274,37 @@ static void sandbox_build(ympbuild *ymp) {
 
     };
     for (size_t i = 0; dirs[i]; i++) {
-        sandbox_configure_bind(handle, dirs[i], dirs[i]);
+        if (isexists(dirs[i])) {
+            sandbox_configure_bind(handle, dirs[i], dirs[i]);
+        }
     }
 
     sandbox_configure_bind(handle, ymp->path, ymp->path);
+    if (js) {
+        sandbox_configure_bind(handle, js->dir, js->dir);
+    }
 
     sandbox_configure_network(handle, false);
 
-    // Apply the sandbox and run the command inside it.
-    sandbox_apply(handle);
-    sandbox_unref(handle);
+    // Phases join the prepared namespaces, or set up their own on failure.
+    (void) sandbox_prepare(handle);
     free(uuid);
+    return handle;
 }
 
 visible int ympbuild_run_function(ympbuild *ymp, const char *name) {
+    if (!ymp->sandbox) {
+        ymp->sandbox = sandbox_build(ymp, build_jobserver_ref());
+        if (!ymp->sandbox) {
+            build_jobserver_unref();
+            return -1;
+        }
+    }
+    // Does not change while the sandbox holds a reference
+    jobserver *js = build_jobserver;
     enable_raw_mode();
+    stats_add(STATS_FORKS_BASH, 1);
+    trace_begin(name, NULL);
     pid_t pid = fork();
     if (pid == 0) {
         char *command = build_string(
@@ -178,16 +321,19 @@ visible int ympbuild_run_function(ympbuild *ymp, const char *name) {
             "fi",
             ymp->header, ymp->ctx, name, name, name);
         char *args[] = { "/bin/bash", "-c", command, NULL };
+        // Older make only takes an inherited descriptor, dup() drops O_CLOEXEC
+        int fd = js && !js->fifo ? dup(js->fd) : -1;
+        char *makeflags = js ? jobserver_makeflags(js, fd) : NULL;
         char *envs[] = {
             build_string("PATH=%s:/usr/bin:/usr/sbin:/bin:/sbin/", ymp->path),
             build_string("HOME=%s", ymp->path),
+            makeflags ? build_string("MAKEFLAGS=%s", makeflags) : NULL,
             NULL
         };
-        sandbox_build(ymp);
+        sandbox_apply(ymp->sandbox);
         if (chdir(ymp->path) < 0) {
             warning("Build path is broken!");
-            free(command);
-            return -1;
+            exit(1);
         }
         execve(args[0], args, envs);
         warning("Failed to exec command!");
@@ -197,116 +343,318 @@ visible int ympbuild_run_function(ympbuild *ymp, const char *name) {
         disable_raw_mode();
         int status = 0;
         (void) waitpid(pid, &status, 0);
+        trace_end();
         return status;
     }
 }
 
-static void binary_process(const char *path) {
+// SHA-1 of an output file, reused while the file is unchanged
+typedef struct {
+    char *hash;
+    struct stat st;
+} file_digest;
+
+static void digest_store(strmap *digests, const char *path) {
+    file_digest *d = calloc(1, sizeof(file_digest));
+    if (!d) {
+        return;
+    }
+    if (lstat(path, &d->st) != 0 || !(d->hash = calculate_hash(SHA1, path))) {
+        free(d);
+        return;
+    }
+    strmap_set(digests, path, d);
+}
+
+static char *digest_lookup(strmap *digests, const char *path) {
+    file_digest *d = digests ? strmap_get(digests, path) : NULL;
+    struct stat st;
+    if (d && lstat(path, &st) == 0 && st.st_dev == d->st.st_dev && st.st_ino == d->st.st_ino &&
+        st.st_size == d->st.st_size && st.st_mtim.tv_sec == d->st.st_mtim.tv_sec &&
+        st.st_mtim.tv_nsec == d->st.st_mtim.tv_nsec) {
+        return strdup(d->hash);
+    }
+    return calculate_hash(SHA1, path);
+}
+
+static void digest_unref(strmap *digests) {
+    size_t pos = 0;
+    const char *key = NULL;
+    void *value = NULL;
+    while (strmap_iter(digests, &pos, &key, &value)) {
+        file_digest *d = value;
+        free(d->hash);
+        free(d);
+    }
+    strmap_unref(digests);
+}
+
+static int strip_binary(const char *path, strmap *digests) {
+    stats_add(STATS_FORKS_OBJCOPY, 1);
+    pid_t pid = fork();
+    if (pid == 0) {
+        char *cmd[] = {
+            "objcopy", "-R", ".comment", "-R", ".note", "-R", ".debug_info",
+            "-R", ".debug_aranges", "-R", ".debug_pubnames", "-R", ".debug_pubtypes",
+            "-R", ".debug_abbrev", "-R", ".debug_line", "-R", ".debug_str",
+            "-R", ".debug_ranges", "-R", ".debug_loc", (char *) path, NULL
+        };
+        char *envs[] = { "PATH=/usr/bin:/usr/sbin:/bin:/sbin", NULL };
+        // execve() does not search PATH
+        execvpe(cmd[0], cmd, envs);
+        _exit(1);
+    } else if (pid > 0) {
+        int status = 0;
+        (void) waitpid(pid, &status, 0);
+    }
+    // A file objcopy can not handle stays as is.
+    // Hash it while it is hot in the page cache, the manifest reuses it.
+    digest_store(digests, path);
+    return 0;
+}
+
+static void binary_process(const char *path, strmap *digests) {
     debug("Binary process: %s\n", path);
     // Construct the root filesystem path by appending "/output" to the provided path
     char *rootfs = build_string("%s/output", path);
 
     // Find all inodes (files and symlinks) in the root filesystem
     char **inodes = find(rootfs);
+    jobs *j = jobs_new();
     for (size_t i = 0; inodes[i]; i++) {
         if (endswith(inodes[i], ".a")) {
-            free(inodes[i]);
             continue;
         }
-        if (!is_elf(inodes[i])) {
-            free(inodes[i]);
+        // Symlinks are not followed, their targets are stripped once on their own.
+        // O_NONBLOCK keeps fifos from blocking the walk.
+        int fd = open(inodes[i], O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) {
             continue;
         }
-        print(_("Stripping: %s\n"), inodes[i] + strlen(path) + 7);
-        pid_t pid = fork();
-        if (pid == 0) {
-            char *cmd[] = {
-                "objcopy", "-R", ".comment", "-R", ".note", "-R", ".debug_info",
-                "-R", ".debug_aranges", "-R", ".debug_pubnames", "-R", ".debug_pubtypes",
-                "-R", ".debug_abbrev", "-R", ".debug_line", "-R", ".debug_str",
-                "-R", ".debug_ranges", "-R", ".debug_loc", inodes[i], NULL
-            };
-            char *envs[] = { "PATH=/usr/bin:/usr/sbin:/bin:/sbin", NULL };
-            execve(cmd[0], cmd, envs);
-            exit(1);
-        } else {
-            int status = 0;
-            (void) waitpid(pid, &status, 0);
+        struct stat st;
+        bool elf = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && is_elf_fd(fd);
+        close(fd);
+        if (!elf) {
+            continue;
         }
+        print(_("Stripping: %s\n"), inodes[i] + strlen(path) + 7);
+        int id = jobs_add(j, (callback) strip_binary, inodes[i], digests);
+        jobs_set_class(j, id, JOBS_CLASS_CPU);
+    }
+    // objcopy runs are independent, at most jobs-cpu of them at once
+    jobs_run(j);
+    jobs_unref(j);
+    for (size_t i = 0; inodes[i]; i++) {
         free(inodes[i]);
     }
+    free(inodes);
+    free(rootfs);
 }
 
 static char *hash_types[] = { "sha512sums", "sha256sums", "sha1sums", "md5sums", NULL };
 
+// Sources of one ympbuild, shown as a single progress bar
+typedef struct source_fetch source_fetch;
+typedef struct {
+    const char *id;
+    source_fetch *items;
+    size_t count;
+} source_progress;
+
+// One source, fetched by a job
+struct source_fetch {
+    const char *resource_path;
+    const char *resource_name;
+    size_t resource_type;
+    const char *source_url;
+    const char *expected_hash;
+    bool local;        // copied from the ympbuild directory
+    size_t downloaded; // progress of this source
+    size_t total;
+    source_progress *progress; // NULL without a progress bar
+};
+
 static void fetch_progress_cb(const char *url, size_t downloaded, size_t total, void *userdata) {
     (void) url;
-    const char *id = (const char *) userdata;
-    gui_progress_update(id, downloaded, total);
+    source_fetch *src = (source_fetch *) userdata;
+    __atomic_store_n(&src->downloaded, downloaded, __ATOMIC_RELAXED);
+    __atomic_store_n(&src->total, total, __ATOMIC_RELAXED);
+    size_t done = 0;
+    size_t all = 0;
+    for (size_t i = 0; i < src->progress->count; i++) {
+        done += __atomic_load_n(&src->progress->items[i].downloaded, __ATOMIC_RELAXED);
+        all += __atomic_load_n(&src->progress->items[i].total, __ATOMIC_RELAXED);
+    }
+    gui_progress_update(src->progress->id, done, all);
+}
+
+// Verified downloads, shared by every package and version through their declared hash
+static char *source_store_path(source_fetch *src) {
+    if (src->local || iseq((char *) src->expected_hash, "SKIP")) {
+        return NULL;
+    }
+    const char *algorithm = src->resource_type == SHA512 ? "sha512" : src->resource_type == SHA256 ? "sha256" : NULL;
+    if (!algorithm || strlen(src->expected_hash) == 0) {
+        return NULL;
+    }
+    // The hash is a file name, anything but hex digits is not a valid hash anyway
+    for (const char *c = src->expected_hash; *c; c++) {
+        if (!isxdigit((unsigned char) *c)) {
+            return NULL;
+        }
+    }
+    return build_string("%s/sources/%s/%s", BUILD_DIR, algorithm, src->expected_hash);
+}
+
+static bool same_file(const char *a, const char *b) {
+    struct stat sa, sb;
+    return stat(a, &sa) == 0 && stat(b, &sb) == 0 && sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
 }
 
-static bool get_resource(const char *resource_path, const char *resource_name, size_t resource_type, const char *source_url, const char *expected_hash) {
-    debug("Source: %s %s\n", source_url, expected_hash);
+static int get_resource(source_fetch *src) {
+    debug("Source: %s %s\n", src->source_url, src->expected_hash);
 
     // Get the file name from the source URL
-    char *source_file_name = basename((char *) source_url);
+    char *source_file_name = basename((char *) src->source_url);
 
     // Construct the target cache directory path
-    char *cache_directory = build_string("%s/cache/%s", BUILD_DIR, resource_name);
+    char *cache_directory = build_string("%s/cache/%s", BUILD_DIR, src->resource_name);
     char *target_file_path = build_string("%s/%s", cache_directory, source_file_name);
 
     bool operation_status = true;
+    char *actual_hash = NULL;
+
+    // Files of the store were verified when they were added, skip the hash
+    char *store_path = source_store_path(src);
+    if (store_path && isfile(store_path)) {
+        if (same_file(store_path, target_file_path) || link_file(store_path, target_file_path)) {
+            debug("Source store: %s\n", store_path);
+            stats_add(STATS_BYTES_REUSED, filesize(store_path));
+            free(store_path);
+            free(cache_directory);
+            free(target_file_path);
+            return 0;
+        }
+    }
 
     // Check if the target file already exists
     if (!isfile(target_file_path)) {
         // Download or Copy the resource
         create_dir(cache_directory);
 
-        char *local_file_path = build_string("%s/%s", resource_path, source_url);
-
-        if (isfile(local_file_path)) {
-            free(target_file_path);
-            target_file_path = build_string("%s/%s", cache_directory, source_file_name);
+        if (src->local) {
+            char *local_file_path = build_string("%s/%s", src->resource_path, src->source_url);
             operation_status = copy_file(local_file_path, target_file_path);
+            free(local_file_path);
         } else {
-            if (isatty(STDOUT_FILENO)) {
-                gui_progress_add(resource_name, "Downloading", source_url, 0);
-                operation_status = fetch_with_progress(source_url, target_file_path, fetch_progress_cb, (void *) resource_name);
-                gui_progress_remove(resource_name);
-                gui_end();
+            // Hashed while downloading, moved in place once verified
+            char *part = build_string("%s.part", target_file_path);
+            operation_status = fetch_with_hash(src->source_url, part, src->resource_type, &actual_hash,
+                                               src->progress ? fetch_progress_cb : NULL, src);
+            if (operation_status && !iseq((char *) src->expected_hash, "SKIP") &&
+                !iseq(actual_hash, (char *) src->expected_hash)) {
+                unlink(part);
+            } else if (operation_status) {
+                operation_status = move_file(part, target_file_path);
             } else {
-                operation_status = fetch(source_url, target_file_path);
+                unlink(part);
             }
+            free(part);
         }
-
-        free(local_file_path);
+    } else {
+        stats_add(STATS_BYTES_REUSED, filesize(target_file_path));
+    }
+    if (!operation_status) {
+        print(_("Failed to fetch: %s\n"), src->source_url);
+        free(actual_hash);
+        free(store_path);
+        free(cache_directory);
+        free(target_file_path);
+        return 1;
     }
 
     // Check the hash of the downloaded or copied file
-    char *actual_hash = calculate_hash(resource_type, target_file_path);
+    if (!actual_hash) {
+        actual_hash = calculate_hash(src->resource_type, target_file_path);
+    }
     if (actual_hash == NULL) {
         print(_("Failed to calculate hash for: %s\n"), target_file_path);
+        free(store_path);
         free(cache_directory);
         free(target_file_path);
-        return false;
+        return 1;
     }
 
-    if (iseq((char *) expected_hash, "SKIP")) {
+    if (iseq((char *) src->expected_hash, "SKIP")) {
         warning(_("Skipping hash verification for: %s\n"), source_file_name);
-    } else if (!iseq(actual_hash, (char *) expected_hash)) {
-        print("Archive hash is invalid:\n  -> Expected: %s\n  -> Received: %s\n", expected_hash, actual_hash);
+    } else if (!iseq(actual_hash, (char *) src->expected_hash)) {
+        print("Archive hash is invalid:\n  -> Expected: %s\n  -> Received: %s\n", src->expected_hash, actual_hash);
         free(actual_hash);
+        free(store_path);
         free(cache_directory);
         free(target_file_path);
-        return false;
+        return 1;
     }
     free(actual_hash);
 
+    // Publish the verified file for other packages and versions. An entry
+    // already there is complete and may be in use by another build.
+    if (store_path && !isfile(store_path) && !link_file(target_file_path, store_path)) {
+        warning("%s: %s\n", "Failed to add source to the store", store_path);
+    }
+    free(store_path);
+
     // Cleanup
     free(cache_directory);
     free(target_file_path);
 
-    return operation_status;
+    return 0;
+}
+
+static bool get_resources(const char *resource_path, const char *resource_name, size_t resource_type, char **sources, char **hashs) {
+    size_t count = 0;
+    while (hashs && sources[count] && hashs[count]) {
+        count++;
+    }
+    source_fetch *items = calloc(count + 1, sizeof(source_fetch));
+    if (!items) {
+        return false;
+    }
+    source_progress progress = { resource_name, items, count };
+    bool downloads = false;
+
+    // Downloads share the net class limit, local copies the io one
+    jobs *j = jobs_new();
+    for (size_t i = 0; i < count; i++) {
+        items[i].resource_path = resource_path;
+        items[i].resource_name = resource_name;
+        items[i].resource_type = resource_type;
+        items[i].source_url = sources[i];
+        items[i].expected_hash = hashs[i];
+        char *local_file_path = build_string("%s/%s", resource_path, sources[i]);
+        items[i].local = isfile(local_file_path);
+        free(local_file_path);
+        downloads = downloads || !items[i].local;
+        int id = jobs_add(j, (callback) get_resource, &items[i], NULL);
+        jobs_set_class(j, id, items[i].local ? JOBS_CLASS_IO : JOBS_CLASS_NET);
+    }
+
+    bool gui = downloads && isatty(STDOUT_FILENO);
+    if (gui) {
+        gui_progress_add(resource_name, "Downloading", resource_name, 0);
+        for (size_t i = 0; i < count; i++) {
+            items[i].progress = &progress;
+        }
+    }
+    jobs_run(j);
+    bool status = !j->failed;
+    if (gui) {
+        gui_progress_remove(resource_name);
+        gui_end();
+    }
+    jobs_unref(j);
+    free(items);
+    return status;
 }
 
 static char *actions[] = { "prepare", "setup", "build", "package", NULL };
@@ -379,53 +727,108 @@ static void configure_header(ympbuild *ymp) {
     free(uuid);
 }
 
-static void generate_links_files(const char *path) {
+// Contiguous part of the manifest, hashed by one job
+typedef struct {
+    char **paths;   // regular files in find() order, shared by all shards
+    char **hashes;  // results, same index as paths
+    size_t begin;
+    size_t end;
+    strmap *digests;
+} manifest_shard;
+
+static int manifest_shard_hash(manifest_shard *shard) {
+    for (size_t i = shard->begin; i < shard->end; i++) {
+        shard->hashes[i] = digest_lookup(shard->digests, shard->paths[i]);
+    }
+    return 0;
+}
+
+static void generate_links_files(const char *path, strmap *digests) {
     // Construct the root filesystem path by appending "/output" to the provided path
     char *rootfs = build_string("%s/output", path);
+    size_t prefix = strlen(rootfs);
 
     // Find all inodes (files and symlinks) in the root filesystem
     char **inodes = find(rootfs);
+    size_t count = 0;
+    while (inodes[count]) {
+        count++;
+    }
 
-    // Create new arrays to hold file and symlink information
-    array *files = array_new();
-    array *links = array_new();
+    // Construct paths for the output files
+    char *files_path = build_string("%s/files", path);
+    char *links_path = build_string("%s/links", path);
+    FILE *files = fopen(files_path, "w");
+    FILE *links = fopen(links_path, "w");
+    char **paths = calloc(count + 1, sizeof(char *));
+    char **hashes = calloc(count + 1, sizeof(char *));
+    if (!files || !links || !paths || !hashes) {
+        perror("Failed to write manifest");
+        goto generate_links_files_free;
+    }
 
-    // Iterate through the inodes to process each one
+    // Symlinks are written while walking, regular files are hashed later
+    size_t nfiles = 0;
     for (size_t i = 0; inodes[i]; i++) {
-        // Check if the current inode is a symlink
-        if (issymlink(inodes[i])) {
-            debug("add symlink: %s\n", inodes[i]);
-            // Add the symlink information to the links array
-            array_add(links, build_string("%s %s\n", sreadlink(inodes[i]), inodes[i] + strlen(rootfs)));
+        struct stat st;
+        if (lstat(inodes[i], &st) != 0) {
+            continue;
         }
-        // Check if the current inode is a regular file
-        else if (isfile(inodes[i])) {
+        if (S_ISLNK(st.st_mode)) {
+            debug("add symlink: %s\n", inodes[i]);
+            char *target = sreadlink(inodes[i]);
+            fprintf(links, "%s %s\n", inodes[i] + prefix, target ? target : "");
+            free(target);
+        } else if (S_ISREG(st.st_mode)) {
             debug("add file: %s\n", inodes[i]);
-            // Calculate the SHA1 hash of the file
-            char *hash = calculate_sha1(inodes[i]);
-            // Add the file hash and path to the files array
-            array_add(files, build_string("%s %s\n", hash, inodes[i] + strlen(rootfs) + 1));
-            // Free the memory allocated for the hash
-            free(hash);
-        }
-        // Free the memory allocated for the current inode
-        free(inodes[i]);
+            paths[nfiles++] = inodes[i];
+        }
     }
 
-    // Construct paths for the output files
-    char *files_path = build_string("%s/files", path);
-    char *links_path = build_string("%s/links", path);
-
-    // Write the contents of the files and links arrays to their respective files
-    writefile(files_path, array_get_string(files));
-    writefile(links_path, array_get_string(links));
+    // Hash the files in a few shards per worker, each shard fills its own slots
+    jobs *j = jobs_new();
+    size_t shard_count = (size_t) j->parallel * 4;
+    if (shard_count > nfiles) {
+        shard_count = nfiles;
+    }
+    manifest_shard *shards = calloc(shard_count + 1, sizeof(manifest_shard));
+    for (size_t i = 0; shards && i < shard_count; i++) {
+        shards[i].paths = paths;
+        shards[i].hashes = hashes;
+        shards[i].begin = nfiles * i / shard_count;
+        shards[i].end = nfiles * (i + 1) / shard_count;
+        shards[i].digests = digests;
+        int id = jobs_add(j, (callback) manifest_shard_hash, &shards[i], NULL);
+        jobs_set_class(j, id, JOBS_CLASS_CPU);
+    }
+    jobs_run(j);
+    jobs_unref(j);
+    free(shards);
+
+    // Same order as find(), whatever order the shards finished in
+    for (size_t i = 0; i < nfiles; i++) {
+        if (hashes[i]) {
+            fprintf(files, "%s %s\n", hashes[i], paths[i] + prefix + 1);
+        }
+        free(hashes[i]);
+    }
 
-    // Cleanup: free allocated memory and unreference arrays
+generate_links_files_free:
+    if (files) {
+        fclose(files);
+    }
+    if (links) {
+        fclose(links);
+    }
+    for (size_t i = 0; inodes[i]; i++) {
+        free(inodes[i]);
+    }
     free(inodes);
+    free(paths);
+    free(hashes);
     free(links_path);
     free(files_path);
-    array_unref(files);
-    array_unref(links);
+    free(rootfs);
 }
 
 static char *metadata_vars[] = { "name", "version", "description", "release", NULL };
@@ -582,6 +985,7 @@ visible char *build_source_from_path(const char *path) {
             break;  // Break if a valid hash is found
         }
         free(hashs);  // Free the hash array if not used
+        hashs = NULL;
     }
 
     // Copy the ympbuild file to the source cache
@@ -589,23 +993,170 @@ visible char *build_source_from_path(const char *path) {
     copy_file(ympfile, target);  // Copy the file to the target location
     free(target);                // Free the target path string
 
-    // Copy resources based on the source array and hash
+    // Copy or download every source at once
     char **sources = ympbuild_get_array(ymp, "source");
-    for (size_t i = 0; sources[i] && hashs[i]; i++) {
-        // Get the resource and check for success
-        if (!get_resource(path, build_string("%s-%s", name, version), hash_type, sources[i], hashs[i])) {
-            return NULL;  // Return NULL if resource retrieval fails
-        }
+    char *resource_name = build_string("%s-%s", name, version);
+    bool fetched = get_resources(path, resource_name, hash_type, sources, hashs);
+    for (size_t i = 0; sources[i]; i++) {
+        free(sources[i]);
+    }
+    free(sources);
+    for (size_t i = 0; hashs && hashs[i]; i++) {
+        free(hashs[i]);
     }
+    free(hashs);
+    free(resource_name);
 
     // Free allocated resources
+    ympbuild_release(ymp);
     free(ymp->ctx);
     free(ymp);
+    free(name);
+    free(version);
+    free(ympfile);
+    if (!fetched) {
+        free(src_cache);
+        return NULL;  // Return NULL if resource retrieval fails
+    }
 
     // Return the path of the source cache
     return src_cache;
 }
 
+static void build_cache_add_installed(array *key, char **names) {
+    for (size_t i = 0; names && names[i]; i++) {
+        Package *pkg = package_new();
+        if (package_load_from_installed(pkg, names[i])) {
+            char *line = build_string("installed: %s %s %d\n", names[i], pkg->version, pkg->release);
+            array_add(key, line);
+            free(line);
+        } else {
+            char *line = build_string("missing: %s\n", names[i]);
+            array_add(key, line);
+            free(line);
+        }
+        package_unref(pkg);
+        free(names[i]);
+    }
+    free(names);
+}
+
+// Every file of the source directory, by content. Sources with a SKIP sum
+// and local files are copied into the build like the checked ones.
+static void build_cache_add_sources(array *key, const char *path) {
+    array *lines = array_new();
+    char **files = find(path);
+    size_t skip = strlen(path);
+    for (size_t i = 0; files && files[i]; i++) {
+        char *line = NULL;
+        if (issymlink(files[i])) {
+            char *target = sreadlink(files[i]);
+            line = build_string("link: %s %s\n", files[i] + skip, target ? target : "");
+            free(target);
+        } else {
+            char *sum = calculate_sha256(files[i]);
+            line = build_string("file: %s %s\n", files[i] + skip, sum ? sum : "");
+            free(sum);
+        }
+        array_add(lines, line);
+        free(line);
+        free(files[i]);
+    }
+    free(files);
+    // find() follows the directory order, the key must not
+    array_sort(lines);
+    char *text = array_get_string(lines);
+    array_add(key, text);
+    free(text);
+    array_unref(lines);
+}
+
+// Binary cache key, everything that can change the build output is hashed
+static char *build_cache_key(ympbuild *ymp, const char *path) {
+    array *key = array_new();
+    array_add(key, ymp->ctx);
+    array_add(key, "\narch: " ARCH "\n");
+    // The header template changes between ymp versions, the configured
+    // header holds a new uuid for every build. Resources are not freed.
+    const char *header = readfile(":/ympbuild-header.sh");
+    hash_stream *h = hash_stream_new(SHA256);
+    hash_stream_update(h, header, header ? strlen(header) : 0);
+    char *header_sum = hash_stream_final(h);
+    char *line = build_string("header: %s\n", header_sum ? header_sum : "");
+    array_add(key, line);
+    free(line);
+    free(header_sum);
+    const char *vars[] = { "build:cc", "build:cxx", "build:cflags", "build:cxxflags", "build:ldflags", NULL };
+    for (size_t i = 0; vars[i]; i++) {
+        char *line = build_string("%s: %s\n", vars[i], variable_get_value(global->variables, vars[i]));
+        array_add(key, line);
+        free(line);
+    }
+    char **uses = get_uses(ymp);
+    for (size_t i = 0; uses[i]; i++) {
+        char *line = build_string("use: %s\n", uses[i]);
+        array_add(key, line);
+        free(line);
+    }
+    for (size_t t = 0; hash_types[t]; t++) {
+        char **hashs = ympbuild_get_array(ymp, hash_types[t]);
+        for (size_t i = 0; hashs[i]; i++) {
+            char *line = build_string("%s: %s\n", hash_types[t], hashs[i]);
+            array_add(key, line);
+            free(line);
+            free(hashs[i]);
+        }
+        free(hashs);
+    }
+    // Build dependencies are linked against, their installed versions matter
+    build_cache_add_installed(key, ympbuild_get_array(ymp, "makedepends"));
+    build_cache_add_installed(key, ympbuild_get_array(ymp, "depends"));
+    for (size_t i = 0; uses[i]; i++) {
+        char *name = build_string("%s_depends", uses[i]);
+        build_cache_add_installed(key, ympbuild_get_array(ymp, name));
+        free(name);
+        free(uses[i]);
+    }
+    free(uses);
+    build_cache_add_sources(key, path);
+
+    // Keep the key text next to the build for debugging
+    char *text = array_get_string(key);
+    char *key_file = build_string("%s/build-key", ymp->path);
+    writefile(key_file, text);
+    char *ret = calculate_sha256(key_file);
+    free(key_file);
+    free(text);
+    array_unref(key);
+    return ret;
+}
+
+// Restore a build directory from a cached binary package
+static bool build_cache_restore(const char *cached, const char *path) {
+    Archive *a = archive_new();
+    archive_load(a, cached);
+    archive_set_target(a, path);
+    archive_extract_all(a);
+    archive_unref(a);
+
+    char *data = build_string("%s/data.tar.gz", path);
+    char *output = build_string("%s/output", path);
+    char *metadata = build_string("%s/metadata.yaml", path);
+    bool ret = isfile(data) && isfile(metadata);
+    if (ret) {
+        create_dir(output);
+        a = archive_new();
+        archive_load(a, data);
+        archive_set_target(a, output);
+        archive_extract_all(a);
+        archive_unref(a);
+    }
+    free(data);
+    free(output);
+    free(metadata);
+    return ret;
+}
+
 visible char *build_binary_from_path(const char *path) {
     // Check if the global context is initialized
     if (!global) {
@@ -661,6 +1212,27 @@ visible char *build_binary_from_path(const char *path) {
     // Configure the header for the build
     configure_header(ymp);
 
+    // Reuse an earlier build of the same inputs
+    bool use_cache = !get_bool("no-build-cache");
+    char *build_key = use_cache ? build_cache_key(ymp, path) : NULL;
+    char *cached = build_key ? build_string("%s/binary/%s.ymp", BUILD_DIR, build_key) : NULL;
+    if (cached && isfile(cached)) {
+        if (build_cache_restore(cached, ymp->path)) {
+            print(_("Using cached build: %s\n"), cached);
+            char *ret = strdup(ymp->path);
+            free(cached);
+            free(build_key);
+            ympbuild_release(ymp);
+            free(ymp->ctx);
+            free(ymp->path);
+            free(ymp);
+            free(build_id);
+            free(ympfile);
+            return ret;
+        }
+        warning("%s: %s\n", "Invalid build cache", cached);
+    }
+
     // Find source files in the specified path
     char **src_files = find(path);
 
@@ -693,6 +1265,9 @@ visible char *build_binary_from_path(const char *path) {
         if (status != 0) {
             archive_unref(a);
             free(src_files);
+            free(cached);
+            free(build_key);
+            ympbuild_release(ymp);
             free(ymp->ctx);
             free(ymp->path);
             free(ymp);
@@ -702,20 +1277,38 @@ visible char *build_binary_from_path(const char *path) {
         }
     }
 
+    // Digests of the stripped files, reused by the manifest
+    strmap *digests = strmap_new(STRSET_LOCKED);
     // Strip binary files if needed
     if (strlen(ympbuild_get_value(ymp, "dontstrip")) == 0) {
-        binary_process(ymp->path);
+        binary_process(ymp->path, digests);
     }
 
     // Generate links and metadata files for the build
-    generate_links_files(ymp->path);
+    generate_links_files(ymp->path, digests);
+    digest_unref(digests);
     generate_metadata(ymp, false);
 
+    // Store the package, create_package() reuses its data archive later
+    if (cached) {
+        char *package = create_package(ymp->path);
+        char *binary_dir = build_string("%s/binary", BUILD_DIR);
+        create_dir(binary_dir);
+        if (!package || !move_file(package, cached)) {
+            warning("%s: %s\n", "Failed to store build cache", cached);
+        }
+        free(binary_dir);
+        free(package);
+    }
+
     // Duplicate the build path string to return
     char *ret = strdup(ymp->path);
 
     // Cleanup: free allocated resources
     archive_unref(a);
+    free(cached);
+    free(build_key);
+    ympbuild_release(ymp);
     free(ymp->ctx);
     free(ymp->path);
     free(ymp);
@@ -750,11 +1343,8 @@ visible bool build_from_path(const char *path) {
 
 visible char *create_package(const char *path) {
     print("Create package from: %s\n", path);
-    // Get the current working directory
-    char curdir[PATH_MAX];
-    if (getcwd(curdir, sizeof(curdir)) == NULL) {
-        perror("getcwd() error");
-    }
+    // Paths are built from path, the current directory is shared by every
+    // thread and stays untouched
 
     // Construct the path for the metadata file and the output package
     char *metadata_file = build_string("%s/metadata.yaml", path);
@@ -769,15 +1359,6 @@ visible char *create_package(const char *path) {
         return NULL;  // Return NULL if the file is not found
     }
 
-    // Free the metadata file path string
-    free(metadata_file);
-
-    // Change the current directory to the specified path
-    if (chdir(path) < 0) {
-        print("Failed to change directory\n");
-        return NULL;  // Return NULL if changing directory fails
-    }
-
     // Check if the metadata is valid and contains the "ymp" area
     if (!yaml_has_area(metadata, "ymp")) {
         print("Invalid metadata\n");
@@ -792,6 +1373,7 @@ visible char *create_package(const char *path) {
         Archive *a = archive_new();          // Create a new archive object
         archive_load(a, ret);                // Load the package file
         archive_set_type(a, "zip", "none");  // Set the archive type to ZIP
+        archive_set_target(a, path);         // Files are relative to path
 
         // Find all files in the specified path
         char **files = find(path);
@@ -807,42 +1389,73 @@ visible char *create_package(const char *path) {
         archive_unref(a);
         free(files);
     } else if (yaml_has_area(metadata, "package")) {
-        // Create a new archive object for packaging files
-        Archive *a = archive_new();
+        // A build restored from the binary cache already has its data archive
+        char *package_area = yaml_get_area(metadata, "package");
+        char *old_hash = yaml_get_value(package_area, "archive-hash");
+        char *archive_hash = NULL;
+        char *data_file = build_string("%s/data.tar.gz", path);
+        if (old_hash && isfile(data_file)) {
+            archive_hash = calculate_sha1(data_file);
+            if (!iseq(archive_hash, old_hash)) {
+                free(archive_hash);
+                archive_hash = NULL;
+            }
+        }
 
-        // Load the specified TAR.GZ package file into the archive object
-        archive_load(a, build_string("%s/data.tar.gz", path));
+        Archive *a = NULL;
+        if (!archive_hash) {
+            // Create a new archive object for packaging files
+            a = archive_new();
 
-        // Set the archive type to TAR with GZIP compression
-        archive_set_type(a, "tar", "gzip");
+            // Load the specified TAR.GZ package file into the archive object
+            archive_load(a, data_file);
 
-        // Change the current working directory to the 'output' directory
-        if (chdir("output") < 0) {
-            print("Failed to change directory to 'output'\n");
-            return NULL;  // Return NULL if changing the directory fails
-        }
+            // Set the archive type to TAR with GZIP compression
+            archive_set_type(a, "tar", "gzip");
 
-        // Retrieve a list of all files in the specified path
-        char **files = find(".");
+            // Files are relative to the 'output' directory
+            char *output = build_string("%s/output", path);
+            if (!isdir(output)) {
+                print("Failed to find directory 'output'\n");
+                free(output);
+                archive_unref(a);
+                return NULL;  // Return NULL if there is nothing to package
+            }
+            archive_set_target(a, output);
 
-        // Iterate through the list of files and add each one to the archive
-        for (size_t i = 0; files[i]; i++) {
-            // Add each file to the archive, adjusting the path to exclude the base directory
-            archive_add(a, files[i] + strlen(path) + 1);
-        }
+            // Retrieve a list of all files in the output directory
+            char **files = find(output);
 
-        // Create the archive with the added files
-        archive_create(a);
+            // Iterate through the list of files and add each one to the archive
+            for (size_t i = 0; files[i]; i++) {
+                // Add each file to the archive, relative to the output directory
+                archive_add(a, files[i] + strlen(output) + 1);
+            }
 
-        // Free the memory
-        free(files);
-        archive_unref(a);
+            // Create the archive with the added files
+            archive_create(a);
+
+            // Free the memory
+            free(files);
+            free(output);
+            archive_unref(a);
 
-        // Change the current working directory back to the original specified path
-        if (chdir(path) < 0) {
-            print("Failed to change directory back to '%s'\n", path);
-            return NULL;  // Return NULL if changing the directory fails
+            // Record the data archive hash, package_extract() checks it
+            archive_hash = calculate_sha1(data_file);
+            if (archive_hash && !old_hash) {
+                FILE *f = fopen(metadata_file, "a");
+                if (f) {
+                    fprintf(f, "    archive-hash: %s\n", archive_hash);
+                    fclose(f);
+                }
+            } else if (archive_hash && !iseq(old_hash, archive_hash)) {
+                warning("%s: %s\n", "Archive hash of the metadata is outdated", path);
+            }
         }
+        free(archive_hash);
+        free(package_area);
+        free(old_hash);
+        free(data_file);
 
         // Create a new archive object for the final package
         a = archive_new();
@@ -853,7 +1466,8 @@ visible char *create_package(const char *path) {
         // Set the archive type to ZIP with no compression
         archive_set_type(a, "zip", "none");
 
-        // Add necessary files to the ZIP archive
+        // Add necessary files to the ZIP archive, relative to path
+        archive_set_target(a, path);
         archive_add(a, "metadata.yaml");  // Add metadata file
         archive_add(a, "files");          // Add directory containing files
         archive_add(a, "links");          // Add directory containing links
@@ -865,12 +1479,7 @@ visible char *create_package(const char *path) {
         // Free the archive object after use
         archive_unref(a);
     }
-
-    // Change back to the original directory
-    if (chdir(curdir) < 0) {
-        print("Failed to change directory\n");
-        return NULL;  // Return NULL if changing back fails
-    }
+    free(metadata_file);
 
     // Return the path of the created package
     return ret;
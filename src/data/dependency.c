@@ -1,8 +1,10 @@
 #include <config.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 #include <core/logger.h>
+#include <core/trace.h>
 #include <core/variable.h>
 #include <core/ymp.h>
 #include <data/repository.h>
@@ -10,6 +12,7 @@
 #include <utils/file.h>
 #include <utils/process.h>
 #include <utils/string.h>
+#include <utils/strset.h>
 
 static Package **resolved;
 static size_t resolved_count = 0;
@@ -17,60 +20,91 @@ static size_t resolved_total = 0;
 
 // Global variables for repositories, resolved dependencies, and cache
 static Repository **repos;
-static array *cache;
+static strset *cache;
+static strpool *names; // interned package names, released by resolve_end
 size_t depth = 0;  // Variable to track the depth of dependency resolution
 
+// Check whether a package group belongs to the requested group name
+static bool group_match(const char *name, const char *grp) {
+    size_t l1 = strlen(name) - 1;
+    size_t l2 = strlen(grp);
+    if (l2 < l1) {
+        // len(grp) < len(name)
+        return false;
+    } else if (l1 == l2 && strncmp(grp, name + 1, l1) == 0) {
+        // len(grp) == len(name)
+        debug("grp: %s\n", grp);
+        return true;
+    } else if (strncmp(grp, name + 1, l1) == 0 && grp[l1] == '.') {
+        // len(grp) > len(name) and grp[len(name)] == '.'
+        debug("name: %s grp: %s l1:%ld l2:%ld\n", name, grp, l1, l2);
+        return true;
+    }
+    return false;
+}
+
+// Scan the group columns of a compact table, each group string is compared once
+static void get_group_packages_table(Repository *repo, const char *name, array *res) {
+    RepositoryTable *table = repo->table;
+    uint8_t *state = calloc(table->string_count, sizeof(uint8_t));  // 0 unknown, 1 match, 2 no match
+    if (!state) {
+        return;
+    }
+    for (size_t row = 0; row < table->length; row++) {
+        for (size_t e = table->groups_index[row]; e < table->groups_index[row + 1]; e++) {
+            uint32_t id = table->groups[e];
+            if (state[id] == 0) {
+                state[id] = group_match(name, table->strings[id]) ? 1 : 2;
+            }
+            if (state[id] == 1) {
+                array_add(res, table->strings[table->name[row]]);
+            }
+        }
+    }
+    free(state);
+}
+
 visible char **get_group_packages(const char *name) {
     info("Resolving group: %s depth:%d\n", name, depth);
     array *res = array_new();
     Package *pi = package_new();
     pi->is_virtual = true;
     for (size_t i = 0; repos[i]; i++) {
+        if (strcmp(name + 1, "universe") != 0 && strcmp(name + 1, "world") != 0 && repos[i]->table) {
+            get_group_packages_table(repos[i], name, res);
+            continue;
+        }
         for (size_t j = 0; j < repos[i]->package_count; j++) {
+            const char *pkgname = repository_name_at(repos[i], j);
             if (strcmp(name + 1, "universe") == 0) {
-                array_add(res, repos[i]->packages[j]->name);
+                array_add(res, pkgname);
             } else if (strcmp(name + 1, "world") == 0) {
-                pi->name = repos[i]->packages[j]->name;
+                pi->name = pkgname;
                 if (package_is_installed(pi)) {
-                    array_add(res, repos[i]->packages[j]->name);
+                    array_add(res, pkgname);
                 }
             } else {
-                for (size_t g = 0; repos[i]->packages[j]->groups[g]; g++) {
-                    const char *grp = repos[i]->packages[j]->groups[g];
-                    size_t l1 = strlen(name) - 1;
-                    size_t l2 = strlen(grp);
-                    if (l2 < l1) {
-                        // len(grp) < len(name)
-                        continue;
-                    } else if (l1 == l2 && strncmp(grp, name + 1, l1) == 0) {
-                        // len(grp) == len(name)
-                        debug("grp: %s\n", grp);
-                        array_add(res, repos[i]->packages[j]->name);
-                    } else if (strncmp(grp, name + 1, l1) == 0 && grp[l1] == '.') {
-                        // len(grp) > len(name) and grp[len(name)] == '.'
-                        array_add(res, repos[i]->packages[j]->name);
-                        debug("name: %s grp: %s l1:%ld l2:%ld\n", name, grp, l1, l2);
+                char **groups = repos[i]->packages[j]->groups;
+                for (size_t g = 0; groups && groups[g]; g++) {
+                    if (group_match(name, groups[g])) {
+                        array_add(res, pkgname);
                     }
                 }
             }
         }
     }
-    size_t len;
-    char **ret = array_get(res, &len);
-    array_unref(res);
-    return ret;
+    pi->name = NULL;
+    package_unref(pi);
+    return array_steal(res, NULL);
 }
 
 // Recursive function to resolve dependencies for a given package name
 static void resolve_dependency_fn(char *name, bool emerge) {
-    // If the package is already in the cache, return to avoid reprocessing
-    if (array_has(cache, name)) {
+    // Add the package to the cache, return if it was already processed
+    if (!strset_add(cache, name)) {
         return;
     }
 
-    // Add the package to the cache to avoid reprocessing in the future
-    array_add(cache, name);
-
     // Log the current package being searched and the depth level
     info("Search: %s depth:%d\n", name, depth);
 
@@ -78,7 +112,9 @@ static void resolve_dependency_fn(char *name, bool emerge) {
         char **grp_pkgs = get_group_packages(name);
         for (size_t i = 0; grp_pkgs[i]; i++) {
             resolve_dependency_fn(grp_pkgs[i], emerge);
+            free(grp_pkgs[i]);
         }
+        free(grp_pkgs);
         return;
     }
 
@@ -115,14 +151,11 @@ static void resolve_dependency_fn(char *name, bool emerge) {
 
 // Recursive function to resolve dependencies for a given package name
 static void resolve_reverse_dependency_fn(char *name) {
-    // If the package is already in the cache, return to avoid reprocessing
-    if (array_has(cache, name)) {
+    // Add the package to the cache, return if it was already processed
+    if (!strset_add(cache, name)) {
         return;
     }
 
-    // Add the package to the cache to avoid reprocessing in the future
-    array_add(cache, name);
-
     // Log the current package being searched and the depth level
     info("Search: %s depth:%d\n", name, depth);
 
@@ -183,9 +216,10 @@ visible char **resolve_upgrade(Repository **repos) {
     char *metadata_dir = build_string("%s/%s/metadata", get_value("DESTDIR"), STORAGE);
     char **packages = listdir(metadata_dir);
     array *need_upgrade = array_new();
+    strset *seen = strset_new(0);
     for (size_t i = 0; repos[i]; i++) {
         for (size_t j = 0; packages[j]; j++) {
-            if (array_has(need_upgrade, packages[j])) {
+            if (strset_has(seen, packages[j])) {
                 continue;
             }
             // remove suffix
@@ -201,6 +235,7 @@ visible char **resolve_upgrade(Repository **repos) {
             }
             if (!package_is_installed(p)) {  // check upgrade
                 info("%s is need upgrade\n", packages[j]);
+                strset_add(seen, p->name);
                 array_add(need_upgrade, p->name);
             }
         }
@@ -209,9 +244,8 @@ visible char **resolve_upgrade(Repository **repos) {
         free(packages[j]);
     }
     free(packages);
-    char **ret = array_get(need_upgrade, NULL);
-    array_unref(need_upgrade);
-    return ret;
+    strset_unref(seen);
+    return array_steal(need_upgrade, NULL);
 }
 
 // Function to initialize the resolution process
@@ -221,6 +255,7 @@ visible Repository **resolve_begin() {
         return repos;
     }
 
+    trace_begin("index load", NULL);
     // Build the path to the repository index
     char *repodir = build_string("%s/%s/index", get_value("DESTDIR"), STORAGE);
     char **dirs = listdir(repodir);  // List the directories in the repository
@@ -240,10 +275,11 @@ visible Repository **resolve_begin() {
         warning("%s\n", "Repository list is empty!");
         free(dirs);
         free(repodir);
+        trace_end();
         return NULL;
     }
     // Allocate memory for the repository pointers
-    repos = calloc(j, sizeof(Repository *));
+    repos = calloc(j + 1, sizeof(Repository *));  // NULL terminated
     i = 0;
     j = 0;
     // Load each repository from the index
@@ -263,6 +299,7 @@ visible Repository **resolve_begin() {
     // Free the directory list and the repository directory string
     free(dirs);
     free(repodir);
+    trace_end();
     return repos;
 }
 
@@ -271,12 +308,8 @@ visible void resolve_end(Repository **frepos) {
     if (frepos == NULL) {
         return;
     }
-    // Unreference and free each repository
-    for (size_t i = 0; frepos[i]; i++) {
-        repository_unref(frepos[i]);
-    }
-    free(frepos);  // Free the repository pointer array
     // Free packages not owned by any repository (created by resolve_reverse_dependency_fn)
+    // before the repositories, which own the memory of the others
     if (resolved) {
         for (size_t i = 0; i < resolved_count; i++) {
             if (resolved[i] && resolved[i]->repo == NULL) {
@@ -286,9 +319,34 @@ visible void resolve_end(Repository **frepos) {
         free(resolved);  // Free the resolved dependencies array
         resolved = NULL;
     }
+    // Unreference and free each repository
+    for (size_t i = 0; frepos[i]; i++) {
+        repository_unref(frepos[i]);
+    }
+    free(frepos);  // Free the repository pointer array
+    if (frepos == repos) {
+        repos = NULL;
+    }
     resolved_count = 0;
-    array_unref(cache);  // Unreference the cache array
+    strset_unref(cache);  // Unreference the cache set
     cache = NULL;
+    strpool_unref(names);  // Release every name interned while resolving
+    names = NULL;
+}
+
+// Reset the resolved list and the cache before a new resolve
+static void resolve_reset() {
+    if (resolved != NULL) {
+        free(resolved);
+    }
+    resolved = calloc(1024, sizeof(Package *));  // Create a new array for resolved packages
+    resolved_count = 0;                          // reset resolve count
+    resolved_total = 0;                          // reset resolve total
+    if (names == NULL) {
+        names = strpool_new();  // Resolver lifetime string storage
+    }
+    strset_unref(cache);                // Drop the cache of a previous resolve
+    cache = strmap_new_pool(0, names);  // Create a new set for caching resolved packages
 }
 
 // Public function to resolve dependencies for a given package name
@@ -298,15 +356,11 @@ visible Package **resolve_dependency(char *name) {
         print(_("Failed to resolve dependencies\n"));
         return NULL;  // Dont resolve package if repository list is empty
     }
-    if (resolved != NULL) {
-        free(resolved);
-    }
-    resolved = calloc(1024, sizeof(Package *));  // Create a new array for resolved packages
-    resolved_count = 0;                          // reset resolve count
-    resolved_total = 0;                          // reset resolve total
-    cache = array_new();                         // Create a new array for caching resolved packages
+    resolve_reset();
 
+    trace_begin("resolve", "%s", name);
     resolve_dependency_fn(name, !get_bool("no-emerge"));  // Resolve dependencies recursively
+    trace_end();
     resolved[resolved_count] = NULL;                      // NULL terminate the resolved list
     info("Dependencies resolved in %d µs\n", get_epoch() - begin_time);
     return resolved;  // Return the array of resolved dependencies
@@ -315,13 +369,7 @@ visible Package **resolve_dependency(char *name) {
 // Public function to resolve reverse dependencies for a given package name
 visible Package **resolve_reverse_dependency(char *name) {
     size_t begin_time = get_epoch();
-    if (resolved != NULL) {
-        free(resolved);
-    }
-    resolved = calloc(1024, sizeof(Package *));  // Create a new array for resolved packages
-    resolved_count = 0;                          // reset resolve count
-    resolved_total = 0;                          // reset resolve total
-    cache = array_new();                         // Create a new array for caching resolved packages
+    resolve_reset();
     info("Reverse dependencies resolved in %d µs\n", get_epoch() - begin_time);
     resolve_reverse_dependency_fn(name);
     resolved[resolved_count] = NULL;
@@ -5,6 +5,7 @@
 #include <string.h>
 
 #include <core/logger.h>
+#include <core/trace.h>
 #include <core/variable.h>
 #include <core/ymp.h>
 #include <data/build.h>
@@ -29,41 +30,80 @@ visible Package *package_new() {
     return pkg;
 }
 
-visible void package_unref(Package *pkg) {
-    if (pkg->archive) {
-        archive_unref(pkg->archive);
+visible Package *package_new_arena(arena *a) {
+    Package *pkg = arena_calloc(a, 1, sizeof(Package));
+    if (!pkg) {
+        return NULL;
     }
-    if (pkg->name) {
-        free((char *) pkg->name);
+    // Archive is created by package_load_from_file when needed
+    pkg->owner = a;
+    pkg->is_virtual = false;
+    return pkg;
+}
+
+// Move a heap string into the package arena
+static char *package_keep(Package *pkg, char *str) {
+    if (!pkg->owner || !str) {
+        return str;
     }
-    if (pkg->version) {
-        free((char *) pkg->version);
+    char *ret = arena_strdup(pkg->owner, str);
+    free(str);
+    return ret;
+}
+
+// Move a heap string vector into the package arena
+static char **package_keep_array(Package *pkg, char **items) {
+    if (!pkg->owner || !items) {
+        return items;
     }
-    if (pkg->metadata) {
-        free((char *) pkg->metadata);
+    size_t count = 0;
+    while (items[count]) {
+        count++;
     }
-    if (pkg->files) {
-        free((char *) pkg->files);
+    char **ret = arena_calloc(pkg->owner, count + 1, sizeof(char *));
+    for (size_t i = 0; i < count; i++) {
+        if (ret) {
+            ret[i] = arena_strdup(pkg->owner, items[i]);
+        }
+        free(items[i]);
     }
-    if (pkg->links) {
-        free((char *) pkg->links);
+    free(items);
+    return ret;
+}
+
+// Free a field unless it lives in the package arena
+static void package_free(Package *pkg, const void *ptr) {
+    if (ptr && !arena_owns(pkg->owner, ptr)) {
+        free((void *) ptr);
     }
-    if (pkg->path) {
-        free((char *) pkg->path);
+}
+
+static void package_free_array(Package *pkg, char **items) {
+    if (!items || arena_owns(pkg->owner, items)) {
+        return;
     }
-    if (pkg->dependencies) {
-        for (size_t i = 0; pkg->dependencies[i]; i++) {
-            free(pkg->dependencies[i]);
-        }
-        free(pkg->dependencies);
+    for (size_t i = 0; items[i]; i++) {
+        free(items[i]);
     }
-    if (pkg->groups) {
-        for (size_t i = 0; pkg->groups[i]; i++) {
-            free(pkg->groups[i]);
-        }
-        free(pkg->groups);
+    free(items);
+}
+
+visible void package_unref(Package *pkg) {
+    if (pkg->archive) {
+        archive_unref(pkg->archive);
+    }
+    package_free(pkg, pkg->name);
+    package_free(pkg, pkg->version);
+    package_free(pkg, pkg->metadata);
+    package_free(pkg, pkg->files);
+    package_free(pkg, pkg->links);
+    package_free(pkg, pkg->path);
+    package_free_array(pkg, pkg->dependencies);
+    package_free_array(pkg, pkg->groups);
+    // Arena packages are released with their arena
+    if (!pkg->owner) {
+        free(pkg);
     }
-    free(pkg);
 }
 
 visible bool package_load_from_file(Package *pkg, const char *path) {
@@ -78,6 +118,9 @@ visible bool package_load_from_file(Package *pkg, const char *path) {
     }
 
     // 1. Load the archive from the specified file path
+    if (!pkg->archive) {
+        pkg->archive = archive_new();
+    }
     archive_load(pkg->archive, path);
 
     // Read the metadata from the archive
@@ -137,19 +180,20 @@ visible bool package_load_from_metadata(Package *pkg, const char *metadata, bool
     }
 
     // Read the package information from the archive
-    pkg->name = yaml_get_value(pkg->metadata, "name");
-    pkg->version = yaml_get_value(pkg->metadata, "version");
+    pkg->name = package_keep(pkg, yaml_get_value(pkg->metadata, "name"));
+    pkg->version = package_keep(pkg, yaml_get_value(pkg->metadata, "version"));
     pkg->release = 1;
-    const char *rel = yaml_get_value(pkg->metadata, "release");
+    char *rel = yaml_get_value(pkg->metadata, "release");
     if (rel == NULL) {
         pkg->release = 0;
     } else if (strlen(rel) > 0) {
         pkg->release = atoi(rel);
     }
+    free(rel);
     int dep_count = 0;
     int grp_count = 0;
-    pkg->dependencies = yaml_get_array(pkg->metadata, "depends", &dep_count);
-    pkg->groups = yaml_get_array(pkg->metadata, "group", &grp_count);
+    pkg->dependencies = package_keep_array(pkg, yaml_get_array(pkg->metadata, "depends", &dep_count));
+    pkg->groups = package_keep_array(pkg, yaml_get_array(pkg->metadata, "group", &grp_count));
     debug("package:%s - %s - %d - %d\n", pkg->name, pkg->version, dep_count, grp_count);
     return true;
 }
@@ -202,7 +246,7 @@ static bool package_import_from_build(Package *pkg, const char *path) {
 }
 
 // Function to extract a package
-visible bool package_extract(Package *pkg) {
+static bool package_extract_fn(Package *pkg) {
     // Check if the package pointer is NULL
     if (!pkg) {
         warning("%s\n", "Invalid package!");
@@ -240,7 +284,9 @@ visible bool package_extract(Package *pkg) {
         archive_set_target(pkg->archive, cache);
         archive_extract_all(pkg->archive);
         // Build source package
+        trace_begin("emerge", "%s", pkg->name);
         const char *build = build_binary_from_path(cache);
+        trace_end();
         if (build) {
             return package_import_from_build(pkg, build);
         } else {
@@ -289,7 +335,7 @@ visible bool package_extract(Package *pkg) {
             char *yaml_hash = yaml_get_value(pkg->metadata, "archive-hash");
 
             // Compare the calculated hash with the expected hash
-            if (!iseq(hash, yaml_hash)) {
+            if (!hash || !yaml_hash || !iseq(hash, yaml_hash)) {
                 warning("%s Excepted %s <> Received %s\n", "Package archive hash is wrong!", hash, yaml_hash);
                 free(hash);
                 free(yaml_hash);
@@ -340,6 +386,13 @@ visible bool package_extract(Package *pkg) {
     return true;  // Return true if extraction was successful
 }
 
+visible bool package_extract(Package *pkg) {
+    trace_begin("extract", "%s", pkg ? pkg->name : "");
+    bool status = package_extract_fn(pkg);
+    trace_end();
+    return status;
+}
+
 visible bool package_load_from_installed(Package *pkg, const char *name) {
     // build strings
     char *destdir = variable_get_value(global->variables, "DESTDIR");
@@ -4,6 +4,8 @@
 #include <stdlib.h>
 
 #include <core/logger.h>
+#include <core/stats.h>
+#include <core/trace.h>
 #include <core/variable.h>
 #include <core/ymp.h>
 #include <data/quarantine.h>
@@ -12,6 +14,7 @@
 #include <utils/hash.h>
 #include <utils/jobs.h>
 #include <utils/string.h>
+#include <utils/strset.h>
 #include <utils/yaml.h>
 
 // Function to validate metadata
@@ -221,7 +224,7 @@ free_quarantine_validate_links:
 }
 
 // Function to sync quarantine validated files
-visible int quarantine_sync(const char *name) {
+static int quarantine_sync_fn(const char *name) {
     print(_("Syncing: %s\n"), name);
     int status = 0;
     // Get the destination directory from global variables
@@ -280,6 +283,7 @@ visible int quarantine_sync(const char *name) {
             status = stat;
             goto free_quarantine_sync;
         }
+        stats_add(STATS_FILES_SYNCED, 1);
     }
 
     // Read each line from the links
@@ -309,6 +313,7 @@ visible int quarantine_sync(const char *name) {
             warning("failed to sync: %s => %s\n", target, line + offset + 1);
             goto free_quarantine_sync;
         }
+        stats_add(STATS_FILES_SYNCED, 1);
     }
 
     // Move files
@@ -328,7 +333,7 @@ visible int quarantine_sync(const char *name) {
     }
 
     // Move files
-    sprintf(target, "%s/%s/metadate/%s.yaml", destdir, STORAGE, name);
+    sprintf(target, "%s/%s/metadata/%s.yaml", destdir, STORAGE, name);
     stat = !move_file(metadata_path, target);
     if (stat) {
         warning("failed to sync: %s\n", metadata_path);
@@ -351,7 +356,7 @@ free_quarantine_sync_no_fclose:
 
 static void calculate_leftovers(array *arr, const char *name) {
     char *destdir = variable_get_value(global->variables, "DESTDIR");
-    array *list = array_new();
+    strset *list = strset_new(0);
     char *files = build_string("%s/%s/files/%s", destdir, STORAGE, name);
     char *links = build_string("%s/%s/links/%s", destdir, STORAGE, name);
     char *files_new = build_string("%s/%s/quarantine/files/%s", destdir, STORAGE, name);
@@ -362,7 +367,7 @@ static void calculate_leftovers(array *arr, const char *name) {
     FILE *ffiles = fopen(files, "r");
     if (ffiles) {
         while (fgets(line, sizeof(line), ffiles)) {
-            array_add(list, line + 41);
+            strset_add(list, line + 41);
         }
         fclose(ffiles);
     }
@@ -374,7 +379,7 @@ static void calculate_leftovers(array *arr, const char *name) {
             for (offset = 0; line[offset] && line[offset] != ' '; offset++)
                 ;
             line[offset] = '\n';
-            array_add(list, line);
+            strset_add(list, line);
         }
         fclose(flinks);
     }
@@ -382,7 +387,7 @@ static void calculate_leftovers(array *arr, const char *name) {
     FILE *ffiles_new = fopen(files_new, "r");
     if (ffiles_new) {
         while (fgets(line, sizeof(line), ffiles_new)) {
-            array_remove(list, line + 41);
+            strset_remove(list, line + 41);
         }
         fclose(ffiles_new);
     }
@@ -394,19 +399,29 @@ static void calculate_leftovers(array *arr, const char *name) {
             for (offset = 0; line[offset] && line[offset] != ' '; offset++)
                 ;
             line[offset] = '\n';
-            array_remove(list, line);
+            strset_remove(list, line);
         }
         fclose(flinks_new);
     }
     // add leftovers
-    size_t len;
-    array_adds(arr, array_get(list, &len));
+    const char **left = strset_get(list, NULL);
+    for (size_t i = 0; left[i]; i++) {
+        array_add(arr, left[i]);
+    }
+    free(left);
     // free memory
     free(files);
     free(links);
     free(files_new);
     free(links_new);
-    array_unref(list);
+    strset_unref(list);
+}
+
+visible int quarantine_sync(const char *name) {
+    trace_begin("sync", "%s", name);
+    int status = quarantine_sync_fn(name);
+    trace_end();
+    return status;
 }
 
 // Function to validate all quarantine metadata files
@@ -432,13 +447,16 @@ visible bool quarantine_validate() {
             metadatas[i][strlen(metadatas[i]) - 5] = '\0';
             // Add a job to validate the corresponding files
             jobs_add(j, (callback) quarantine_validate_metadata, basename(metadatas[i]), NULL);
-            jobs_add(j, (callback) quarantine_validate_files, basename(metadatas[i]), NULL);
+            int files = jobs_add(j, (callback) quarantine_validate_files, basename(metadatas[i]), NULL);
             jobs_add(j, (callback) quarantine_validate_links, basename(metadatas[i]), NULL);
+            jobs_set_class(j, files, JOBS_CLASS_CPU);
         }
     }
 
     // Run the jobs and check for failures
+    trace_begin("validate", NULL);
     jobs_run(j);
+    trace_end();
     bool status = j->failed;  // Capture the failure status
     jobs_unref(j);            // Unreference the job queue
 
@@ -451,7 +469,8 @@ visible bool quarantine_validate() {
         // Iterate through each metadata file
         for (size_t i = 0; metadatas[i]; i++) {
             calculate_leftovers(leftover, basename(metadatas[i]));
-            jobs_add(j, (callback) quarantine_sync, basename(metadatas[i]), NULL);
+            int sync = jobs_add(j, (callback) quarantine_sync, basename(metadatas[i]), NULL);
+            jobs_set_class(j, sync, JOBS_CLASS_IO);
         }
         // Run the jobs and check for failures
         jobs_run(j);
@@ -465,7 +484,9 @@ visible bool quarantine_validate() {
     char target[PATH_MAX];
     for (size_t i = 0; i < len; i++) {
         sprintf(target, "%s/%s", destdir, left[i]);
-        unlink(target);
+        if (unlink(target) == 0) {
+            stats_add(STATS_FILES_REMOVED, 1);
+        }
         free(left[i]);
     }
     free(left);
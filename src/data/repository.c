@@ -1,21 +1,223 @@
 #include <config.h>
 #include <libgen.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include <core/logger.h>
+#include <core/trace.h>
 #include <core/variable.h>
 #include <core/ymp.h>
 #include <data/package.h>
 #include <data/repository.h>
+#include <utils/arena.h>
 #include <utils/color.h>
 #include <utils/fetcher.h>
 #include <utils/file.h>
 #include <utils/string.h>
+#include <utils/strset.h>
 #include <utils/yaml.h>
 
+typedef struct {
+    strmap *binary; // package name -> row + 1, keys borrowed from the arena
+    strmap *source;
+    arena *store;   // index loaded packages and their strings
+    strmap *ids;    // table string -> id + 1
+    size_t rows;    // allocated table rows
+    size_t strings; // allocated string ids
+    size_t depends; // allocated dependency edges
+    size_t groups;  // allocated group edges
+} RepositoryPriv;
+
+// Map values store an index + 1 so NULL still means missing
+#define TO_PTR(i) ((void *) ((uintptr_t) (i) + 1))
+#define FROM_PTR(p) ((size_t) ((uintptr_t) (p) - 1))
+
+// Grow a table column to hold `need` items
+static bool table_grow(void **column, size_t *capacity, size_t need, size_t size) {
+    if (need <= *capacity) {
+        return true;
+    }
+    size_t new_capacity = *capacity ? *capacity : 64;
+    while (new_capacity < need) {
+        new_capacity *= 2;
+    }
+    void *tmp = realloc(*column, new_capacity * size);
+    if (!tmp) {
+        return false;
+    }
+    *column = tmp;
+    *capacity = new_capacity;
+    return true;
+}
+
+// Get the id of a string in the table string list
+static uint32_t table_intern(Repository *repo, const char *str) {
+    RepositoryPriv *priv = repo->priv_data;
+    RepositoryTable *table = repo->table;
+    void *id = strmap_get(priv->ids, str);
+    if (id) {
+        return (uint32_t) FROM_PTR(id);
+    }
+    size_t strings = priv->strings;
+    if (!table_grow((void **) &table->strings, &strings, table->string_count + 1, sizeof(char *))) {
+        return 0;
+    }
+    priv->strings = strings;
+    const char *copy = arena_strdup(priv->store, str);
+    table->strings[table->string_count] = copy;
+    strmap_set(priv->ids, copy, TO_PTR(table->string_count));
+    return (uint32_t) table->string_count++;
+}
+
+// Append the items of a vector to a CSR edge column
+static void table_add_edges(Repository *repo, char **items, uint32_t **edges, size_t *capacity, size_t *index, size_t row) {
+    size_t begin = index[row];
+    size_t count = 0;
+    for (count = 0; items && items[count]; count++)
+        ;
+    if (table_grow((void **) edges, capacity, begin + count, sizeof(uint32_t))) {
+        for (size_t i = 0; i < count; i++) {
+            (*edges)[begin + i] = table_intern(repo, items[i]);
+        }
+    } else {
+        count = 0;
+    }
+    index[row + 1] = begin + count;
+    for (size_t i = 0; items && items[i]; i++) {
+        free(items[i]);
+    }
+    free(items);
+}
+
+static RepositoryTable *table_new() {
+    RepositoryTable *table = calloc(1, sizeof(RepositoryTable));
+    if (!table) {
+        return NULL;
+    }
+    // CSR offsets have one more entry than rows
+    table->depends_index = calloc(1, sizeof(size_t));
+    table->groups_index = calloc(1, sizeof(size_t));
+    return table;
+}
+
+static void table_unref(RepositoryTable *table) {
+    if (!table) {
+        return;
+    }
+    free(table->name);
+    free(table->version);
+    free(table->release);
+    free(table->flags);
+    free(table->metadata);
+    free(table->depends_index);
+    free(table->depends);
+    free(table->groups_index);
+    free(table->groups);
+    free(table->strings);
+    free(table);
+}
+
+// Make room for `need` rows in every row column
+static bool table_reserve(Repository *repo, size_t need) {
+    RepositoryPriv *priv = repo->priv_data;
+    RepositoryTable *table = repo->table;
+    if (need <= priv->rows) {
+        return true;
+    }
+    size_t rows = priv->rows ? priv->rows : 64;
+    while (rows < need) {
+        rows *= 2;
+    }
+    void *name = realloc(table->name, rows * sizeof(uint32_t));
+    if (name) {
+        table->name = name;
+    }
+    void *version = realloc(table->version, rows * sizeof(uint32_t));
+    if (version) {
+        table->version = version;
+    }
+    void *release = realloc(table->release, rows * sizeof(int));
+    if (release) {
+        table->release = release;
+    }
+    void *flags = realloc(table->flags, rows * sizeof(uint8_t));
+    if (flags) {
+        table->flags = flags;
+    }
+    void *metadata = realloc(table->metadata, rows * sizeof(char *));
+    if (metadata) {
+        table->metadata = metadata;
+    }
+    // CSR offsets have one more entry than rows
+    void *depends_index = realloc(table->depends_index, (rows + 1) * sizeof(size_t));
+    if (depends_index) {
+        table->depends_index = depends_index;
+    }
+    void *groups_index = realloc(table->groups_index, (rows + 1) * sizeof(size_t));
+    if (groups_index) {
+        table->groups_index = groups_index;
+    }
+    if (!name || !version || !release || !flags || !metadata || !depends_index || !groups_index) {
+        print(_("memory allocation failed"));
+        return false;
+    }
+    priv->rows = rows;
+    return true;
+}
+
+// Load one index area into a new table row
+static bool table_add_row(Repository *repo, char *area, bool is_source) {
+    RepositoryPriv *priv = repo->priv_data;
+    RepositoryTable *table = repo->table;
+    size_t row = table->length;
+    if (!table_reserve(repo, row + 1)) {
+        free(area);
+        return false;
+    }
+
+    char *name = yaml_get_value(area, "name");
+    char *version = yaml_get_value(area, "version");
+    char *rel = yaml_get_value(area, "release");
+    char **depends = yaml_get_array(area, "depends", NULL);
+    char **groups = yaml_get_array(area, "group", NULL);
+    table->name[row] = table_intern(repo, name ? name : "");
+    table->version[row] = table_intern(repo, version ? version : "");
+    table->release[row] = 1;
+    if (rel == NULL) {
+        table->release[row] = 0;
+    } else if (strlen(rel) > 0) {
+        table->release[row] = atoi(rel);
+    }
+    table->flags[row] = (is_source ? REPOSITORY_SOURCE : 0) | (name ? REPOSITORY_HAS_NAME : 0) |
+                        (depends ? REPOSITORY_HAS_DEPENDS : 0) | (groups ? REPOSITORY_HAS_GROUPS : 0);
+    table->metadata[row] = arena_strdup(priv->store, area);
+    table_add_edges(repo, depends, &table->depends, &priv->depends, table->depends_index, row);
+    table_add_edges(repo, groups, &table->groups, &priv->groups, table->groups_index, row);
+    table->length++;
+    free(name);
+    free(version);
+    free(rel);
+    free(area);
+    return true;
+}
+
+// Build a vector of table strings for a CSR row
+static char **table_strings(Repository *repo, const uint32_t *edges, const size_t *index, size_t row) {
+    RepositoryPriv *priv = repo->priv_data;
+    size_t count = index[row + 1] - index[row];
+    char **ret = arena_calloc(priv->store, count + 1, sizeof(char *));
+    if (!ret) {
+        return NULL;
+    }
+    for (size_t i = 0; i < count; i++) {
+        ret[i] = (char *) repo->table->strings[edges[index[row] + i]];
+    }
+    return ret;
+}
+
 visible Repository *repository_new() {
     Repository *repo = (Repository *) calloc(1, sizeof(Repository));
     if (!repo) {
@@ -28,6 +230,17 @@ visible Repository *repository_new() {
         color_print(BOLD, COLOR_RED, "Memory initial allocation failed\n");
         return NULL;  // Handle memory allocation failure
     }
+    RepositoryPriv *priv = calloc(1, sizeof(RepositoryPriv));
+    if (!priv) {
+        free(repo->packages);
+        free(repo);
+        return NULL;
+    }
+    priv->binary = strmap_new(STRSET_BORROW);
+    priv->source = strmap_new(STRSET_BORROW);
+    priv->store = arena_new(0);
+    priv->ids = strmap_new(STRSET_BORROW);
+    repo->priv_data = priv;
     return repo;
 }
 
@@ -35,8 +248,11 @@ visible void repository_unref(Repository *repo) {
     if (!repo) {
         return;  // Check for NULL
     }
+    // Only frees what was loaded later from package files, the rest goes with the arena
     for (size_t i = 0; i < repo->package_count; i++) {
-        package_unref(repo->packages[i]);
+        if (repo->packages[i]) {
+            package_unref(repo->packages[i]);
+        }
     }
     if (repo->packages) {
         free(repo->packages);
@@ -47,6 +263,13 @@ visible void repository_unref(Repository *repo) {
     if (repo->uri) {
         free((char *) repo->uri);
     }
+    RepositoryPriv *priv = repo->priv_data;
+    strmap_unref(priv->binary);
+    strmap_unref(priv->source);
+    strmap_unref(priv->ids);
+    table_unref(repo->table);
+    arena_unref(priv->store);
+    free(priv);
     free(repo);
 }
 
@@ -78,44 +301,139 @@ static void repository_load_data(Repository *repo, const char *data, bool is_sou
     }
 
     // Load packages
+    RepositoryPriv *priv = repo->priv_data;
+    strmap *index = is_source ? priv->source : priv->binary;
+    if (repo->table) {
+        // Compact mode, packages are materialized by repository_package_at
+        table_reserve(repo, repo->table->length + len);
+        for (int i = 0; i < len && areas[i]; i++) {
+            if (!table_add_row(repo, areas[i], is_source)) {
+                print(_("Failed to create new package\n"));
+                continue;
+            }
+            size_t row = repo->table->length - 1;
+            repo->packages[repo->package_count] = NULL;
+            const char *name = repo->table->strings[repo->table->name[row]];
+            // First entry wins like the linear lookup did
+            if ((repo->table->flags[row] & REPOSITORY_HAS_NAME) && !strmap_has(index, name)) {
+                strmap_set(index, name, TO_PTR(repo->package_count));
+            }
+            repo->package_count++;
+        }
+        free(areas);
+        return;
+    }
     for (int i = 0; i < len && areas[i]; i++) {
-        repo->packages[repo->package_count] = package_new();
-        repo->packages[repo->package_count]->is_virtual = true;
-        repo->packages[repo->package_count]->repo = (void *) repo;
-        if (repo->packages[repo->package_count] == NULL) {
+        Package *p = package_new_arena(priv->store);
+        if (p == NULL) {
             print(_("Failed to create new package\n"));
+            free(areas[i]);
             continue;
         }
-        package_load_from_metadata(repo->packages[repo->package_count], areas[i], is_source);
+        p->is_virtual = true;
+        p->repo = (void *) repo;
+        char *metadata = arena_strdup(priv->store, areas[i]);
+        free(areas[i]);
+        repo->packages[repo->package_count] = p;
+        package_load_from_metadata(p, metadata, is_source);
+        // First entry wins like the linear lookup did
+        if (p->name && !strmap_has(index, p->name)) {
+            strmap_set(index, p->name, TO_PTR(repo->package_count));
+        }
         repo->package_count++;
     }
+    free(areas);
 }
 
 visible Package *repository_get(Repository *repo, const char *name, bool is_source) {
     if (repo == NULL) {
         return NULL;
     }
-    for (size_t i = 0; i < repo->package_count; i++) {
-        if (repo->packages[i]->is_source != is_source) {
-            continue;
-        }
-        if (strcmp(repo->packages[i]->name, name) == 0) {
-            debug("Found package: %s\n", name);
-            return repo->packages[i];
-        }
+    RepositoryPriv *priv = repo->priv_data;
+    void *row = strmap_get(is_source ? priv->source : priv->binary, name);
+    if (row) {
+        debug("Found package: %s\n", name);
+        return repository_package_at(repo, FROM_PTR(row));
     }
     debug("Not found package: %s\n", name);
     return NULL;
 }
 
+visible Package *repository_package_at(Repository *repo, size_t index) {
+    if (repo == NULL || index >= repo->package_count) {
+        return NULL;
+    }
+    if (repo->packages[index] || repo->table == NULL) {
+        return repo->packages[index];
+    }
+    // Materialize the row, strings are shared with the table
+    RepositoryPriv *priv = repo->priv_data;
+    RepositoryTable *table = repo->table;
+    Package *p = package_new_arena(priv->store);
+    if (p == NULL) {
+        return NULL;
+    }
+    uint8_t flags = table->flags[index];
+    p->is_virtual = true;
+    p->repo = (void *) repo;
+    p->is_source = flags & REPOSITORY_SOURCE;
+    p->name = (flags & REPOSITORY_HAS_NAME) ? table->strings[table->name[index]] : NULL;
+    p->version = table->strings[table->version[index]];
+    p->release = table->release[index];
+    p->metadata = table->metadata[index];
+    if (flags & REPOSITORY_HAS_DEPENDS) {
+        p->dependencies = table_strings(repo, table->depends, table->depends_index, index);
+    }
+    if (flags & REPOSITORY_HAS_GROUPS) {
+        p->groups = table_strings(repo, table->groups, table->groups_index, index);
+    }
+    repo->packages[index] = p;
+    return p;
+}
+
+visible const char *repository_name_at(Repository *repo, size_t index) {
+    if (repo == NULL || index >= repo->package_count) {
+        return NULL;
+    }
+    if (repo->table) {
+        if (!(repo->table->flags[index] & REPOSITORY_HAS_NAME)) {
+            return NULL;
+        }
+        return repo->table->strings[repo->table->name[index]];
+    }
+    return repo->packages[index]->name;
+}
+
+visible const char *repository_metadata_at(Repository *repo, size_t index) {
+    if (repo == NULL || index >= repo->package_count) {
+        return NULL;
+    }
+    if (repo->table) {
+        return repo->table->metadata[index];
+    }
+    return repo->packages[index]->metadata;
+}
+
+visible bool repository_is_source_at(Repository *repo, size_t index) {
+    if (repo == NULL || index >= repo->package_count) {
+        return false;
+    }
+    if (repo->table) {
+        return repo->table->flags[index] & REPOSITORY_SOURCE;
+    }
+    return repo->packages[index]->is_source;
+}
+
 visible void repository_load_from_index(Repository *repo, const char *index) {
     debug("Load from index: %s\n", index);
     // Read index
+    trace_begin("index", "%s", index);
     char *data = readfile(index);
     if (data) {
         repository_load_from_data(repo, data);
         free(data);
     }
+    trace_end();
 }
 
 visible void repository_load_from_data(Repository *repo, const char *data) {
@@ -131,6 +449,10 @@ visible void repository_load_from_data(Repository *repo, const char *data) {
     repo->uri = strip(tmp);
     free(tmp);
     free(repo_uri_file);
+    // Compact table for huge indexes
+    if (repo->table == NULL && repo->package_count == 0 && get_bool("compact-index")) {
+        repo->table = table_new();
+    }
     // Load packages
     repository_load_data(repo, inner, true);
     repository_load_data(repo, inner, false);
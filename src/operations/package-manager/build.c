@@ -26,12 +26,14 @@ static int build(void **args) {
         if (!isdir(cache)) {
             return 1;
         }
-        const char *fbuild = build_binary_from_path(cache);
+        char *fbuild = build_binary_from_path(cache);
         if (fbuild == NULL) {
             free(cache);
             return 1;
         }
-        char *pkg = create_package(cache);
+        // package the binary build, not the source cache
+        char *pkg = create_package(fbuild);
+        free(fbuild);
         debug("Output package %s %s %d\n", pkg, args[i], i);
 
         char *pname = ympbuild_package_filename(args[i]);
@@ -67,6 +69,8 @@ void build_init(OperationManager *manager) {
     op.alias = "bi:make";
     op.help = help_new();
     help_add_parameter(op.help, "--install", _("install after build"));
+    help_add_parameter(op.help, "--no-build-cache", _("always build, do not use the binary cache"));
+    help_add_parameter(op.help, "--build:jobs", _("job slots shared by the make of every build"));
     op.call = (callback) build;
     op.min_args = 1;
     operation_register(manager, op);
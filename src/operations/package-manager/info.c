@@ -47,11 +47,12 @@ static void dump_info(Package *pi) {
 static bool print_info(Repository *repo, const char *arg) {
     bool ret = false;
     for (size_t j = 0; j < repo->package_count; j++) {
-        Package *pi = repo->packages[j];
-        if (pi == NULL) {
+        const char *name = repository_name_at(repo, j);
+        if (name == NULL || strcmp(name, arg) != 0) {
             continue;
         }
-        if (strcmp(pi->name, arg) == 0) {
+        Package *pi = repository_package_at(repo, j);
+        if (pi) {
             dump_info(pi);
             ret = true;
         }
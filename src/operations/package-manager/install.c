@@ -12,6 +12,7 @@
 #include <utils/file.h>
 #include <utils/jobs.h>
 #include <utils/string.h>
+#include <utils/strset.h>
 #include <utils/yaml.h>
 
 static int download_cb(Package *p, int num) {
@@ -39,50 +40,65 @@ static int install_cb(Package *p, int num) {
     return 0;
 }
 
-static array *scheduled = NULL;
+static strset *scheduled = NULL;
+static int first_install = JOBS_END;
+static int last_install = JOBS_END; // previous install job when installs run in order
 
-static void install_schedule(char *name, jobs *download_jobs, jobs *install_jobs) {
+static void install_schedule(char *name, jobs *j, bool in_order) {
     // Resolve dependencies
     Package **res = resolve_dependency(name);
     if (res == NULL) {
         return;
     }
-    // Define jobs
+    // Define jobs, each install waits for its own download only
     for (size_t i = 0; res[i]; i++) {
         if (package_is_installed(res[i])) {
             continue;
         }
-        if (array_has(scheduled, res[i]->name)) {
+        if (!strset_add(scheduled, res[i]->name)) {
             continue;
         }
-        array_add(scheduled, res[i]->name);
-        jobs_add(download_jobs, (callback) download_cb, res[i], (void *) (i + 1));
-        jobs_add(install_jobs, (callback) install_cb, res[i], (void *) (i + 1));
+        int download = jobs_add(j, (callback) download_cb, res[i], (void *) (i + 1));
+        int install = jobs_add(j, (callback) install_cb, res[i], (void *) (i + 1));
+        jobs_set_class(j, download, JOBS_CLASS_NET);
+        jobs_set_class(j, install, JOBS_CLASS_IO);
+        int deps[] = { download, last_install, JOBS_END };
+        jobs_add_after(j, install, deps);
+        if (in_order) {
+            last_install = install;
+        }
+        // sync-single applies every package to the system right away, so
+        // nothing is installed before all downloads succeeded
+        if (get_bool("sync-single") && first_install != JOBS_END) {
+            int barrier[] = { download, JOBS_END };
+            jobs_add_after(j, first_install, barrier);
+        }
+        if (first_install == JOBS_END) {
+            first_install = install;
+        }
     }
 }
 
 static int install_main(char **args) {
     int status = 0;
-    scheduled = array_new();
+    scheduled = strset_new(0);
+    first_install = last_install = JOBS_END;
 
     // Begin resolver and init job manager
     Repository **repos = resolve_begin();
     if (repos == NULL) {
         return 2;
     }
-    jobs *download_jobs = jobs_new();
-    jobs *install_jobs = jobs_new();
-    // single thread install if sync single or source package installation
-    if (get_bool("sync-single") || !get_bool("no-emerge")) {
-        install_jobs->parallel = 1;
-    }
+    jobs *j = jobs_new();
+    // install one package at a time, in order, if sync single or source package installation
+    bool in_order = get_bool("sync-single") || !get_bool("no-emerge");
 
     // Upgrade installed packages first
     if (get_bool("upgrade")) {
         char **need_upgrade = resolve_upgrade(repos);
         if (need_upgrade) {
             for (size_t u = 0; need_upgrade[u]; u++) {
-                install_schedule(need_upgrade[u], download_jobs, install_jobs);
+                install_schedule(need_upgrade[u], j, in_order);
             }
             // Clean up
             for (size_t i = 0; need_upgrade[i]; i++) {
@@ -94,18 +110,12 @@ static int install_main(char **args) {
 
     // Resolve requested packages
     for (size_t r = 0; args[r]; r++) {
-        install_schedule(args[r], download_jobs, install_jobs);
-    }
-
-    // Download packages
-    jobs_run(download_jobs);
-    if (download_jobs->failed) {
-        status = 1;
-        goto install_main_free;
+        install_schedule(args[r], j, in_order);
     }
 
-    jobs_run(install_jobs);
-    if (install_jobs->failed) {
+    // Download and install packages
+    jobs_run(j);
+    if (j->failed) {
         status = 1;
         goto install_main_free;
     }
@@ -118,10 +128,9 @@ static int install_main(char **args) {
 install_main_free:
 
     // Cleanup resolver and job managers
-    array_unref(scheduled);
+    strset_unref(scheduled);
     resolve_end(repos);
-    jobs_unref(download_jobs);
-    jobs_unref(install_jobs);
+    jobs_unref(j);
     return status;
 }
 
@@ -137,5 +146,7 @@ void install_init(OperationManager *manager) {
     help_add_parameter(op.help, "--reinstall", _("reinstall if already installed"));
     help_add_parameter(op.help, "--no-emerge", _("use binary package"));
     help_add_parameter(op.help, "--sync-single", _("sync quarantine after every package installation"));
+    help_add_parameter(op.help, "--jobs-net", _("maximum number of parallel downloads"));
+    help_add_parameter(op.help, "--jobs-io", _("maximum number of parallel extractions"));
     operation_register(manager, op);
 }
@@ -20,8 +20,8 @@ static void list_available() {
     }
     while (repos[i]) {
         for (size_t j = 0; j < repos[i]->package_count; j++) {
-            const char *name = repos[i]->packages[j]->name;
-            char *desc = yaml_get_value(repos[i]->packages[j]->metadata, "description");
+            const char *name = repository_name_at(repos[i], j);
+            char *desc = yaml_get_value(repository_metadata_at(repos[i], j), "description");
             if (name == NULL || desc == NULL) {
                 free(desc);
                 continue;
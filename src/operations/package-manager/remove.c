@@ -5,6 +5,7 @@
 #include <unistd.h>
 
 #include <core/logger.h>
+#include <core/stats.h>
 #include <core/variable.h>
 #include <core/ymp.h>
 #include <data/dependency.h>
@@ -79,13 +80,13 @@ static int remove_package(Package *pi) {
         for (size_t i = strlen(line) - 1; line[i] == '\n'; i--) {
             line[i] = '\0';
         }
-        // calculate offset
+        // calculate offset of link - path seperator
         size_t offset = 0;
-        for (offset = 0; line[offset] == ' '; offset++) {
+        for (offset = 0; line[offset] && line[offset] != ' '; offset++) {
         }
         // remove links
-        line[offset] = '/';
-        sprintf(tmp, "%s%s", destdir, line + offset);
+        line[offset] = '\0';
+        sprintf(tmp, "%s%s", destdir, line);
         info("Removing: %s\n", tmp);
         if (!issymlink(tmp)) {
             continue;
@@ -102,6 +103,7 @@ static int remove_package(Package *pi) {
             status = 1;
             goto free_remove_package;
         }
+        stats_add(STATS_FILES_REMOVED, 1);
     }
     for (size_t i = 0; i < len; i++) {
         purge_empty_directories(items[i]);
@@ -131,7 +133,8 @@ static int remove_main(char **args) {
     for (size_t r = 0; args[r]; r++) {
         Package **pkgs = resolve_reverse_dependency(args[r]);
         for (size_t i = 0; pkgs[i]; i++) {
-            jobs_add(j, (callback) remove_package, (void *) pkgs[i], NULL);
+            int id = jobs_add(j, (callback) remove_package, (void *) pkgs[i], NULL);
+            jobs_set_class(j, id, JOBS_CLASS_IO);
         }
     }
     int status = 0;
@@ -199,7 +199,8 @@ static int repo_index(const char *path) {
             continue;
         }
         out[cur].uri = files[i] + strlen(path);
-        jobs_add(j, (callback) repo_index_op, files[i], &out[cur]);
+        int id = jobs_add(j, (callback) repo_index_op, files[i], &out[cur]);
+        jobs_set_class(j, id, JOBS_CLASS_CPU);
         cur++;
     }
     jobs_run(j);
@@ -14,21 +14,22 @@
 static int search_package(const char *arg, Repository **repos) {
     for (size_t i = 0; repos[i]; i++) {
         for (size_t j = 0; j < repos[i]->package_count; j++) {
-            if (get_bool("package") && repos[i]->packages[j]->is_source) {
+            bool is_source = repository_is_source_at(repos[i], j);
+            if (get_bool("package") && is_source) {
                 continue;
             }
-            if (get_bool("source") && !repos[i]->packages[j]->is_source) {
+            if (get_bool("source") && !is_source) {
                 continue;
             }
-            const char *name = repos[i]->packages[j]->name;
-            char *desc = yaml_get_value(repos[i]->packages[j]->metadata, "description");
+            const char *name = repository_name_at(repos[i], j);
+            char *desc = yaml_get_value(repository_metadata_at(repos[i], j), "description");
             if (strstr(name, arg) != NULL || strstr(desc, arg) != NULL) {
                 char *arg_green = NULL;
                 const char *isc = "bin";
-                if (repos[i]->packages[j]->is_source) {
+                if (is_source) {
                     isc = "src";
                 }
-                if (package_is_installed(repos[i]->packages[j])) {
+                if (package_is_installed(repository_package_at(repos[i], j))) {
                     arg_green = build_string("%s", arg);
                 } else {
                     arg_green = build_string("%s", arg);
@@ -28,4 +28,5 @@ void exec_init(OperationManager *manager) {
     op.min_args = 1;
     op.call = (callback) exec_fn;
     operation_register(manager, op);
+    operation_set_thread_safe(manager, "exec");
 }
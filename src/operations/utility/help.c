@@ -64,4 +64,5 @@ void help_init(OperationManager *manager) {
     op.help = NULL;
     op.call = (callback) help_main;
     operation_register(manager, op);
+    operation_set_thread_safe(manager, "help");
 }
@@ -1,14 +1,15 @@
 #include <stdio.h>
 
+#include <core/logger.h>
 #include <core/ymp.h>
 #include <utils/color.h>
-static int print(void **args) {
+static int print_args(void **args) {
     size_t i = 0;
     for (i = 0; args[i]; i++) {
-        printf("%s ", (char *) args[i]);
+        print("%s ", (char *) args[i]);
     }
     if (i > 0) {
-        printf("\n");
+        print("\n");
     }
     return 0;
 }
@@ -20,6 +21,7 @@ void print_init(OperationManager *manager) {
     op.description = _("Print message");
     op.min_args = 0;
     op.help = NULL;
-    op.call = (callback) print;
+    op.call = (callback) print_args;
     operation_register(manager, op);
+    operation_set_thread_safe(manager, "print");
 }
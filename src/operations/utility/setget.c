@@ -48,6 +48,7 @@ void setget_init(OperationManager *manager) {
     set.min_args = 2;
     set.call = (callback) set_fn;
     operation_register(manager, set);
+    operation_set_thread_safe(manager, "set");
 
     Operation get;
     get.name = "get";
@@ -57,6 +58,7 @@ void setget_init(OperationManager *manager) {
     get.help = NULL;
     get.call = (callback) get_fn;
     operation_register(manager, get);
+    operation_set_thread_safe(manager, "get");
 
     Operation eq;
     eq.name = "eq";
@@ -66,6 +68,7 @@ void setget_init(OperationManager *manager) {
     eq.help = NULL;
     eq.call = (callback) eq_fn;
     operation_register(manager, eq);
+    operation_set_thread_safe(manager, "eq");
 
     Operation dummy;
     dummy.name = ":";
@@ -75,4 +78,5 @@ void setget_init(OperationManager *manager) {
     dummy.help = NULL;
     dummy.call = (callback) dummy_fn;
     operation_register(manager, dummy);
+    operation_set_thread_safe(manager, ":");
 }
@@ -4,16 +4,15 @@
 #include <core/interpreter.h>
 #include <core/logger.h>
 #include <core/ymp.h>
+#include <utils/file.h>
 #include <utils/process.h>
 #include <utils/string.h>
 
 static int shell_fn(char **args) {
     int status = 0;
     for (size_t i = 0; args[i]; i++) {
-        char *data = readfile(args[i]);
-        if (data) {
-            status = run_script(data);
-            free(data);
+        if (isfile(args[i])) {
+            status = run_script_file(args[i]);
             if (status) {
                 return status;
             }
@@ -31,4 +30,5 @@ void shell_init(OperationManager *manager) {
     op.min_args = 1;
     op.call = (callback) shell_fn;
     operation_register(manager, op);
+    operation_set_thread_safe(manager, "shell");
 }
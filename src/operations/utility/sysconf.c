@@ -2,6 +2,7 @@
 #include <unistd.h>
 
 #include <core/logger.h>
+#include <core/trace.h>
 #include <core/ymp.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -13,6 +14,7 @@
 static int sysconf_main(char **args) {
     (void) args;
     const char *destdir = get_value("DESTDIR");
+    trace_begin("trigger", "%s", destdir);
     pid_t pid = fork();
     if (pid == 0) {
         char *sysconfdir = build_string("%s/etc/sysconf.d/", destdir);
@@ -41,6 +43,7 @@ static int sysconf_main(char **args) {
     }
     int status;
     waitpid(pid, &status, 0);
+    trace_end();
     return status;
 }
 
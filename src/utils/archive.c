@@ -8,6 +8,7 @@
 
 #include <archive_entry.h>
 #include <core/logger.h>
+#include <core/stats.h>
 #include <core/ymp.h>
 #include <sys/types.h>
 #include <utils/archive.h>
@@ -100,13 +101,7 @@ visible void archive_add(Archive *data, const char *path) {
 }
 
 visible void archive_create(Archive *data) {
-    size_t len;
-    char **files = array_get(data->a, &len);
-    archive_write(data, data->archive_path, files);
-    for (size_t i = 0; i < len; i++) {
-        free(files[i]);
-    }
-    free(files);
+    archive_write(data, data->archive_path, array_view(data->a, NULL));
 }
 
 static void archive_extract_fn(Archive *data, const char *path, bool all) {
@@ -153,6 +148,7 @@ static void archive_extract_fn(Archive *data, const char *path, bool all) {
             }
             const char *link_target = archive_entry_symlink(entry);
             if (link_target != NULL) {
+                stats_add(STATS_FILES_EXTRACTED, 1);
                 if (symlink(link_target, target_file) != 0) {
                     char *error_msg = build_string("Failed to create symbolic link: %s -> %s", target_file, link_target);
                     error_add(error_msg);
@@ -179,6 +175,7 @@ static void archive_extract_fn(Archive *data, const char *path, bool all) {
             }
             mode_t perm = archive_entry_perm(entry);
             fclose(file);
+            stats_add(STATS_FILES_EXTRACTED, 1);
             if (data->preserve_perm) {
                 chmod(target_file, perm);
             } else {
@@ -294,15 +291,25 @@ visible void archive_write(const Archive *data, const char *outname, char **file
         return;
     }
 
+    // Relative names are taken from the target, the process cwd is shared
+    // by every thread
+    int base = AT_FDCWD;
+    if (data->target_path) {
+        base = open(data->target_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (base < 0) {
+            perror(data->target_path);
+            archive_write_free(a);
+            return;
+        }
+    }
     archive_write_open_filename(a, outname);
     entry = NULL;
     while (*filename) {
         debug("archive write : %s\n", filename[0]);
-        if (!isexists(*filename)) {
+        if (fstatat(base, *filename, &st, AT_SYMLINK_NOFOLLOW) < 0) {
             filename++;
             continue;
         }
-        lstat(*filename, &st);
         entry = archive_entry_new();
         archive_entry_set_pathname(entry, *filename);
         archive_entry_set_size(entry, st.st_size);
@@ -320,7 +327,7 @@ visible void archive_write(const Archive *data, const char *outname, char **file
             archive_entry_set_filetype(entry, AE_IFIFO);
         } else if (S_ISLNK(st.st_mode)) {
             char link[PATH_MAX];
-            len = readlink(*filename, link, sizeof(link));
+            len = readlinkat(base, *filename, link, sizeof(link) - 1);
             if (len < 0) {
                 error_add("Failed to create archive");
                 break;
@@ -344,15 +351,20 @@ visible void archive_write(const Archive *data, const char *outname, char **file
         }
         archive_entry_set_perm(entry, 0644);
         archive_write_header(a, entry);
-        fd = open(*filename, O_RDONLY);
-        len = read(fd, buff, sizeof(buff));
+        fd = S_ISREG(st.st_mode) ? openat(base, *filename, O_RDONLY | O_CLOEXEC) : -1;
+        len = fd < 0 ? 0 : read(fd, buff, sizeof(buff));
         while (len > 0) {
             archive_write_data(a, buff, len);
             len = read(fd, buff, sizeof(buff));
         }
-        close(fd);
+        if (fd >= 0) {
+            close(fd);
+        }
         filename++;
     }
+    if (base != AT_FDCWD) {
+        close(base);
+    }
     archive_entry_free(entry);
     archive_write_close(a);
     archive_write_free(a);
@@ -0,0 +1,147 @@
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <core/logger.h>
+#include <core/ymp.h>
+#include <utils/arena.h>
+
+#define ARENA_DEFAULT_CHUNK (64 * 1024)
+#define ARENA_MAX_CHUNK (4 * 1024 * 1024)
+#define ARENA_ALIGN alignof(max_align_t)
+
+typedef struct arena_chunk {
+    struct arena_chunk *next;
+    size_t size;
+    size_t used;
+    alignas(max_align_t) char data[];
+} arena_chunk;
+
+struct arena {
+    arena_chunk *head; // chunk used for new allocations
+    size_t next_size;  // size of the next regular chunk
+    size_t total;
+};
+
+static arena_chunk *arena_chunk_new(arena *a, size_t size) {
+    arena_chunk *chunk = malloc(sizeof(arena_chunk) + size);
+    if (!chunk) {
+        print(_("memory allocation failed"));
+        return NULL;
+    }
+    chunk->size = size;
+    chunk->used = 0;
+    a->total += size;
+    return chunk;
+}
+
+visible arena *arena_new(size_t chunk_size) {
+    arena *a = calloc(1, sizeof(arena));
+    if (!a) {
+        print(_("memory allocation failed"));
+        return NULL;
+    }
+    a->next_size = chunk_size ? chunk_size : ARENA_DEFAULT_CHUNK;
+    return a;
+}
+
+visible void *arena_alloc(arena *a, size_t size) {
+    if (!a) {
+        return NULL;
+    }
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if (size == 0) {
+        size = ARENA_ALIGN;
+    }
+    arena_chunk *head = a->head;
+    if (head && head->size - head->used >= size) {
+        void *ret = head->data + head->used;
+        head->used += size;
+        return ret;
+    }
+    // Large blocks get their own chunk behind the current one
+    if (head && size > a->next_size / 4) {
+        arena_chunk *chunk = arena_chunk_new(a, size);
+        if (!chunk) {
+            return NULL;
+        }
+        chunk->used = size;
+        chunk->next = head->next;
+        head->next = chunk;
+        return chunk->data;
+    }
+    size_t chunk_size = a->next_size;
+    while (chunk_size < size) {
+        chunk_size *= 2;
+    }
+    arena_chunk *chunk = arena_chunk_new(a, chunk_size);
+    if (!chunk) {
+        return NULL;
+    }
+    if (a->next_size < ARENA_MAX_CHUNK) {
+        a->next_size *= 2;
+    }
+    chunk->used = size;
+    chunk->next = head;
+    a->head = chunk;
+    return chunk->data;
+}
+
+visible void *arena_calloc(arena *a, size_t count, size_t size) {
+    if (size && count > SIZE_MAX / size) {
+        return NULL;
+    }
+    void *ret = arena_alloc(a, count * size);
+    if (ret) {
+        memset(ret, 0, count * size);
+    }
+    return ret;
+}
+
+visible char *arena_strndup(arena *a, const char *str, size_t len) {
+    char *ret = arena_alloc(a, len + 1);
+    if (ret) {
+        memcpy(ret, str, len);
+        ret[len] = '\0';
+    }
+    return ret;
+}
+
+visible char *arena_strdup(arena *a, const char *str) {
+    if (!str) {
+        return NULL;
+    }
+    return arena_strndup(a, str, strlen(str));
+}
+
+visible bool arena_owns(const arena *a, const void *ptr) {
+    if (!a || !ptr) {
+        return false;
+    }
+    for (arena_chunk *chunk = a->head; chunk; chunk = chunk->next) {
+        if ((const char *) ptr >= chunk->data && (const char *) ptr < chunk->data + chunk->size) {
+            return true;
+        }
+    }
+    return false;
+}
+
+visible size_t arena_size(const arena *a) {
+    return a ? a->total : 0;
+}
+
+visible void arena_unref(arena *a) {
+    if (!a) {
+        return;
+    }
+    arena_chunk *chunk = a->head;
+    while (chunk) {
+        arena_chunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(a);
+}
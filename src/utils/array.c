@@ -6,8 +6,54 @@
 #include <core/logger.h>
 #include <core/ymp.h>
 #include <utils/array.h>
+#include <utils/strset.h>
 
-#define csort(A, B) qsort(A, B, sizeof(const char *), (int (*)(const void *, const void *)) strcmp)
+static int array_cmp(const void *a, const void *b) {
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+#define csort(A, B) qsort(A, B, sizeof(const char *), array_cmp)
+
+#define ARRAY_MIN_CAPACITY 8
+
+// Make room for at least `need` slots. Lock must be held.
+static bool array_grow(array *arr, size_t need) {
+    if (need <= arr->capacity) {
+        return true;
+    }
+    size_t capacity = arr->capacity ? arr->capacity : ARRAY_MIN_CAPACITY;
+    while (capacity < need) {
+        capacity *= 2;
+    }
+    char **data = (char **) realloc(arr->data, capacity * sizeof(char *));
+    if (!data) {
+        print(_("memory allocation failed"));
+        return false;
+    }
+    // Initialize new slots to NULL
+    memset(data + arr->capacity, 0, (capacity - arr->capacity) * sizeof(char *));
+    arr->data = data;
+    arr->capacity = capacity;
+    return true;
+}
+
+// Move live entries to the front and drop the holes. Lock must be held.
+static void array_compact(array *arr) {
+    if (arr->removed == 0) {
+        return;
+    }
+    size_t write = 0;
+    for (size_t read = 0; read < arr->size + arr->removed; read++) {
+        if (arr->data[read] != NULL) {
+            arr->data[write++] = arr->data[read];
+        }
+    }
+    for (size_t k = write; k < arr->size + arr->removed; k++) {
+        arr->data[k] = NULL;
+    }
+    arr->size = write;
+    arr->removed = 0;
+}
 
 visible array *array_new() {
     array *arr = (array *) calloc(1, sizeof(array));
@@ -15,20 +61,12 @@ visible array *array_new() {
         print(_("memory allocation failed"));
         return NULL;
     }
-    arr->data = (char **) calloc(1024, sizeof(char *));
-    if (!arr->data) {
-        print(_("memory allocation failed"));
-        free(arr);
-        return NULL;
-    }
+    // Storage is allocated on first add, most arrays stay small
+    arr->data = NULL;
     arr->size = 0;
-    arr->capacity = 1024;
+    arr->capacity = 0;
     arr->removed = 0;
     arr->lock = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
-    size_t start;
-    for (start = 0; start < arr->capacity; start++) {
-        arr->data[start] = NULL;
-    }
     return arr;
 }
 
@@ -38,22 +76,13 @@ visible void array_add(array *arr, const char *value) {
     }
     pthread_mutex_lock(&arr->lock);
     // Check if we need to increase capacity
-    if (arr->size >= arr->capacity) {
-        arr->capacity += 1024;
-        arr->data = (char **) realloc(arr->data, arr->capacity * sizeof(char *));
-        if (!arr->data) {
-            // Handle memory allocation failure
-            pthread_mutex_unlock(&arr->lock);
-            return;
-        }
-        // Initialize new slots to NULL
-        for (size_t start = arr->size; start < arr->capacity; start++) {
-            arr->data[start] = NULL;
-        }
+    if (!array_grow(arr, arr->size + arr->removed + 1)) {
+        pthread_mutex_unlock(&arr->lock);
+        return;
     }
 
     // Add the new value
-    arr->data[arr->size] = strdup(value);
+    arr->data[arr->size + arr->removed] = strdup(value);
     arr->size++;
 
     pthread_mutex_unlock(&arr->lock);
@@ -61,19 +90,14 @@ visible void array_add(array *arr, const char *value) {
 
 visible void array_set(array *arr, char **new_data) {
     pthread_mutex_lock(&arr->lock);
-    for (size_t i = 0; i < arr->size; i++) {
+    for (size_t i = 0; i < arr->size + arr->removed; i++) {
         if (arr->data[i]) {
             free(arr->data[i]);
+            arr->data[i] = NULL;
         }
     }
-    free(arr->data);
-    arr->data = calloc(arr->capacity, sizeof(char *));
     arr->size = 0;
     arr->removed = 0;
-    size_t start;
-    for (start = 0; start < arr->capacity; start++) {
-        arr->data[start] = NULL;
-    }
     pthread_mutex_unlock(&arr->lock);
     array_adds(arr, new_data);
 }
@@ -84,21 +108,25 @@ visible char *array_get_string(array *arr) {
         return NULL;
     }
     pthread_mutex_lock(&arr->lock);
+    size_t total = arr->size + arr->removed;
     size_t tot_len = 0;
-    size_t start = 0;
-    while (start < arr->capacity) {
+    for (size_t start = 0; start < total; start++) {
         if (arr->data[start] != NULL) {
             tot_len += strlen(arr->data[start]);
         }
-        start++;
     }
     char *ret = calloc(tot_len + 1, sizeof(char));
-    start = 0;
-    while (start < arr->capacity) {
+    if (!ret) {
+        pthread_mutex_unlock(&arr->lock);
+        return NULL;
+    }
+    size_t offset = 0;
+    for (size_t start = 0; start < total; start++) {
         if (arr->data[start] != NULL) {
-            strcat(ret, arr->data[start]);
+            size_t len = strlen(arr->data[start]);
+            memcpy(ret + offset, arr->data[start], len);
+            offset += len;
         }
-        start++;
     }
     pthread_mutex_unlock(&arr->lock);
     return ret;
@@ -112,15 +140,13 @@ visible void array_adds(array *arr, char **value) {
 
 visible void array_remove(array *arr, const char *item) {
     pthread_mutex_lock(&arr->lock);
-    size_t start = 0;
-    while (start < arr->capacity) {
+    for (size_t start = 0; start < arr->size + arr->removed; start++) {
         if (arr->data[start] != NULL && strcmp(arr->data[start], item) == 0) {
             free(arr->data[start]);
             arr->data[start] = NULL;
             arr->size -= 1;
             arr->removed += 1;
         }
-        start++;
     }
     pthread_mutex_unlock(&arr->lock);
 }
@@ -143,35 +169,25 @@ visible bool array_has(array *arr, const char *name) {
 
 visible void array_uniq(array *arr) {
     pthread_mutex_lock(&arr->lock);
-    size_t start = 1;
-    size_t i = 0;
-    while (start < arr->size) {
-        if (arr->data[start] == NULL) {
-            start++;
+    // Keep the first occurrence of every item, the set borrows the array strings
+    strset *seen = strset_new(STRSET_BORROW);
+    size_t write = 0;
+    for (size_t read = 0; read < arr->size + arr->removed; read++) {
+        if (arr->data[read] == NULL) {
             continue;
         }
-        for (i = 0; i < start; i++) {
-            if (arr->data[i] != NULL && strcmp(arr->data[i], arr->data[start]) == 0) {
-                free(arr->data[start]);
-                arr->data[start] = NULL;
-                break;
-            }
+        if (!strset_add(seen, arr->data[read])) {
+            free(arr->data[read]);
+            arr->data[read] = NULL;
+            continue;
         }
-        start++;
-    }
-    // Compact the array so remaining entries are contiguous
-    size_t write = 0;
-    for (size_t read = 0; read < arr->size; read++) {
-        if (arr->data[read] != NULL) {
-            if (write != read) {
-                arr->data[write] = arr->data[read];
-            }
-            write++;
+        if (write != read) {
+            arr->data[write] = arr->data[read];
+            arr->data[read] = NULL;
         }
+        write++;
     }
-    for (size_t k = write; k < arr->size; k++) {
-        arr->data[k] = NULL;
-    }
+    strset_unref(seen);
     arr->size = write;
     arr->removed = 0;
     pthread_mutex_unlock(&arr->lock);
@@ -179,77 +195,37 @@ visible void array_uniq(array *arr) {
 
 visible void array_pop(array *arr, size_t index) {
     pthread_mutex_lock(&arr->lock);
-    if (arr->data[index] != NULL) {
+    if (index < arr->size + arr->removed && arr->data[index] != NULL) {
         free(arr->data[index]);
+        arr->data[index] = NULL;
+        arr->size -= 1;
+        arr->removed += 1;
     }
-    arr->data[index] = NULL;
-    arr->size -= 1;
-    arr->removed += 1;
     pthread_mutex_unlock(&arr->lock);
 }
 
 visible void array_insert(array *arr, const char *value, size_t index) {
     pthread_mutex_lock(&arr->lock);
-    if (arr->size >= arr->capacity) {
-        array_add(arr, NULL);
-    }
-    if (arr->data[index] == NULL) {
-        arr->data[index] = strdup(value);
-        arr->size++;
+    array_compact(arr);
+    if (!array_grow(arr, arr->size + 1)) {
         pthread_mutex_unlock(&arr->lock);
         return;
     }
-    char *tmp = arr->data[index];
-    char *tmp2 = NULL;
-    arr->data[index] = strdup(value);
-    size_t start = index + 1;
-    while (start < arr->capacity) {
-        if (arr->data[start] == NULL) {
-            arr->data[start] = tmp;
-            arr->size += 1;
-            pthread_mutex_unlock(&arr->lock);
-            return;
-        }
-        tmp2 = arr->data[start];
-        arr->data[start] = tmp;
-        tmp = tmp2;
-        tmp2 = NULL;
-        start++;
+    if (index > arr->size) {
+        index = arr->size;
     }
+    memmove(arr->data + index + 1, arr->data + index, (arr->size - index) * sizeof(char *));
+    arr->data[index] = strdup(value);
     arr->size += 1;
     pthread_mutex_unlock(&arr->lock);
 }
 
 visible void array_sort(array *arr) {
     pthread_mutex_lock(&arr->lock);
-    char **new_data = (char **) calloc(arr->capacity, sizeof(char *));
-    if (!new_data) {
-        pthread_mutex_unlock(&arr->lock);
-        return;
-    }
-    size_t start = 0;
-    size_t skip = 0;
-    size_t count = 0;
-    while (start < arr->size + arr->removed + 1) {
-        if (arr->data[start] == NULL) {
-            start++;
-            skip++;
-            continue;
-        }
-        new_data[start - skip] = strdup(arr->data[start]);
-        count++;
-        start++;
+    array_compact(arr);
+    if (arr->size > 1) {
+        csort(arr->data, arr->size);
     }
-    csort(new_data, count);
-    for (size_t i = 0; i < arr->size + arr->removed + 1; i++) {
-        if (arr->data[i]) {
-            free(arr->data[i]);
-        }
-    }
-    free(arr->data);
-    arr->data = new_data;
-    arr->size = count;
-    arr->removed = 0;
     pthread_mutex_unlock(&arr->lock);
 }
 
@@ -260,24 +236,15 @@ visible char **array_get(array *arr, size_t *len) {
 
     pthread_mutex_lock(&arr->lock);
 
-    // Count the actual number of live (non-NULL) entries
-    size_t total = arr->size + arr->removed;
-    size_t count = 0;
-    for (size_t i = 0; i < total; i++) {
-        if (arr->data[i] != NULL) {
-            count++;
-        }
-    }
-
     // Allocate memory for the return array
-    char **ret = calloc((count + 1), sizeof(char *));
+    char **ret = calloc((arr->size + 1), sizeof(char *));
     if (!ret) {
         pthread_mutex_unlock(&arr->lock);
         return NULL;  // Handle memory allocation failure
     }
 
     size_t ret_index = 0;  // Index for ret array
-    for (size_t start = 0; start < total; start++) {
+    for (size_t start = 0; start < arr->size + arr->removed; start++) {
         if (arr->data[start] != NULL) {
             ret[ret_index] = strdup(arr->data[start]);
             debug("item: %s index: %ld len: %ld\n", ret[ret_index], ret_index, arr->size);
@@ -303,34 +270,54 @@ visible char **array_get(array *arr, size_t *len) {
     return ret;  // Caller is responsible for freeing this memory
 }
 
+visible char **array_view(array *arr, size_t *len) {
+    if (!arr) {
+        return NULL;
+    }
+    pthread_mutex_lock(&arr->lock);
+    array_compact(arr);
+    // Keep one slot for the NULL terminator
+    if (!array_grow(arr, arr->size + 1)) {
+        pthread_mutex_unlock(&arr->lock);
+        return NULL;
+    }
+    arr->data[arr->size] = NULL;
+    if (len) {
+        *len = arr->size;
+    }
+    pthread_mutex_unlock(&arr->lock);
+    return arr->data;
+}
+
+visible char **array_steal(array *arr, size_t *len) {
+    if (!arr) {
+        return NULL;
+    }
+    char **ret = array_view(arr, len);
+    if (!ret) {
+        array_unref(arr);
+        return NULL;
+    }
+    // The caller owns the vector and the strings now
+    arr->data = NULL;
+    arr->size = 0;
+    arr->capacity = 0;
+    array_unref(arr);
+    return ret;
+}
+
 visible size_t array_length(const array *arr) {
-    return arr->size - arr->removed;
+    return arr->size;
 }
 
 visible void array_reverse(array *arr) {
     pthread_mutex_lock(&arr->lock);
-    if (arr->size <= 1) {
-        pthread_mutex_unlock(&arr->lock);
-        return; /* No need to reverse if size is 0 or 1 */
-    }
-
-    size_t start = 0;
-    size_t tot = arr->size + arr->removed;
-    while (start < tot / 2) {
+    array_compact(arr);
+    for (size_t start = 0; start < arr->size / 2; start++) {
         /* Swap elements at start and end indices */
-        const char *temp = arr->data[start];
-        const char *temp2 = arr->data[tot - start - 1];
-        if (temp2 != NULL) {
-            arr->data[start] = strdup(temp2);
-        }
-        if (temp != NULL) {
-            arr->data[tot - start - 1] = strdup(temp);
-        } else {
-            arr->data[tot - start - 1] = NULL;
-        }
-
-        /* Move towards the center */
-        start++;
+        char *temp = arr->data[start];
+        arr->data[start] = arr->data[arr->size - start - 1];
+        arr->data[arr->size - start - 1] = temp;
     }
     pthread_mutex_unlock(&arr->lock);
 }
@@ -341,7 +328,7 @@ visible void array_unref(array *arr) {
     }
 
     // Free each string in the array
-    for (size_t i = 0; i < arr->size; i++) {
+    for (size_t i = 0; i < arr->size + arr->removed; i++) {
         if (arr->data[i]) {
             free(arr->data[i]);  // Free each string
         }
@@ -361,15 +348,17 @@ visible void array_clear(array *arr) {
     if (arr == NULL) {
         return;  // Nothing to free
     }
+    pthread_mutex_lock(&arr->lock);
     // Free each string in the array
-    for (size_t i = 0; i < arr->size; i++) {
+    for (size_t i = 0; i < arr->size + arr->removed; i++) {
         if (arr->data[i]) {
             free(arr->data[i]);  // Free each string
         }
     }
     free(arr->data);
-    arr->data = (char **) calloc(1024, sizeof(char *));
+    arr->data = NULL;
     arr->size = 0;
-    arr->capacity = 1024;
+    arr->capacity = 0;
     arr->removed = 0;
+    pthread_mutex_unlock(&arr->lock);
 }
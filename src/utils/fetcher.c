@@ -6,10 +6,13 @@
 #include <string.h>
 
 #include <core/logger.h>
+#include <core/stats.h>
+#include <core/trace.h>
 #include <core/ymp.h>
 #include <curl/curl.h>
 #include <utils/fetcher.h>
 #include <utils/file.h>
+#include <utils/hash.h>
 #include <utils/string.h>
 
 typedef struct {
@@ -21,11 +24,15 @@ typedef struct {
     FetchProgressCallback progress_cb;
     void *userdata;
     char *url;
+    hash_stream *hash;
 } fetcher;
 
 static size_t write_data(const void *ptr, size_t size, size_t nmemb, void *stream) {
-    size_t copy = fwrite(ptr, size, nmemb, ((fetcher *) stream)->fp);
-    ((fetcher *) stream)->cur_size += copy;
+    fetcher *fetch = (fetcher *) stream;
+    size_t copy = fwrite(ptr, size, nmemb, fetch->fp);
+    // Hash the data while it is still in memory
+    hash_stream_update(fetch->hash, ptr, copy * size);
+    fetch->cur_size += copy;
     return copy;
 }
 
@@ -39,7 +46,7 @@ static int progress_callback(void *clientp, curl_off_t dltotal, curl_off_t dlnow
     return 0;
 }
 
-visible bool fetch_with_progress(const char *url, const char *path, FetchProgressCallback cb, void *userdata) {
+static bool fetch_with_progress_fn(const char *url, const char *path, FetchProgressCallback cb, void *userdata, hash_stream *hash) {
     debug("Fetch: %s -> %s\n", url, path);
     fetcher *fetch = calloc(1, sizeof(fetcher));
 
@@ -51,6 +58,7 @@ visible bool fetch_with_progress(const char *url, const char *path, FetchProgres
     fetch->progress_cb = cb;
     fetch->userdata = userdata;
     fetch->url = (char *) url;
+    fetch->hash = hash;
     fetch->cur_size = 0;
     fetch->total_size = 0;
 
@@ -90,6 +98,7 @@ visible bool fetch_with_progress(const char *url, const char *path, FetchProgres
         }
 
         fetch->res = curl_easy_perform(fetch->curl);
+        stats_add(STATS_BYTES_DOWNLOADED, fetch->cur_size);
         if (fetch->res != CURLE_OK) {
             print(_("Download failed: %s\n"), curl_easy_strerror(fetch->res));
             fclose(fetch->fp);
@@ -118,3 +127,25 @@ visible bool fetch_with_progress(const char *url, const char *path, FetchProgres
     free(fetch);
     return false;
 }
+
+visible bool fetch_with_progress(const char *url, const char *path, FetchProgressCallback cb, void *userdata) {
+    trace_begin("download", "%s", url);
+    bool status = fetch_with_progress_fn(url, path, cb, userdata, NULL);
+    trace_end();
+    return status;
+}
+
+visible bool fetch_with_hash(const char *url, const char *path, int type, char **hash, FetchProgressCallback cb, void *userdata) {
+    trace_begin("download", "%s", url);
+    hash_stream *h = hash_stream_new(type);
+    bool status = h && fetch_with_progress_fn(url, path, cb, userdata, h);
+    char *digest = hash_stream_final(h);
+    trace_end();
+    status = status && digest;
+    if (status && hash) {
+        *hash = digest;
+    } else {
+        free(digest);
+    }
+    return status;
+}
@@ -4,6 +4,7 @@
 #include <fcntl.h>
 #include <libgen.h>
 #include <limits.h>
+#include <linux/fs.h>
 #include <sched.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -13,7 +14,10 @@
 #include <unistd.h>
 
 #include <core/logger.h>
+#include <core/stats.h>
 #include <core/ymp.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -83,12 +87,17 @@ visible void create_dir(const char *dir) {
     // Create directories in the path
     for (p = tmp + 1; *p; p++) {
         if (*p == '/') {
-            *p = '\0';         // Temporarily terminate the string
-            mkdir(tmp, 0755);  // Create the directory
-            *p = '/';          // Restore the string
+            *p = '\0';  // Temporarily terminate the string
+            if (mkdir(tmp, 0755) == 0) {
+                stats_add(STATS_DIRS_CREATED, 1);
+            }
+            *p = '/';  // Restore the string
         }
     }
-    mkdir(tmp, 0755);  // Create the final directory
+    // Create the final directory
+    if (mkdir(tmp, 0755) == 0) {
+        stats_add(STATS_DIRS_CREATED, 1);
+    }
 }
 
 visible char **listdir(const char *path) {
@@ -103,43 +112,36 @@ visible char **listdir(const char *path) {
         }
         (void) closedir(dp);
     }
-    size_t len = 0;
-    char **dirs = array_get(a, &len);
-    array_unref(a);
-    return dirs;
+    return array_steal(a, NULL);
 }
 
 static void find_operation(array *array, const char *path) {
     debug("find files from: %s\n", path);
-    char **inodes = listdir(path);
-    int i = 0;
-    while (inodes[i]) {
-        if (iseq(inodes[i], "..") || iseq(inodes[i], ".")) {
-            free(inodes[i]);
-            i++;
+    DIR *dp = opendir(path);
+    if (dp == NULL) {
+        return;
+    }
+    struct dirent *ep;
+    while ((ep = readdir(dp))) {
+        if (iseq(ep->d_name, "..") || iseq(ep->d_name, ".")) {
             continue;
         }
-        char *inode = build_string("%s/%s", path, inodes[i]);
+        char *inode = build_string("%s/%s", path, ep->d_name);
         if (isdir(inode)) {
             find_operation(array, inode);
         } else {
             array_add(array, inode);
         }
         free(inode);
-        free(inodes[i]);
-        i++;
     }
-    free(inodes);
+    (void) closedir(dp);
 }
 
 visible char **find(const char *path) {
     debug("find files: %s\n", path);
     array *a = array_new();
     find_operation(a, path);
-    size_t len;
-    char **list = array_get(a, &len);
-    array_unref(a);
-    return list;
+    return array_steal(a, NULL);
 }
 
 visible void format_size(char *buf, size_t buf_len, size_t bytes) {
@@ -173,7 +175,7 @@ visible void writefile(const char *path, const char *data) {
 
     fclose(file);
 }
-visible char *getoutput_unshare(char *argv[], int flags) {
+visible char *getoutput_unshare_size(char *argv[], int flags, size_t *size) {
     int pipefd[2];
     if (pipe(pipefd) == -1) {
         perror("pipe");
@@ -182,6 +184,8 @@ visible char *getoutput_unshare(char *argv[], int flags) {
     pid_t pid = fork();
     if (pid == -1) {
         perror("fork");
+        close(pipefd[0]);
+        close(pipefd[1]);
         return NULL;
     }
     if (pid == 0) {  // Child process
@@ -202,129 +206,233 @@ visible char *getoutput_unshare(char *argv[], int flags) {
         // If execvp returns, it must have failed
         perror("execvp");
         exit(EXIT_FAILURE);
-    } else {  // Parent process
-        // Close the write end of the pipe
-        close(pipefd[1]);
-
-        // Read the output from the read end of the pipe
-        char *ret = NULL;
-        size_t bufsize = 1024;
-        ret = calloc(bufsize, sizeof(char));
-        if (!ret) {
-            perror("Memory allocation error");
-            return "";
-        }
-
-        size_t total_read = 0;
-        char buff[1024];
-        ssize_t bytes_read;
-        while ((bytes_read = read(pipefd[0], buff, sizeof(buff) - 1)) > 0) {
-            buff[bytes_read] = '\0';  // Null-terminate the buffer
-            size_t len = total_read + bytes_read + 1;
-            if (len > bufsize) {
-                // Resize buffer if needed
-                bufsize = len * 2;
-                char *tmp = realloc(ret, bufsize);
-                if (!tmp) {
-                    perror("Memory reallocation error");
-                    free(ret);
-                    close(pipefd[0]);
-                    int status;
-                    wait(&status);
-                    return "";
-                }
-                ret = tmp;
+    }
+    // Close the write end of the pipe
+    close(pipefd[1]);
+
+    // Read the output, it may contain NUL bytes so track the length
+    size_t bufsize = 1024;
+    size_t total_read = 0;
+    char *ret = malloc(bufsize);
+    ssize_t bytes_read = 0;
+    while (ret) {
+        if (total_read + 1 >= bufsize) {
+            bufsize *= 2;
+            char *tmp = realloc(ret, bufsize);
+            if (!tmp) {
+                perror("Memory reallocation error");
+                free(ret);
+                ret = NULL;
+                break;
             }
-            strcat(ret, buff);
-            total_read += bytes_read;
+            ret = tmp;
+        }
+        bytes_read = read(pipefd[0], ret + total_read, bufsize - total_read - 1);
+        if (bytes_read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_read <= 0) {
+            break;
         }
+        total_read += bytes_read;
+    }
+    close(pipefd[0]);  // Close the read end of the pipe
 
-        close(pipefd[0]);  // Close the read end of the pipe
+    // Wait for the child process to finish
+    int status;
+    (void) waitpid(pid, &status, 0);
 
-        // Wait for the child process to finish
-        int status;
-        wait(&status);
+    if (!ret) {
+        return NULL;
+    }
+    ret[total_read] = '\0';
+    if (size) {
+        *size = total_read;
+    }
+    // Trim the buffer to the actual size needed
+    char *trimmed = realloc(ret, total_read + 1);
+    return trimmed ? trimmed : ret;
+}
 
-        // Trim the buffer to the actual size needed
-        char *trimmed = realloc(ret, (strlen(ret) + 1) * sizeof(char));
-        if (trimmed) {
-            ret = trimmed;
-        }
+visible char *getoutput_unshare(char *argv[], int flags) {
+    return getoutput_unshare_size(argv, flags, NULL);
+}
 
-        return ret;
+// Copy the data of an open file, cheapest method first.
+// Every method continues from the current file offsets, so a method that
+// stops half way hands over to the next one.
+static bool copy_fd(int source, int dest) {
+    // Reflink, only metadata is written on btrfs, xfs and similar
+    if (ioctl(dest, FICLONE, source) == 0) {
+        return true;
     }
-}
 
-visible bool copy_file(const char *sourceFile, const char *destFile) {
-    debug("Copy file: %s -> %s\n", sourceFile, destFile);
-    int source, dest;
-    char buffer[1024 * 1024];  // Buffer to hold data (1MB)
-    ssize_t bytesRead;
+    // In kernel copy, may still share extents or use server side copy
+    ssize_t n = 0;
+    while ((n = copy_file_range(source, NULL, dest, NULL, 1 << 30, 0)) > 0) {
+    }
+    if (n == 0) {
+        return true;
+    }
+    if (errno != EXDEV && errno != ENOSYS && errno != EINVAL && errno != EOPNOTSUPP && errno != EBADF) {
+        perror("Error copying file");
+        return false;
+    }
 
-    struct stat statbuf;
+    // In kernel copy through the page cache
+    while ((n = sendfile(dest, source, NULL, 1 << 30)) > 0) {
+    }
+    if (n == 0) {
+        return true;
+    }
+    if (errno != EINVAL && errno != ENOSYS) {
+        perror("Error copying file");
+        return false;
+    }
 
-    // Check if the source file is a symlink
-    if (lstat(sourceFile, &statbuf) < 0) {
+    // Plain read and write
+    size_t size = 1024 * 1024;
+    char *buffer = malloc(size);
+    if (!buffer) {
+        perror("malloc");
+        return false;
+    }
+    bool ret = true;
+    while ((n = read(source, buffer, size)) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Error reading file");
+            ret = false;
+            break;
+        }
+        // Short writes are continued
+        for (ssize_t done = 0; done < n && ret;) {
+            ssize_t written = write(dest, buffer + done, n - done);
+            if (written < 0 && errno != EINTR) {
+                perror("Error writing file");
+                ret = false;
+            } else if (written > 0) {
+                done += written;
+            }
+        }
+        if (!ret) {
+            break;
+        }
+    }
+    free(buffer);
+    return ret;
+}
+
+// Copy one directory entry, paths are relative to the directory fds
+static bool copy_at(int source_dir, const char *source, int dest_dir, const char *dest) {
+    struct stat st;
+    if (fstatat(source_dir, source, &st, AT_SYMLINK_NOFOLLOW) < 0) {
         perror("Error getting file status");
         return false;
     }
 
-    // If it's a symlink, read the target
-    if (S_ISLNK(statbuf.st_mode)) {
+    // Copy symlinks as symlinks
+    if (S_ISLNK(st.st_mode)) {
         char target[PATH_MAX];
-        ssize_t len = readlink(sourceFile, target, sizeof(target) - 1);
+        ssize_t len = readlinkat(source_dir, source, target, sizeof(target) - 1);
         if (len < 0) {
             perror("Error reading symlink");
             return false;
         }
         target[len] = '\0';
-        // Create a symbolic link
-        if (symlink(target, destFile) == -1) {
+        if (symlinkat(target, dest_dir, dest) == -1) {
             perror("Error creating symlink");
             return false;
         }
         return true;
     }
 
-    // Open the source file in read-only mode
-    source = open(sourceFile, O_RDONLY);
-    if (source < 0) {
+    int in = openat(source_dir, source, O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
         perror("Error opening source file");
         return false;
     }
 
+    // Replace instead of truncating, the old file may share its data with a hard link
+    (void) unlinkat(dest_dir, dest, 0);
+    int out = openat(dest_dir, dest, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 07777);
+    if (out < 0) {
+        perror("Error opening destination file");
+        close(in);
+        return false;
+    }
+    bool ret = copy_fd(in, out);
+    close(in);
+    if (close(out) < 0) {
+        perror("Error writing file");
+        ret = false;
+    }
+    return ret;
+}
+
+visible bool copy_file(const char *sourceFile, const char *destFile) {
+    debug("Copy file: %s -> %s\n", sourceFile, destFile);
+
     // Create destination file directory
     char *dir = strdup(destFile);
     dirname(dir);
     create_dir(dir);
     free(dir);
 
-    // Open the destination file in write-only mode, create it if it doesn't exist
-    dest = open(destFile, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
-    if (dest < 0) {
-        perror("Error opening destination file");
-        close(source);
+    return copy_at(AT_FDCWD, sourceFile, AT_FDCWD, destFile);
+}
+
+static bool copy_directory_at(int source, int dest) {
+    // fdopendir() owns the fd it gets
+    int list = dup(source);
+    DIR *dir = list < 0 ? NULL : fdopendir(list);
+    if (dir == NULL) {
+        if (list >= 0) {
+            close(list);
+        }
+        perror("Error opening source directory");
         return false;
     }
 
-    // Copy the file content
-    while ((bytesRead = read(source, buffer, sizeof(buffer))) > 0) {
-        ssize_t written = write(dest, buffer, bytesRead);
-        if (written < 0) {
-            perror("Error writing file");
-            close(source);
-            close(dest);
-            return false;
+    bool ret = true;
+    const struct dirent *entry;
+    while (ret && (entry = readdir(dir)) != NULL) {
+        // Skip the "." and ".." entries
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        struct stat st;
+        if (fstatat(source, entry->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0) {
+            perror(entry->d_name);
+            ret = false;
+        } else if (S_ISDIR(st.st_mode)) {
+            // Recursively copy the directory
+            if (mkdirat(dest, entry->d_name, st.st_mode & 07777) != 0 && errno != EEXIST) {
+                print(_("Error creating destination directory: %s\n"), entry->d_name);
+                ret = false;
+                continue;
+            }
+            int sub_source = openat(source, entry->d_name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            int sub_dest = openat(dest, entry->d_name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            ret = sub_source >= 0 && sub_dest >= 0 && copy_directory_at(sub_source, sub_dest);
+            if (sub_source >= 0) {
+                close(sub_source);
+            }
+            if (sub_dest >= 0) {
+                close(sub_dest);
+            }
+        } else {
+            // Copy the file
+            ret = copy_at(source, entry->d_name, dest, entry->d_name);
         }
     }
 
-    // Close the files
-    close(source);
-    close(dest);
-    return true;
+    closedir(dir);
+    return ret;
 }
 
-// Function to copy a directory recursively
 visible bool copy_directory(const char *sourceDir, const char *destDir) {
     struct stat st;
     if (stat(sourceDir, &st) != 0) {
@@ -338,42 +446,21 @@ visible bool copy_directory(const char *sourceDir, const char *destDir) {
         return false;
     }
 
-    DIR *dir = opendir(sourceDir);
-    if (dir == NULL) {
+    int source = open(sourceDir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (source < 0) {
         print(_("Error opening source directory: %s\n"), sourceDir);
         return false;
     }
-
-    const struct dirent *entry;
-    while ((entry = readdir(dir)) != NULL) {
-        // Skip the "." and ".." entries
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-            continue;
-        }
-
-        char sourcePath[1024];
-        char destPath[1024];
-
-        snprintf(sourcePath, sizeof(sourcePath), "%s/%s", sourceDir, entry->d_name);
-        snprintf(destPath, sizeof(destPath), "%s/%s", destDir, entry->d_name);
-
-        if (entry->d_type == DT_DIR) {
-            // Recursively copy the directory
-            if (!copy_directory(sourcePath, destPath)) {
-                closedir(dir);
-                return false;
-            }
-        } else {
-            // Copy the file
-            if (!copy_file(sourcePath, destPath)) {
-                closedir(dir);
-                return false;
-            }
-        }
+    int dest = open(destDir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dest < 0) {
+        print(_("Error opening destination directory: %s\n"), destDir);
+        close(source);
+        return false;
     }
-
-    closedir(dir);
-    return true;
+    bool ret = copy_directory_at(source, dest);
+    close(source);
+    close(dest);
+    return ret;
 }
 
 visible bool move_file(const char *src, const char *dest) {
@@ -390,6 +477,29 @@ visible bool move_file(const char *src, const char *dest) {
     return true;
 }
 
+visible bool link_file(const char *src, const char *dest) {
+    debug("Link file: %s -> %s\n", src, dest);
+    char *dir = strdup(dest);
+    dirname(dir);
+    create_dir(dir);
+    free(dir);
+    // Readers of dest see the old file or the complete new one, never a
+    // partial copy. The temporary name is unique across threads and processes.
+    static size_t serial = 0;
+    char *tmp = build_string("%s.%d.%zu.tmp", dest, getpid(), __atomic_fetch_add(&serial, 1, __ATOMIC_RELAXED));
+    // Different filesystems or no hard link support, copy_file() tries a reflink first
+    bool ret = link(src, tmp) == 0 || copy_file(src, tmp);
+    if (ret && rename(tmp, dest) < 0) {
+        perror(dest);
+        ret = false;
+    }
+    if (!ret) {
+        (void) unlink(tmp);
+    }
+    free(tmp);
+    return ret;
+}
+
 visible char *sreadlink(const char *path) {
     // Buffer size for the target path
     ssize_t bufsize = 1024;  // You can adjust this size as needed
@@ -458,17 +568,21 @@ visible bool remove_all(const char *path) {
     return true;
 }
 
+visible bool is_elf_fd(int fd) {
+    char buf[4];
+    if (pread(fd, buf, sizeof(buf), 0) != sizeof(buf)) {
+        return false;
+    }
+    return (buf[0] == '\x7f' && buf[1] == 'E' && buf[2] == 'L' && buf[3] == 'F');
+}
+
 visible bool is_elf(const char *path) {
     debug("is elf: %s\n", path);
-    FILE *f = fopen(path, "r");
-    if (f == NULL) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
         return false;
     }
-    char buf[4];
-    int rc = fread(&buf, sizeof(char), 4, f);
-    (void) rc;
-
-    bool ret = (buf[0] == '\x7f' && buf[1] == 'E' && buf[2] == 'L' && buf[3] == 'F');
-    fclose(f);
+    bool ret = is_elf_fd(fd);
+    close(fd);
     return ret;
 }
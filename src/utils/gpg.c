@@ -5,6 +5,7 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <core/stats.h>
 #include <core/variable.h>
 #include <sys/stat.h>
 #include <utils/file.h>
@@ -22,6 +23,7 @@ visible bool gpg_sign_file(const char *path) {
         return false;
     }
     char *args[] = { "gpg", "--batch", "--yes", "--sign", "-r", gpg_repicent, (char *) path, NULL };
+    stats_add(STATS_FORKS_GPG, 1);
     return 0 == run_args(args);
 }
 
@@ -30,6 +32,7 @@ visible bool gpg_export_file(const char *path) {
         return false;
     }
     char *args[] = { "gpg", "--armor", "--export", "-o", gpg_repicent, (char *) path, NULL };
+    stats_add(STATS_FORKS_GPG, 1);
     return 0 == run_args(args);
 }
 
@@ -47,5 +50,6 @@ visible bool verify_file(const char *path, const char *keyring) {
     snprintf(sig, sizeof(sig), "%s.gpg", path);
 
     char *args[] = { "gpg", "--homedir", gpgdir, "--trust-model", "always", "--no-default-keyring", "--keyring", (char *) keyring, "--quiet", "--verify", sig, NULL };
+    stats_add(STATS_FORKS_GPG, 1);
     return 0 == run_args(args);
 }
@@ -5,6 +5,8 @@
 #include <unistd.h>  // For system calls write, read e close
 
 #include <core/logger.h>
+#include <core/stats.h>
+#include <core/trace.h>
 #include <openssl/evp.h>
 #include <utils/file.h>
 #include <utils/hash.h>
@@ -12,15 +14,14 @@
 #define BUFFER_SIZE 8196
 #define OPENSSL_API_COMPAT
 
-visible char *calculate_hash(int type, const char *path) {
-    debug("calculate hash: %d %s\n", type, path);
-    unsigned char buffer[BUFFER_SIZE];
-    unsigned char digest[EVP_MAX_MD_SIZE];
-    unsigned int md_len;
-    char hashstring[EVP_MAX_MD_SIZE * 2 + 1] = "";
+struct hash_stream {
+    EVP_MD_CTX *ctx;
+    int type;
+    size_t total;
+};
 
+visible hash_stream *hash_stream_new(int type) {
     // https://pragmaticjoe.gitlab.io/posts/2015-02-09-how-to-generate-a-sha1-hash-in-c
-    EVP_MD_CTX *mdctx;
     const EVP_MD *md;
     switch (type) {
     case SHA512:
@@ -36,40 +37,82 @@ visible char *calculate_hash(int type, const char *path) {
         md = EVP_md5();
         break;
     }
-    mdctx = EVP_MD_CTX_create();
+    hash_stream *h = calloc(1, sizeof(hash_stream));
+    if (!h) {
+        return NULL;
+    }
+    h->type = type;
+    h->ctx = EVP_MD_CTX_create();
+    if (!h->ctx || EVP_DigestInit_ex(h->ctx, md, NULL) != 1) {
+        if (h->ctx) {
+            EVP_MD_CTX_destroy(h->ctx);
+        }
+        free(h);
+        return NULL;
+    }
+    return h;
+}
 
+visible void hash_stream_update(hash_stream *h, const void *data, size_t len) {
+    if (h) {
+        EVP_DigestUpdate(h->ctx, data, len);
+        h->total += len;
+    }
+}
+
+visible char *hash_stream_final(hash_stream *h) {
+    if (!h) {
+        return NULL;
+    }
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int md_len = 0;
+    char hashstring[EVP_MAX_MD_SIZE * 2 + 1] = "";
+    int type = h->type;
+    stats_add(type == SHA512 ? STATS_BYTES_SHA512 : type == SHA256 ? STATS_BYTES_SHA256 : type == SHA1 ? STATS_BYTES_SHA1 : STATS_BYTES_MD5, h->total);
+    int status = EVP_DigestFinal_ex(h->ctx, digest, &md_len);
+    EVP_MD_CTX_destroy(h->ctx);
+    free(h);
+    if (status != 1) {
+        return NULL;
+    }
+    for (unsigned int i = 0; i < md_len; i++) {
+        sprintf(&hashstring[i * 2], "%02x", (unsigned int) digest[i]);
+    }
+    return strdup(hashstring);
+}
+
+static char *calculate_hash_fn(int type, const char *path) {
+    debug("calculate hash: %d %s\n", type, path);
+    unsigned char buffer[BUFFER_SIZE];
     ssize_t byte = 0;
 
     int fd = open(path, O_RDONLY);
     if (fd < 0) {
         perror("Failed to open file");
-        EVP_MD_CTX_destroy(mdctx);
         return NULL;
     }
-    if (EVP_DigestInit_ex(mdctx, md, NULL) != 1) {
-        EVP_MD_CTX_destroy(mdctx);
+    hash_stream *h = hash_stream_new(type);
+    if (!h) {
         close(fd);
         return NULL;
     }
 
     while ((byte = read(fd, buffer, sizeof(buffer))) > 0) {
-        EVP_DigestUpdate(mdctx, buffer, byte);
-        memset(buffer, 0, BUFFER_SIZE);
+        hash_stream_update(h, buffer, byte);
     }
+    close(fd);
+    char *ret = hash_stream_final(h);
     if (byte < 0) {
         perror("Failed to read file");
-        EVP_MD_CTX_destroy(mdctx);
-        close(fd);
+        free(ret);
         return NULL;
     }
+    return ret;
+}
 
-    EVP_DigestFinal_ex(mdctx, digest, &md_len);
-    EVP_MD_CTX_destroy(mdctx);
-    close(fd);
-    EVP_cleanup();
-    for (unsigned int i = 0; i < md_len; i++) {
-        sprintf(&hashstring[i * 2], "%02x", (unsigned int) digest[i]);
-    }
-
-    return strdup(hashstring);
+visible char *calculate_hash(int type, const char *path) {
+    trace_begin("hash", "%s", path);
+    char *hash = calculate_hash_fn(type, path);
+    trace_end();
+    return hash;
 }
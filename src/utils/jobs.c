@@ -2,44 +2,530 @@
 #include <pthread.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <core/logger.h>
 #include <core/variable.h>
 #include <core/ymp.h>
 #include <sys/sysinfo.h>
 #include <utils/jobs.h>
 
-typedef struct _worker_job {
-    jobs *j;
-    int id;
-} worker_job;
+#define JOBS_MAX_WORKERS 256
+#define JOBS_NET_DEFAULT 8
+#define NO_WORKER SIZE_MAX
 
-static void *worker_thread(void *arg) {
-    worker_job *jb = (worker_job *) arg;
-    jobs *j = jb->j;
-    int i;
-    for (i = jb->id; i < j->total; i += j->parallel) {
-        if (j->failed) {
-            return NULL;
+// Run state of a job set. Each queued entry of a set is a runner that claims
+// jobs by index until the set is exhausted or failed. Sets with dependencies
+// claim jobs from a ready queue instead.
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+    int next;         // next job index to claim
+    size_t unstarted; // runners still queued
+    size_t remaining; // runners not finished, guarded by lock
+
+    int *edges; // (job, dependency) pairs added by jobs_add_after()
+    size_t edge_count;
+    size_t edge_capacity;
+
+    // Dependency graph of a run, guarded by lock
+    pthread_cond_t released; // a job finished or became ready
+    int *waiting;            // unfinished dependencies of each job
+    size_t *first;           // successors of job i are successors[first[i]..first[i + 1]]
+    int *successors;
+    int *ready;              // jobs with no unfinished dependency, in release order
+    int ready_head;
+    int ready_tail;
+    int settled; // jobs finished or failed
+    int active;  // jobs running
+
+    int limit[JOBS_CLASS_MAX]; // class limits of a run
+    unsigned inherited;        // classes held by the thread that started the run
+    unsigned borrowed;         // inherited classes whose slot a job of the run uses
+    VariableManager *options;  // options of the thread that started the run
+} JobsPriv;
+
+// Work-stealing deque. The owner pushes and pops at the tail, other threads
+// steal from the head.
+typedef struct {
+    pthread_mutex_t lock;
+    jobs **items;
+    size_t head;
+    size_t length;
+    size_t capacity;
+} Deque;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    Deque deques[JOBS_MAX_WORKERS];
+    size_t workers;    // started workers, deques below this are initialized
+    size_t queued;     // runners in all deques
+    size_t next_deque; // round robin for submissions from outside the pool
+} pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+};
+
+static __thread size_t current_worker = NO_WORKER;
+
+// Jobs of each class running in the process
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t freed;
+    int running[JOBS_CLASS_MAX];
+} classes = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .freed = PTHREAD_COND_INITIALIZER,
+};
+
+// Class slots used by the jobs the current thread runs, and the ones of them
+// taken from the process wide counts. Nested job sets of the same class
+// borrow the caller's slot.
+static __thread int held[JOBS_CLASS_MAX];
+static __thread int owned[JOBS_CLASS_MAX];
+
+static const char *class_variables[JOBS_CLASS_MAX] = {
+    [JOBS_CLASS_CPU] = "jobs-cpu",
+    [JOBS_CLASS_IO] = "jobs-io",
+    [JOBS_CLASS_NET] = "jobs-net",
+};
+
+static void class_limits_load(JobsPriv *priv) {
+    priv->inherited = 0;
+    priv->borrowed = 0;
+    for (int c = JOBS_CLASS_ANY + 1; c < JOBS_CLASS_MAX; c++) {
+        int limit = 0;
+        if (global) {
+            limit = atoi(variable_get_value(global->variables, class_variables[c]));
+        }
+        if (limit <= 0) {
+            limit = c == JOBS_CLASS_NET ? JOBS_NET_DEFAULT : get_nprocs_conf();
+        }
+        priv->limit[c] = limit;
+        if (held[c] > 0) {
+            priv->inherited |= 1u << c;
+        }
+    }
+}
+
+// A job that does not need a slot of its own. Jobs of a class the caller
+// holds take turns on the caller's slot, one at a time.
+static bool class_borrow(JobsPriv *priv, JobsClass c) {
+    if (c == JOBS_CLASS_ANY) {
+        return true;
+    }
+    unsigned bit = 1u << c;
+    return (priv->inherited & bit) && !(__atomic_fetch_or(&priv->borrowed, bit, __ATOMIC_ACQ_REL) & bit);
+}
+
+// Take a class slot without waiting. Call class_release() after the job.
+static bool class_try_acquire(JobsPriv *priv, JobsClass c, bool *taken) {
+    *taken = false;
+    if (!class_borrow(priv, c)) {
+        pthread_mutex_lock(&classes.lock);
+        if (classes.running[c] >= priv->limit[c]) {
+            pthread_mutex_unlock(&classes.lock);
+            return false;
+        }
+        classes.running[c]++;
+        pthread_mutex_unlock(&classes.lock);
+        owned[c]++;
+        *taken = true;
+    }
+    held[c]++;
+    return true;
+}
+
+static bool class_acquire(JobsPriv *priv, JobsClass c) {
+    bool taken = false;
+    if (!class_borrow(priv, c)) {
+        // Wait for a free slot, or for the caller's slot to be returned
+        pthread_mutex_lock(&classes.lock);
+        for (;;) {
+            if (classes.running[c] < priv->limit[c]) {
+                classes.running[c]++;
+                owned[c]++;
+                taken = true;
+                break;
+            }
+            if (class_borrow(priv, c)) {
+                break;
+            }
+            pthread_cond_wait(&classes.freed, &classes.lock);
+        }
+        pthread_mutex_unlock(&classes.lock);
+    }
+    held[c]++;
+    return taken;
+}
+
+// The caller of a run does not use its slots while it waits. Give back the
+// ones the run does not borrow, jobs of other sets picked up meanwhile take
+// slots of their own. class_reclaim() takes them again.
+static void class_lend(JobsPriv *priv, int *lent, int *saved) {
+    pthread_mutex_lock(&classes.lock);
+    for (int c = 0; c < JOBS_CLASS_MAX; c++) {
+        saved[c] = held[c];
+        lent[c] = (priv->inherited & (1u << c)) ? 0 : owned[c];
+        classes.running[c] -= lent[c];
+        owned[c] -= lent[c];
+        held[c] = 0;
+    }
+    pthread_cond_broadcast(&classes.freed);
+    pthread_mutex_unlock(&classes.lock);
+}
+
+static void class_reclaim(JobsPriv *priv, const int *lent, const int *saved) {
+    pthread_mutex_lock(&classes.lock);
+    for (int c = 0; c < JOBS_CLASS_MAX; c++) {
+        while (lent[c] > 0 && classes.running[c] + lent[c] > priv->limit[c]) {
+            pthread_cond_wait(&classes.freed, &classes.lock);
+        }
+        classes.running[c] += lent[c];
+        owned[c] += lent[c];
+        held[c] = saved[c];
+    }
+    pthread_mutex_unlock(&classes.lock);
+}
+
+static void class_release(JobsPriv *priv, JobsClass c, bool taken) {
+    held[c]--;
+    if (c == JOBS_CLASS_ANY) {
+        return;
+    }
+    pthread_mutex_lock(&classes.lock);
+    if (taken) {
+        owned[c]--;
+        classes.running[c]--;
+    } else {
+        __atomic_and_fetch(&priv->borrowed, ~(1u << c), __ATOMIC_ACQ_REL);
+    }
+    pthread_cond_broadcast(&classes.freed);
+    pthread_mutex_unlock(&classes.lock);
+}
+
+// Run a job within its class slot.
+static int job_call(JobsPriv *priv, job *item, bool taken) {
+    int status = item->call((void *) item->ctx, (void *) item->args);
+    class_release(priv, item->resource, taken);
+    return status;
+}
+
+static bool deque_push(Deque *dq, jobs *task) {
+    pthread_mutex_lock(&dq->lock);
+    if (dq->length == dq->capacity) {
+        size_t capacity = dq->capacity ? dq->capacity * 2 : 16;
+        jobs **items = calloc(capacity, sizeof(jobs *));
+        if (!items) {
+            pthread_mutex_unlock(&dq->lock);
+            return false;
+        }
+        for (size_t i = 0; i < dq->length; i++) {
+            items[i] = dq->items[(dq->head + i) % dq->capacity];
+        }
+        free(dq->items);
+        dq->items = items;
+        dq->capacity = capacity;
+        dq->head = 0;
+    }
+    dq->items[(dq->head + dq->length++) % dq->capacity] = task;
+    pthread_mutex_unlock(&dq->lock);
+    return true;
+}
+
+// A thread waiting for a set only helps with that set and with sets that
+// are not isolated. Idle workers take anything.
+static bool deque_eligible(jobs *task, jobs *helping) {
+    return !helping || task == helping || !task->isolated;
+}
+
+static jobs *deque_take(Deque *dq, bool steal, jobs *helping) {
+    jobs *task = NULL;
+    pthread_mutex_lock(&dq->lock);
+    for (size_t n = 0; n < dq->length; n++) {
+        size_t i = steal ? n : dq->length - 1 - n;
+        task = dq->items[(dq->head + i) % dq->capacity];
+        if (!deque_eligible(task, helping)) {
+            task = NULL;
+            continue;
+        }
+        if (i == 0) {
+            dq->head = (dq->head + 1) % dq->capacity;
+        } else {
+            // Close the gap, the tail moves one down
+            for (size_t k = i; k + 1 < dq->length; k++) {
+                dq->items[(dq->head + k) % dq->capacity] = dq->items[(dq->head + k + 1) % dq->capacity];
+            }
+        }
+        dq->length--;
+        break;
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return task;
+}
+
+// Pop from the own deque, or steal from the others. helping is the set the
+// caller waits for, NULL for idle workers.
+static jobs *pool_take(size_t self, jobs *helping) {
+    if (__atomic_load_n(&pool.queued, __ATOMIC_ACQUIRE) == 0) {
+        return NULL;
+    }
+    jobs *task = NULL;
+    size_t workers = __atomic_load_n(&pool.workers, __ATOMIC_ACQUIRE);
+    if (self != NO_WORKER) {
+        task = deque_take(&pool.deques[self], false, helping);
+    }
+    size_t start = self != NO_WORKER ? self + 1 : 0;
+    for (size_t i = 0; !task && i < workers; i++) {
+        size_t victim = (start + i) % workers;
+        if (victim != self) {
+            task = deque_take(&pool.deques[victim], true, helping);
+        }
+    }
+    if (task) {
+        __atomic_sub_fetch(&pool.queued, 1, __ATOMIC_ACQ_REL);
+    }
+    return task;
+}
+
+// Run ready jobs of a graph. Finished jobs release their successors, a failed
+// job stops the whole set so its dependents never run.
+static void jobs_graph_runner(jobs *j) {
+    JobsPriv *priv = (JobsPriv *) j->priv_data;
+    pthread_mutex_lock(&priv->lock);
+    for (;;) {
+        while (priv->ready_head == priv->ready_tail && priv->settled < j->total &&
+               !__atomic_load_n(&j->failed, __ATOMIC_ACQUIRE)) {
+            if (priv->active == 0) {
+                warning("Job dependency cycle detected\n");
+                __atomic_store_n(&j->failed, true, __ATOMIC_RELEASE);
+                pthread_cond_broadcast(&priv->released);
+                break;
+            }
+            pthread_cond_wait(&priv->released, &priv->lock);
+        }
+        if (priv->ready_head == priv->ready_tail || __atomic_load_n(&j->failed, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+        // Take the oldest ready job whose class has a free slot
+        bool taken = false;
+        int pick = priv->ready_head;
+        while (pick < priv->ready_tail && !class_try_acquire(priv, j->jobs[priv->ready[pick]].resource, &taken)) {
+            pick++;
+        }
+        if (pick == priv->ready_tail) {
+            // Every class is busy, wait for the class of the oldest job
+            JobsClass resource = j->jobs[priv->ready[priv->ready_head]].resource;
+            pthread_mutex_unlock(&priv->lock);
+            taken = class_acquire(priv, resource);
+            pthread_mutex_lock(&priv->lock);
+            for (pick = priv->ready_head; pick < priv->ready_tail; pick++) {
+                if (j->jobs[priv->ready[pick]].resource == resource) {
+                    break;
+                }
+            }
+            if (pick == priv->ready_tail) {
+                // Another runner took it meanwhile
+                pthread_mutex_unlock(&priv->lock);
+                class_release(priv, resource, taken);
+                pthread_mutex_lock(&priv->lock);
+                continue;
+            }
         }
-        if (j->jobs[i].call((void *) j->jobs[i].ctx, (void *) j->jobs[i].args) > 0) {
-            j->failed = true;
-            return NULL;
+        int i = priv->ready[pick];
+        memmove(&priv->ready[priv->ready_head + 1], &priv->ready[priv->ready_head],
+                sizeof(int) * (pick - priv->ready_head));
+        priv->ready_head++;
+        priv->active++;
+        pthread_mutex_unlock(&priv->lock);
+        int status = job_call(priv, &j->jobs[i], taken);
+        pthread_mutex_lock(&priv->lock);
+        priv->active--;
+        priv->settled++;
+        if (status > 0) {
+            __atomic_store_n(&j->failed, true, __ATOMIC_RELEASE);
+        } else {
+            __atomic_add_fetch(&j->finished, 1, __ATOMIC_ACQ_REL);
+            for (size_t e = priv->first[i]; e < priv->first[i + 1]; e++) {
+                int next = priv->successors[e];
+                if (--priv->waiting[next] == 0) {
+                    priv->ready[priv->ready_tail++] = next;
+                }
+            }
         }
-        j->finished++;
+        pthread_cond_broadcast(&priv->released);
+    }
+    pthread_mutex_unlock(&priv->lock);
+}
+
+// Claim and run jobs of a set until it is exhausted or a job fails.
+static void jobs_runner(jobs *j) {
+    JobsPriv *priv = (JobsPriv *) j->priv_data;
+    VariableManager *options = variable_set_options(priv->options);
+    if (__atomic_sub_fetch(&priv->unstarted, 1, __ATOMIC_ACQ_REL) == 0) {
+        // Wake the caller, it stops looking for runners to help with
+        pthread_mutex_lock(&priv->lock);
+        pthread_cond_broadcast(&priv->done);
+        pthread_mutex_unlock(&priv->lock);
+    }
+    if (priv->waiting) {
+        jobs_graph_runner(j);
+    }
+    while (!priv->waiting && !__atomic_load_n(&j->failed, __ATOMIC_ACQUIRE)) {
+        int i = __atomic_fetch_add(&priv->next, 1, __ATOMIC_ACQ_REL);
+        if (i >= j->total) {
+            break;
+        }
+        if (job_call(priv, &j->jobs[i], class_acquire(priv, j->jobs[i].resource)) > 0) {
+            __atomic_store_n(&j->failed, true, __ATOMIC_RELEASE);
+            break;
+        }
+        __atomic_add_fetch(&j->finished, 1, __ATOMIC_ACQ_REL);
+    }
+    (void) variable_set_options(options);
+    pthread_mutex_lock(&priv->lock);
+    if (--priv->remaining == 0) {
+        pthread_cond_broadcast(&priv->done);
+    }
+    pthread_mutex_unlock(&priv->lock);
+}
+
+static void *pool_worker(void *arg) {
+    current_worker = (size_t) arg;
+    for (;;) {
+        jobs *task = pool_take(current_worker, NULL);
+        if (task) {
+            jobs_runner(task);
+            continue;
+        }
+        pthread_mutex_lock(&pool.lock);
+        while (__atomic_load_n(&pool.queued, __ATOMIC_ACQUIRE) == 0) {
+            pthread_cond_wait(&pool.wake, &pool.lock);
+        }
+        pthread_mutex_unlock(&pool.lock);
     }
     return NULL;
 }
 
+// Start workers until the pool has at least count of them.
+static void pool_grow(size_t count) {
+    if (count > JOBS_MAX_WORKERS) {
+        count = JOBS_MAX_WORKERS;
+    }
+    if (__atomic_load_n(&pool.workers, __ATOMIC_ACQUIRE) >= count) {
+        return;
+    }
+    pthread_mutex_lock(&pool.lock);
+    while (pool.workers < count) {
+        size_t id = pool.workers;
+        pthread_mutex_init(&pool.deques[id].lock, NULL);
+        pthread_t thread;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        int status = pthread_create(&thread, &attr, pool_worker, (void *) id);
+        pthread_attr_destroy(&attr);
+        if (status != 0) {
+            warning("Failed to start job worker\n");
+            break;
+        }
+        __atomic_store_n(&pool.workers, id + 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&pool.lock);
+}
+
+// Queue runners of a set. Workers push to their own deque so nested sets stay local.
+static size_t pool_submit(jobs *j, size_t runners) {
+    size_t workers = __atomic_load_n(&pool.workers, __ATOMIC_ACQUIRE);
+    size_t queued = 0;
+    for (size_t i = 0; workers > 0 && i < runners; i++) {
+        size_t target = current_worker;
+        if (target == NO_WORKER) {
+            target = __atomic_fetch_add(&pool.next_deque, 1, __ATOMIC_RELAXED) % workers;
+        }
+        if (!deque_push(&pool.deques[target], j)) {
+            break;
+        }
+        __atomic_add_fetch(&pool.queued, 1, __ATOMIC_ACQ_REL);
+        queued++;
+    }
+    pthread_mutex_lock(&pool.lock);
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+    return queued;
+}
+
+// Build the successor lists and the initial ready queue of a run.
+static bool jobs_graph_prepare(jobs *j) {
+    JobsPriv *priv = (JobsPriv *) j->priv_data;
+    size_t total = j->total;
+    priv->waiting = calloc(total, sizeof(int));
+    priv->first = calloc(total + 1, sizeof(size_t));
+    priv->successors = calloc(priv->edge_count, sizeof(int));
+    priv->ready = calloc(total, sizeof(int));
+    if (!priv->waiting || !priv->first || !priv->successors || !priv->ready) {
+        print(_("Memory allocation failed\n"));
+        return false;
+    }
+    for (size_t e = 0; e < priv->edge_count; e++) {
+        int job_id = priv->edges[e * 2], dep = priv->edges[e * 2 + 1];
+        if (job_id < 0 || job_id >= j->total || dep < 0 || dep >= j->total) {
+            warning("Invalid job dependency: %d -> %d\n", job_id, dep);
+            continue;
+        }
+        priv->waiting[job_id]++;
+        priv->first[dep + 1]++;
+    }
+    for (size_t i = 0; i < total; i++) {
+        priv->first[i + 1] += priv->first[i];
+    }
+    size_t fill[total];
+    memcpy(fill, priv->first, sizeof(fill));
+    for (size_t e = 0; e < priv->edge_count; e++) {
+        int job_id = priv->edges[e * 2], dep = priv->edges[e * 2 + 1];
+        if (job_id >= 0 && job_id < j->total && dep >= 0 && dep < j->total) {
+            priv->successors[fill[dep]++] = job_id;
+        }
+    }
+    priv->ready_head = priv->ready_tail = 0;
+    for (int i = 0; i < j->total; i++) {
+        if (priv->waiting[i] == 0) {
+            priv->ready[priv->ready_tail++] = i;
+        }
+    }
+    priv->settled = priv->active = 0;
+    return true;
+}
+
+static void jobs_graph_free(JobsPriv *priv) {
+    free(priv->waiting);
+    free(priv->first);
+    free(priv->successors);
+    free(priv->ready);
+    priv->waiting = NULL;
+    priv->first = NULL;
+    priv->successors = NULL;
+    priv->ready = NULL;
+}
+
 visible void jobs_unref(jobs *j) {
+    JobsPriv *priv = (JobsPriv *) j->priv_data;
+    jobs_graph_free(priv);
+    free(priv->edges);
+    pthread_mutex_destroy(&priv->lock);
+    pthread_cond_destroy(&priv->done);
+    pthread_cond_destroy(&priv->released);
+    free(priv);
     free(j->jobs);
     pthread_cond_destroy(&j->cond);
     free(j);
 }
 
-visible void jobs_add(jobs *j, callback call, void *ctx, void *args, ...) {
+visible int jobs_add(jobs *j, callback call, void *ctx, void *args, ...) {
     if (j->total >= j->max) {
         j->max += 32;
         j->jobs = (job *) realloc(j->jobs, sizeof(job) * j->max);
@@ -49,31 +535,122 @@ visible void jobs_add(jobs *j, callback call, void *ctx, void *args, ...) {
     new_job.args = args;
     new_job.ctx = ctx;
     new_job.id = j->total;
+    new_job.resource = JOBS_CLASS_ANY;
     j->jobs[j->total++] = new_job;
     j->current++;
-    pthread_cond_signal(&j->cond);
+    return new_job.id;
 }
 
-visible void jobs_run(jobs *j) {
-    pthread_t *threads = (pthread_t *) calloc(j->parallel, sizeof(pthread_t));
-    if (!threads) {
+visible void jobs_add_after(jobs *j, int job_id, const int *deps) {
+    JobsPriv *priv = (JobsPriv *) j->priv_data;
+    for (size_t i = 0; deps && deps[i] != JOBS_END; i++) {
+        if (priv->edge_count >= priv->edge_capacity) {
+            size_t capacity = priv->edge_capacity ? priv->edge_capacity * 2 : 32;
+            int *edges = realloc(priv->edges, sizeof(int) * 2 * capacity);
+            if (!edges) {
+                print(_("Memory allocation failed\n"));
+                return;
+            }
+            priv->edges = edges;
+            priv->edge_capacity = capacity;
+        }
+        priv->edges[priv->edge_count * 2] = job_id;
+        priv->edges[priv->edge_count * 2 + 1] = deps[i];
+        priv->edge_count++;
+    }
+}
+
+visible void jobs_set_class(jobs *j, int job_id, JobsClass resource) {
+    if (job_id < 0 || job_id >= j->total || resource < JOBS_CLASS_ANY || resource >= JOBS_CLASS_MAX) {
+        warning("Invalid job class: %d -> %d\n", job_id, resource);
         return;
     }
-    worker_job *jb[j->parallel];
-    int i;
-    for (i = 0; i < j->parallel; ++i) {
-        jb[i] = (worker_job *) calloc(1, sizeof(worker_job));
-        jb[i]->j = j;
-        jb[i]->id = i;
-        pthread_create(&threads[i], NULL, worker_thread, (void *) jb[i]);
+    j->jobs[job_id].resource = resource;
+}
+
+// Width of a run. A set whose jobs share one limited class never needs more
+// runners than the class allows.
+static size_t jobs_runners(jobs *j) {
+    JobsPriv *priv = (JobsPriv *) j->priv_data;
+    size_t runners = j->parallel < j->total ? (size_t) j->parallel : (size_t) j->total;
+    if (j->total == 0) {
+        return runners;
     }
-    for (i = 0; i < j->parallel; ++i) {
-        pthread_join(threads[i], NULL);
+    JobsClass resource = j->jobs[0].resource;
+    for (int i = 1; i < j->total; i++) {
+        if (j->jobs[i].resource != resource) {
+            return runners;
+        }
     }
-    for (i = 0; i < j->parallel; ++i) {
-        free(jb[i]);
+    if (resource != JOBS_CLASS_ANY && (size_t) priv->limit[resource] < runners) {
+        runners = priv->limit[resource];
     }
-    free(threads);
+    return runners;
+}
+
+static void jobs_run_fn(jobs *j) {
+    JobsPriv *priv = (JobsPriv *) j->priv_data;
+    priv->next = 0;
+    if (priv->edge_count > 0 && j->total > 0 && !jobs_graph_prepare(j)) {
+        jobs_graph_free(priv);
+        j->failed = true;
+        return;
+    }
+    class_limits_load(priv);
+    priv->options = variable_get_options();
+    size_t runners = jobs_runners(j);
+    // Nothing to share, run in the calling thread
+    if (runners <= 1) {
+        priv->unstarted = priv->remaining = 1;
+        jobs_runner(j);
+        jobs_graph_free(priv);
+        return;
+    }
+
+    pool_grow(runners);
+    priv->unstarted = priv->remaining = runners;
+    size_t queued = pool_submit(j, runners);
+    // Runners that could not be queued run here
+    for (; queued < runners; queued++) {
+        jobs_runner(j);
+    }
+
+    // Help while waiting, so jobs that run jobs_run() themselves can not
+    // starve the pool
+    int lent[JOBS_CLASS_MAX], saved[JOBS_CLASS_MAX];
+    class_lend(priv, lent, saved);
+    bool idle = false;
+    for (;;) {
+        pthread_mutex_lock(&priv->lock);
+        if (priv->remaining == 0) {
+            pthread_mutex_unlock(&priv->lock);
+            break;
+        }
+        if (idle || __atomic_load_n(&priv->unstarted, __ATOMIC_ACQUIRE) == 0) {
+            // Every runner is on a thread, or was taken by one that starts it
+            // now. Wait for them to start or finish.
+            pthread_cond_wait(&priv->done, &priv->lock);
+            pthread_mutex_unlock(&priv->lock);
+            idle = false;
+            continue;
+        }
+        pthread_mutex_unlock(&priv->lock);
+        jobs *task = pool_take(current_worker, j);
+        if (task) {
+            jobs_runner(task);
+        }
+        idle = !task;
+    }
+    class_reclaim(priv, lent, saved);
+    jobs_graph_free(priv);
+}
+
+visible void jobs_run(jobs *j) {
+    // Jobs read variables other threads may set meanwhile
+    VariableManager *variables = global ? global->variables : NULL;
+    variable_pin(variables);
+    jobs_run_fn(j);
+    variable_unpin(variables);
 }
 
 visible jobs *jobs_new() {
@@ -81,12 +658,22 @@ visible jobs *jobs_new() {
     if (!j) {
         return NULL;
     }
+    JobsPriv *priv = (JobsPriv *) calloc(1, sizeof(JobsPriv));
+    if (!priv) {
+        free(j);
+        return NULL;
+    }
+    pthread_mutex_init(&priv->lock, NULL);
+    pthread_cond_init(&priv->done, NULL);
+    pthread_cond_init(&priv->released, NULL);
+    j->priv_data = priv;
     j->max = 32;
     j->current = 0;
     j->finished = 0;
     j->total = 0;
     j->parallel = get_nprocs_conf();
     j->failed = false;
+    j->isolated = false;
     j->jobs = (job *) calloc(j->max, sizeof(job));
     pthread_cond_init(&j->cond, NULL);
     return j;
@@ -0,0 +1,100 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include <core/logger.h>
+#include <utils/file.h>
+#include <utils/jobserver.h>
+#include <utils/string.h>
+
+// GNU make understands the FIFO form since 4.4, older ones stop on it.
+// Without make only ninja reads MAKEFLAGS, it understands the FIFO form.
+static bool make_fifo = true;
+static pthread_once_t make_fifo_once = PTHREAD_ONCE_INIT;
+
+static void make_fifo_init() {
+    if (!isfile("/usr/bin/make") && !isfile("/bin/make")) {
+        return;
+    }
+    char *args[] = { "make", "--version", NULL };
+    char *version = getoutput(args);
+    int major = 0, minor = 0;
+    if (version && sscanf(version, "GNU Make %d.%d", &major, &minor) == 2) {
+        make_fifo = major > 4 || (major == 4 && minor >= 4);
+    }
+    free(version);
+}
+
+visible jobserver *jobserver_new(const char *dir, size_t tokens) {
+    jobserver *js = calloc(1, sizeof(jobserver));
+    if (!js) {
+        return NULL;
+    }
+    js->dir = strdup(dir);
+    js->path = build_string("%s/fifo", dir);
+    js->tokens = tokens > 0 ? tokens : 1;
+    js->fd = -1;
+    create_dir(js->dir);
+    // A FIFO left by a crashed run may still hold tokens
+    (void) unlink(js->path);
+    if (mkfifo(js->path, 0600) < 0) {
+        perror("mkfifo");
+        jobserver_unref(js);
+        return NULL;
+    }
+    // A read-write open does not wait for a reader
+    js->fd = open(js->path, O_RDWR | O_CLOEXEC);
+    if (js->fd < 0) {
+        perror(js->path);
+        jobserver_unref(js);
+        return NULL;
+    }
+    char *slots = malloc(js->tokens);
+    if (!slots) {
+        jobserver_unref(js);
+        return NULL;
+    }
+    memset(slots, '+', js->tokens);
+    size_t done = 0;
+    while (done < js->tokens - 1) {
+        ssize_t n = write(js->fd, slots + done, js->tokens - 1 - done);
+        if (n < 0 && errno != EINTR) {
+            perror("Error writing jobserver tokens");
+            break;
+        } else if (n > 0) {
+            done += n;
+        }
+    }
+    free(slots);
+    pthread_once(&make_fifo_once, make_fifo_init);
+    js->fifo = make_fifo;
+    debug("jobserver: %s tokens:%zu fifo:%d\n", js->path, js->tokens, js->fifo);
+    return js;
+}
+
+visible char *jobserver_makeflags(jobserver *js, int fd) {
+    if (js->fifo || fd < 0) {
+        return build_string("-j%zu --jobserver-auth=fifo:%s", js->tokens, js->path);
+    }
+    return build_string("-j%zu --jobserver-auth=%d,%d", js->tokens, fd, fd);
+}
+
+visible void jobserver_unref(jobserver *js) {
+    if (!js) {
+        return;
+    }
+    if (js->fd >= 0) {
+        close(js->fd);
+    }
+    (void) unlink(js->path);
+    (void) rmdir(js->dir);
+    free(js->path);
+    free(js->dir);
+    free(js);
+}
@@ -11,6 +11,8 @@
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+
+#include <core/logger.h>
 #include <utils/error.h>
 
 visible size_t get_epoch() {
@@ -35,39 +37,53 @@ visible void single_instance() {
     }
 }
 visible char *which(char *cmd) {
-    char *fullPath = getenv("PATH");
+    // strtok_r on a copy, PATH must stay intact and callers may run in parallel
+    char *fullPath = strdup(getenv("PATH") ? getenv("PATH") : "");
+    char *saveptr = NULL;
 
     struct stat buffer;
     const char *fileOrDirectory = cmd;
     char *fullfilename = calloc(1024, sizeof(char));
-    if (!fullfilename) {
+    if (!fullfilename || !fullPath) {
+        free(fullfilename);
+        free(fullPath);
         return NULL;
     }
 
-    const char *token = strtok(fullPath, ":");
+    const char *token = strtok_r(fullPath, ":", &saveptr);
 
     /* walk through other tokens */
     while (token != NULL) {
         sprintf(fullfilename, "%s/%s", token, fileOrDirectory);
         int exists = stat(fullfilename, &buffer);
         if (exists == 0 && (S_IFREG & buffer.st_mode)) {
+            free(fullPath);
             return (char *) fullfilename;
         }
 
-        token = strtok(NULL, ":"); /* next token */
+        token = strtok_r(NULL, ":", &saveptr); /* next token */
     }
+    free(fullPath);
     free(fullfilename);
     return strdup(cmd);
 }
 
 extern char **environ;
 visible int run_args(char *args[]) {
+    // Output of the thread may be captured, see logger_set_output()
+    FILE *output = logger_get_output();
+    if (output) {
+        fflush(output);
+    }
     pid_t pid = fork();
     int status = 0;
     if (pid == 0) {
+        if (output) {
+            dup2(fileno(output), STDOUT_FILENO);
+        }
         execv(args[0], args);
         perror("exec failed");
-        exit(EXIT_FAILURE);
+        _exit(EXIT_FAILURE);  // do not flush the parent's stdio buffers
     } else {
         waitpid(pid, &status, 0);
     }
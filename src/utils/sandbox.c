@@ -1,5 +1,8 @@
 #define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
 #include <sched.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,6 +11,9 @@
 #include <core/logger.h>
 #include <core/variable.h>
 #include <sys/mount.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include <utils/file.h>
 #include <utils/sandbox.h>
 #include <utils/string.h>
@@ -21,6 +27,26 @@ static void write_id_map(const char *path, unsigned long id) {
     }
 }
 
+// Remove the empty mount points left in a rootfs. Only empty directories
+// on the same device are removed, never anything a mount may expose.
+static void remove_mount_points(const char *path, dev_t dev) {
+    struct stat st;
+    if (lstat(path, &st) != 0 || !S_ISDIR(st.st_mode) || st.st_dev != dev) {
+        return;
+    }
+    char **items = listdir(path);
+    for (size_t i = 0; items && items[i]; i++) {
+        if (strcmp(items[i], ".") != 0 && strcmp(items[i], "..") != 0) {
+            char *item = build_string("%s/%s", path, items[i]);
+            remove_mount_points(item, dev);
+            free(item);
+        }
+        free(items[i]);
+    }
+    free(items);
+    (void) rmdir(path);
+}
+
 visible sandbox_handle_t *sandbox_new() {
     sandbox_handle_t *sandbox = calloc(1, sizeof(sandbox_handle_t));
     if (!sandbox) {
@@ -31,6 +57,26 @@ visible sandbox_handle_t *sandbox_new() {
     sandbox->uid = getuid();
     sandbox->gid = getgid();
     sandbox->binds = array_new();
+    sandbox->holder = 0;
+    // Unique rootfs, sandboxes of concurrent builds do not share mount points
+    create_dir("/tmp/ymp-root");
+    for (size_t i = 0; i < 8 && !sandbox->root; i++) {
+        char *uuid = generate_uuid();
+        char *root = build_string("/tmp/ymp-root/%s", uuid);
+        free(uuid);
+        if (mkdir(root, 0755) == 0) {
+            sandbox->root = root;
+        } else {
+            free(root);
+        }
+    }
+    if (!sandbox->root) {
+        perror("Failed to create sandbox root");
+        array_unref(sandbox->binds);
+        free(sandbox->hostname);
+        free(sandbox);
+        return NULL;
+    }
     return sandbox;
 }
 
@@ -48,10 +94,10 @@ visible void sandbox_configure_user(sandbox_handle_t *sandbox, uid_t uid, gid_t
     sandbox->gid = gid;
 }
 
-visible void sandbox_apply(sandbox_handle_t *sandbox) {
+// Create the namespaces and mount the rootfs, the caller stays outside of it.
+static void sandbox_setup(sandbox_handle_t *sandbox) {
     // Create the namespaces. Network access shares the host network.
     int flags = sandbox->network ? sandbox->flags & ~CLONE_NEWNET : sandbox->flags;
-    int rc = 0;
     if (unshare(flags) < 0) {
         perror("unshare");
         exit(1);
@@ -75,41 +121,125 @@ visible void sandbox_apply(sandbox_handle_t *sandbox) {
     write_id_map("/proc/self/uid_map", sandbox->uid);
     write_id_map("/proc/self/gid_map", sandbox->gid);
 
-    // New rootfs.
-    create_dir("/tmp/ymp-root");
-    rc = chdir("/tmp/ymp-root");
-    if (rc) {
-        exit(rc);
-    }
-
     // Apply the registered mounts inside the rootfs.
     size_t len = 0;
     char **binds = array_get(sandbox->binds, &len);
     for (size_t i = 0; i < len; i++) {
         char **parts = split(binds[i], " ");
-        char *target = build_string("/tmp/ymp-root%s", parts[1]);
+        char *target = build_string("%s%s", sandbox->root, parts[1]);
+        create_dir(target);
         // A "tmpfs" source is mounted as a fresh tmpfs instead of a bind mount.
         int ret;
         if (strcmp(parts[0], "tmpfs") == 0) {
             ret = mount("tmpfs", target, "tmpfs", 0, NULL);
         } else {
             debug("%s => %s\n", parts[0], target);
-            create_dir(target);
             ret = mount(parts[0], target, NULL, MS_BIND | MS_REC, NULL);
         }
         if (ret < 0) {
             perror("mount");
             warning("Failed to mount: %s\n", target);
-            continue;
         }
         free(target);
         free(binds[i]);
         free(parts);
     }
     free(binds);
+}
+
+// Namespaces a prepared sandbox can join, the user namespace first, it
+// grants the rights to join the others. A pid namespace can not be joined,
+// its init would be the first process of the first phase.
+static const int enter_types[] = { CLONE_NEWUSER, CLONE_NEWNS, CLONE_NEWUTS, CLONE_NEWNET, CLONE_NEWIPC, CLONE_NEWCGROUP };
+static const char *enter_names[] = { "user", "mnt", "uts", "net", "ipc", "cgroup" };
+#define ENTER_COUNT (sizeof(enter_types) / sizeof(enter_types[0]))
+
+// Join the namespaces kept by the holder process.
+static void sandbox_enter(sandbox_handle_t *sandbox) {
+    int flags = sandbox->network ? sandbox->flags & ~CLONE_NEWNET : sandbox->flags;
+    const int *types = enter_types;
+    const char **names = enter_names;
+    for (size_t i = 0; i < ENTER_COUNT; i++) {
+        if (!(flags & types[i])) {
+            continue;
+        }
+        char *path = build_string("/proc/%d/ns/%s", sandbox->holder, names[i]);
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0 || setns(fd, types[i]) < 0) {
+            perror(path);
+            exit(1);
+        }
+        close(fd);
+        free(path);
+    }
+}
+
+visible bool sandbox_prepare(sandbox_handle_t *sandbox) {
+    if (sandbox->holder > 0) {
+        return true;
+    }
+    // Phases set up namespaces that can not be joined themselves
+    int joinable = 0;
+    for (size_t i = 0; i < ENTER_COUNT; i++) {
+        joinable |= enter_types[i];
+    }
+    if (sandbox->flags & ~joinable) {
+        debug("sandbox: flags %x can not be joined\n", sandbox->flags & ~joinable);
+        return false;
+    }
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) < 0) {
+        perror("pipe");
+        return false;
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        // Do not outlive the build
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        sandbox_setup(sandbox);
+        char ready = 1;
+        if (write(fds[1], &ready, 1) != 1) {
+            _exit(1);
+        }
+        close(fds[1]);
+        // Keep the namespaces alive until sandbox_unref()
+        while (true) {
+            pause();
+        }
+    }
+    close(fds[1]);
+    char ready = 0;
+    ssize_t n;
+    do {
+        n = read(fds[0], &ready, 1);
+    } while (n < 0 && errno == EINTR);
+    close(fds[0]);
+    if (n != 1) {
+        (void) waitpid(pid, NULL, 0);
+        warning("Failed to prepare sandbox: %s\n", sandbox->root);
+        return false;
+    }
+    sandbox->holder = pid;
+    return true;
+}
+
+visible void sandbox_apply(sandbox_handle_t *sandbox) {
+    int rc = 0;
+    if (sandbox->holder > 0) {
+        sandbox_enter(sandbox);
+    } else {
+        sandbox_setup(sandbox);
+    }
 
     // Chroot into the rootfs.
-    rc = chroot("/tmp/ymp-root");
+    rc = chroot(sandbox->root);
     if (rc) {
         exit(rc);
     }
@@ -128,6 +258,18 @@ visible void sandbox_configure_network(sandbox_handle_t *sandbox, bool enabled)
 }
 
 visible void sandbox_unref(sandbox_handle_t *sandbox) {
+    if (sandbox->holder > 0) {
+        kill(sandbox->holder, SIGKILL);
+        (void) waitpid(sandbox->holder, NULL, 0);
+    }
+    // The mounts go away with the last process in the namespace, only the
+    // empty mount points created by the holder or by every phase are left
+    // on the host.
+    struct stat st;
+    if (lstat(sandbox->root, &st) == 0) {
+        remove_mount_points(sandbox->root, st.st_dev);
+    }
+    free(sandbox->root);
     free(sandbox->hostname);
     array_unref(sandbox->binds);
     free(sandbox);
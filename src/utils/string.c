@@ -6,6 +6,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/random.h>
 
 #include <core/logger.h>
 #include <utils/array.h>
@@ -100,7 +104,8 @@ visible char *trim(char *content) {
         return NULL;  // Memory allocation failed
     }
 
-    char *line = strtok(trimmed_content, "\n");  // Tokenize the content by new lines
+    char *saveptr = NULL;
+    char *line = strtok_r(trimmed_content, "\n", &saveptr);  // Tokenize the content by new lines
     if (line == NULL) {
         return trimmed_content;  // No content to process
     }
@@ -108,24 +113,19 @@ visible char *trim(char *content) {
     // Determine the number of leading whitespace characters in the first line
     size_t n = count_tab(line);
 
-    // Process the first line
-    if (strlen(line) > n) {
-        memmove(trimmed_content, line + n, strlen(line) - n + 1);  // Trim the first line
-    } else {
-        line[0] = '\0';  // If n is greater than or equal to line length, set line to empty
-    }
-    size_t cur = strlen(line) - n + 1;
-    // Process the remaining lines
-    while ((line = strtok(NULL, "\n")) != NULL) {
-        if (strlen(line) > n) {
-            trimmed_content[cur + 1] = '\n';
-            memmove(trimmed_content + cur + 2, line + n, strlen(line) - n);  // Trim the line
-            cur += strlen(line) - n + 1;
-        } else {
-            line[0] = '\0';  // Set line to empty if n is greater than or equal to line length
+    // Next write position, lines are only moved backwards
+    size_t pos = 0;
+    do {
+        size_t len = strlen(line);
+        if (len > n) {
+            if (pos > 0) {
+                trimmed_content[pos++] = '\n';
+            }
+            memmove(trimmed_content + pos, line + n, len - n);  // Trim the line
+            pos += len - n;
         }
-    }
-    trimmed_content[cur + 1] = '\0';
+    } while ((line = strtok_r(NULL, "\n", &saveptr)) != NULL);
+    trimmed_content[pos] = '\0';
     return trimmed_content;  // Return the trimmed content
 }
 
@@ -313,9 +313,7 @@ visible char **split(const char *data, const char *f) {
     strncpy(word, &data[cur], i - cur);
     word[i - cur] = '\0';
     array_add(a, word);
-    char **ret = array_get(a, &i);
-    array_unref(a);
-    return ret;
+    return array_steal(a, NULL);
 }
 
 visible char *strip(const char *str) {
@@ -358,20 +356,25 @@ visible char *generate_uuid() {
     if (!ret) {
         return NULL;
     }
-    size_t j = 0;
-    srand(time(NULL));
-    for (size_t i = 0; i < 8; i++) {
-        ret[j++] = alphabet[rand() % 16];
-    }
-    ret[j++] = '-';
-    for (size_t k = 0; k < 3; k++) {
-        for (size_t i = 0; i < 4; i++) {
-            ret[j++] = alphabet[rand() % 16];
+    // Random bytes from the kernel, seeding rand() with the time gave
+    // every call of the same second the same uuid
+    unsigned char bytes[16];
+    if (getrandom(bytes, sizeof(bytes), 0) != sizeof(bytes)) {
+        srand(time(NULL) ^ getpid());
+        for (size_t i = 0; i < sizeof(bytes); i++) {
+            bytes[i] = rand() % 256;
         }
-        ret[j++] = '-';
     }
-    for (size_t i = 0; i < 12; i++) {
-        ret[j++] = alphabet[rand() % 16];
+    // Version 4, variant 10
+    bytes[6] = (bytes[6] & 0x0f) | 0x40;
+    bytes[8] = (bytes[8] & 0x3f) | 0x80;
+    size_t j = 0;
+    for (size_t i = 0; i < sizeof(bytes); i++) {
+        if (i == 4 || i == 6 || i == 8 || i == 10) {
+            ret[j++] = '-';
+        }
+        ret[j++] = alphabet[bytes[i] >> 4];
+        ret[j++] = alphabet[bytes[i] & 0x0f];
     }
     return ret;
 }
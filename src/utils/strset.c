@@ -0,0 +1,545 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <core/logger.h>
+#include <core/ymp.h>
+#include <utils/arena.h>
+#include <utils/strset.h>
+
+// Marker for removed slots. Probing continues over it.
+static const char tombstone_key[] = "";
+#define TOMBSTONE ((const char *) tombstone_key)
+
+#define STRSET_MIN_CAPACITY 16
+
+typedef struct {
+    const char *key;
+    void *value;
+    uint32_t hash;
+} strmap_slot;
+
+typedef struct {
+    size_t capacity; // always a power of two
+    size_t used;     // live entries and tombstones
+    strmap_slot slots[];
+} strmap_table;
+
+// Tables and keys which readers may still see. Freed by reclaim() once no
+// lock-free reader is inside the map, or on unref.
+typedef struct strmap_retired {
+    struct strmap_retired *next;
+    void *ptr;
+} strmap_retired;
+
+struct strpool {
+    strmap *map;  // interned strings, keys borrowed from the arena
+    arena *store; // string storage, released at once
+    pthread_mutex_t lock;
+};
+
+visible uint32_t strset_hash(const char *str) {
+    uint32_t hash = 2166136261u;
+    while (*str) {
+        hash ^= (unsigned char) *str++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static strmap_table *table_new(size_t capacity) {
+    strmap_table *table = calloc(1, sizeof(strmap_table) + capacity * sizeof(strmap_slot));
+    if (!table) {
+        print(_("memory allocation failed"));
+        return NULL;
+    }
+    table->capacity = capacity;
+    return table;
+}
+
+// Lock-free reads of STRSET_LOCKED maps are counted, writers free retired
+// memory only when they see no reader. A reader which entered after the
+// memory was unlinked can not reach it any more.
+static void read_begin(strmap *map) {
+    if (map->flags & STRSET_LOCKED) {
+        __atomic_add_fetch(&map->readers, 1, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+}
+
+static void read_end(strmap *map) {
+    if (map->flags & STRSET_LOCKED) {
+        __atomic_sub_fetch(&map->readers, 1, __ATOMIC_RELEASE);
+    }
+}
+
+// Free the retired memory if no reader can see it. Writer lock held.
+static void reclaim(strmap *map) {
+    if (!map->retired) {
+        return;
+    }
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&map->readers, __ATOMIC_ACQUIRE) != 0) {
+        return;
+    }
+    strmap_retired *node = map->retired;
+    map->retired = NULL;
+    while (node) {
+        strmap_retired *next = node->next;
+        free(node->ptr);
+        free(node);
+        node = next;
+    }
+}
+
+static void retire(strmap *map, void *ptr) {
+    strmap_retired *node = malloc(sizeof(strmap_retired));
+    if (!node) {
+        // Leaking is safer than freeing memory a reader may still use
+        return;
+    }
+    node->ptr = ptr;
+    node->next = map->retired;
+    map->retired = node;
+}
+
+// Release memory which is no longer reachable from the current table
+static void release(strmap *map, void *ptr) {
+    if (map->flags & STRSET_LOCKED) {
+        retire(map, ptr);
+    } else {
+        free(ptr);
+    }
+}
+
+static bool owns_keys(strmap *map) {
+    return !(map->flags & (STRSET_INTERN | STRSET_BORROW));
+}
+
+static strmap_slot *table_find(strmap_table *table, const char *key, uint32_t hash) {
+    size_t mask = table->capacity - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        strmap_slot *slot = &table->slots[i];
+        const char *cur = __atomic_load_n(&slot->key, __ATOMIC_ACQUIRE);
+        if (cur == NULL) {
+            return NULL;
+        }
+        if (cur != TOMBSTONE && __atomic_load_n(&slot->hash, __ATOMIC_RELAXED) == hash && strcmp(cur, key) == 0) {
+            return slot;
+        }
+    }
+}
+
+static strmap_table *current_table(strmap *map) {
+    return __atomic_load_n((strmap_table **) &map->table, __ATOMIC_ACQUIRE);
+}
+
+// Copy live entries into a table sized for the current length. Writer lock held.
+static bool table_rehash(strmap *map) {
+    strmap_table *old = map->table;
+    size_t capacity = STRSET_MIN_CAPACITY;
+    while (capacity < (map->length + 1) * 2) {
+        capacity *= 2;
+    }
+    strmap_table *table = table_new(capacity);
+    if (!table) {
+        return false;
+    }
+    size_t mask = capacity - 1;
+    for (size_t i = 0; i < old->capacity; i++) {
+        strmap_slot *slot = &old->slots[i];
+        if (slot->key == NULL || slot->key == TOMBSTONE) {
+            continue;
+        }
+        size_t j = slot->hash & mask;
+        while (table->slots[j].key) {
+            j = (j + 1) & mask;
+        }
+        table->slots[j] = *slot;
+        table->used++;
+    }
+    __atomic_store_n((strmap_table **) &map->table, table, __ATOMIC_RELEASE);
+    release(map, old);
+    return true;
+}
+
+static void map_lock(strmap *map) {
+    if (map->flags & STRSET_LOCKED) {
+        pthread_mutex_lock(&map->lock);
+    }
+}
+
+static void map_unlock(strmap *map) {
+    if (map->flags & STRSET_LOCKED) {
+        reclaim(map);
+        pthread_mutex_unlock(&map->lock);
+    }
+}
+
+// Insert a key. Writer lock held. Returns the stored slot and sets *added for new keys.
+static strmap_slot *map_put(strmap *map, const char *key, void *value, bool replace, bool *added) {
+    uint32_t hash = strset_hash(key);
+    strmap_table *table = map->table;
+    strmap_slot *slot = table_find(table, key, hash);
+    *added = false;
+    if (slot) {
+        if (replace) {
+            __atomic_store_n(&slot->value, value, __ATOMIC_RELEASE);
+        }
+        return slot;
+    }
+    if ((table->used + 1) * 4 > table->capacity * 3) {
+        if (!table_rehash(map)) {
+            return NULL;
+        }
+        table = map->table;
+    }
+    const char *stored = key;
+    if (map->flags & STRSET_INTERN) {
+        stored = strpool_intern(map->pool, key);
+    } else if (owns_keys(map)) {
+        stored = strdup(key);
+    }
+    if (!stored) {
+        print(_("memory allocation failed"));
+        return NULL;
+    }
+    size_t mask = table->capacity - 1;
+    size_t i = hash & mask;
+    // Reuse the first tombstone on the probe path. A lock-free reader may
+    // still be comparing the removed key of a tombstone, so locked maps
+    // only take empty slots and drop tombstones on rehash.
+    bool reuse = !(map->flags & STRSET_LOCKED);
+    while (table->slots[i].key != NULL && !(reuse && table->slots[i].key == TOMBSTONE)) {
+        i = (i + 1) & mask;
+    }
+    slot = &table->slots[i];
+    if (slot->key == NULL) {
+        table->used++;
+    }
+    __atomic_store_n(&slot->hash, hash, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->value, value, __ATOMIC_RELAXED);
+    // Publish the key last so readers never see a half written slot
+    __atomic_store_n(&slot->key, stored, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&map->length, 1, __ATOMIC_RELAXED);
+    *added = true;
+    return slot;
+}
+
+visible strmap *strmap_new_pool(int flags, strpool *pool) {
+    strmap *map = calloc(1, sizeof(strmap));
+    if (!map) {
+        print(_("memory allocation failed"));
+        return NULL;
+    }
+    map->table = table_new(STRSET_MIN_CAPACITY);
+    if (!map->table) {
+        free(map);
+        return NULL;
+    }
+    map->flags = flags;
+    if (pool) {
+        map->flags |= STRSET_INTERN;
+        map->pool = pool;
+    } else if (flags & STRSET_INTERN) {
+        map->pool = strpool_default();
+    }
+    map->lock = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
+    return map;
+}
+
+visible strmap *strmap_new(int flags) {
+    return strmap_new_pool(flags, NULL);
+}
+
+visible void strmap_set(strmap *map, const char *key, void *value) {
+    if (!map || !key) {
+        return;
+    }
+    bool added;
+    map_lock(map);
+    map_put(map, key, value, true, &added);
+    map_unlock(map);
+}
+
+visible void *strmap_get(strmap *map, const char *key) {
+    if (!map || !key) {
+        return NULL;
+    }
+    read_begin(map);
+    void *value = NULL;
+    strmap_slot *slot = table_find(current_table(map), key, strset_hash(key));
+    if (slot) {
+        value = __atomic_load_n(&slot->value, __ATOMIC_ACQUIRE);
+        // Removed meanwhile, the value may already be cleared
+        if (__atomic_load_n(&slot->key, __ATOMIC_ACQUIRE) == TOMBSTONE) {
+            value = NULL;
+        }
+    }
+    read_end(map);
+    return value;
+}
+
+visible const char *strmap_key(strmap *map, const char *key) {
+    if (!map || !key) {
+        return NULL;
+    }
+    read_begin(map);
+    const char *ret = NULL;
+    strmap_slot *slot = table_find(current_table(map), key, strset_hash(key));
+    if (slot) {
+        ret = __atomic_load_n(&slot->key, __ATOMIC_ACQUIRE);
+        if (ret == TOMBSTONE) {
+            ret = NULL;
+        }
+    }
+    read_end(map);
+    return ret;
+}
+
+visible bool strmap_has(strmap *map, const char *key) {
+    return strmap_key(map, key) != NULL;
+}
+
+visible bool strmap_remove(strmap *map, const char *key) {
+    if (!map || !key) {
+        return false;
+    }
+    map_lock(map);
+    strmap_slot *slot = table_find(map->table, key, strset_hash(key));
+    if (!slot) {
+        map_unlock(map);
+        return false;
+    }
+    const char *stored = slot->key;
+    __atomic_store_n(&slot->key, TOMBSTONE, __ATOMIC_RELEASE);
+    __atomic_store_n(&slot->value, NULL, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&map->length, 1, __ATOMIC_RELAXED);
+    if (owns_keys(map)) {
+        release(map, (void *) stored);
+    }
+    map_unlock(map);
+    return true;
+}
+
+visible void strmap_read_begin(strmap *map) {
+    if (map) {
+        read_begin(map);
+    }
+}
+
+visible void strmap_read_end(strmap *map) {
+    if (map) {
+        read_end(map);
+    }
+}
+
+visible void strmap_retire(strmap *map, void *ptr) {
+    if (!map || !ptr) {
+        return;
+    }
+    map_lock(map);
+    release(map, ptr);
+    map_unlock(map);
+}
+
+visible bool strmap_iter(strmap *map, size_t *pos, const char **key, void **value) {
+    if (!map || !pos) {
+        return false;
+    }
+    read_begin(map);
+    bool found = false;
+    strmap_table *table = current_table(map);
+    while (!found && *pos < table->capacity) {
+        strmap_slot *slot = &table->slots[*pos];
+        (*pos)++;
+        const char *cur = __atomic_load_n(&slot->key, __ATOMIC_ACQUIRE);
+        if (cur == NULL || cur == TOMBSTONE) {
+            continue;
+        }
+        if (key) {
+            *key = cur;
+        }
+        if (value) {
+            *value = __atomic_load_n(&slot->value, __ATOMIC_ACQUIRE);
+        }
+        found = true;
+    }
+    read_end(map);
+    return found;
+}
+
+visible size_t strmap_length(const strmap *map) {
+    if (!map) {
+        return 0;
+    }
+    return __atomic_load_n(&map->length, __ATOMIC_RELAXED);
+}
+
+// Free keys owned by a table which is no longer reachable
+static void table_free_keys(strmap *map, strmap_table *table) {
+    if (!owns_keys(map)) {
+        return;
+    }
+    for (size_t i = 0; i < table->capacity; i++) {
+        const char *key = table->slots[i].key;
+        if (key && key != TOMBSTONE) {
+            release(map, (void *) key);
+        }
+    }
+}
+
+visible void strmap_clear(strmap *map) {
+    if (!map) {
+        return;
+    }
+    map_lock(map);
+    strmap_table *table = table_new(STRSET_MIN_CAPACITY);
+    if (!table) {
+        map_unlock(map);
+        return;
+    }
+    strmap_table *old = map->table;
+    __atomic_store_n((strmap_table **) &map->table, table, __ATOMIC_RELEASE);
+    __atomic_store_n(&map->length, 0, __ATOMIC_RELAXED);
+    table_free_keys(map, old);
+    release(map, old);
+    map_unlock(map);
+}
+
+visible void strmap_unref(strmap *map) {
+    if (!map) {
+        return;
+    }
+    // Nothing can read the map any more, free everything directly
+    map->flags &= ~STRSET_LOCKED;
+    table_free_keys(map, map->table);
+    free(map->table);
+    strmap_retired *node = map->retired;
+    while (node) {
+        strmap_retired *next = node->next;
+        free(node->ptr);
+        free(node);
+        node = next;
+    }
+    pthread_mutex_destroy(&map->lock);
+    free(map);
+}
+
+visible strset *strset_new(int flags) {
+    return strmap_new(flags);
+}
+
+visible bool strset_add(strset *set, const char *item) {
+    if (!set || !item) {
+        return false;
+    }
+    bool added;
+    map_lock(set);
+    map_put(set, item, NULL, false, &added);
+    map_unlock(set);
+    return added;
+}
+
+visible bool strset_has(strset *set, const char *item) {
+    return strmap_has(set, item);
+}
+
+visible bool strset_remove(strset *set, const char *item) {
+    return strmap_remove(set, item);
+}
+
+visible const char **strset_get(strset *set, size_t *len) {
+    if (!set) {
+        return NULL;
+    }
+    map_lock(set);
+    const char **ret = calloc(set->length + 1, sizeof(char *));
+    if (!ret) {
+        map_unlock(set);
+        return NULL;
+    }
+    size_t count = 0;
+    size_t pos = 0;
+    const char *key;
+    while (strmap_iter(set, &pos, &key, NULL)) {
+        ret[count++] = key;
+    }
+    ret[count] = NULL;
+    if (len) {
+        *len = count;
+    }
+    map_unlock(set);
+    return ret;
+}
+
+visible size_t strset_length(const strset *set) {
+    return strmap_length(set);
+}
+
+visible void strset_unref(strset *set) {
+    strmap_unref(set);
+}
+
+visible strpool *strpool_new() {
+    strpool *pool = calloc(1, sizeof(strpool));
+    if (!pool) {
+        print(_("memory allocation failed"));
+        return NULL;
+    }
+    pool->map = strmap_new(STRSET_LOCKED | STRSET_BORROW);
+    pool->store = arena_new(0);
+    if (!pool->map || !pool->store) {
+        strmap_unref(pool->map);
+        arena_unref(pool->store);
+        free(pool);
+        return NULL;
+    }
+    pool->lock = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
+    return pool;
+}
+
+static strpool *default_pool = NULL;
+static pthread_once_t default_pool_once = PTHREAD_ONCE_INIT;
+
+static void default_pool_init() {
+    default_pool = strpool_new();
+}
+
+visible strpool *strpool_default() {
+    pthread_once(&default_pool_once, default_pool_init);
+    return default_pool;
+}
+
+visible const char *strpool_intern(strpool *pool, const char *str) {
+    if (!pool || !str) {
+        return NULL;
+    }
+    const char *ret = strmap_key(pool->map, str);
+    if (ret) {
+        return ret;
+    }
+    pthread_mutex_lock(&pool->lock);
+    // Another thread may have added it while we were waiting
+    ret = strmap_key(pool->map, str);
+    if (!ret) {
+        char *copy = arena_strdup(pool->store, str);
+        if (copy) {
+            strmap_set(pool->map, copy, NULL);
+        }
+        ret = copy;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return ret;
+}
+
+visible void strpool_unref(strpool *pool) {
+    if (!pool || pool == default_pool) {
+        return;
+    }
+    strmap_unref(pool->map);
+    arena_unref(pool->store);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
@@ -1,9 +1,11 @@
+#include <ctype.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include <core/logger.h>
+#include <core/stats.h>
 #include <core/ymp.h>
 #include <utils/array.h>
 #include <utils/string.h>
@@ -13,7 +15,9 @@
 visible bool yaml_has_area(const char *data, const char *path) {
     debug("%s\n", path);
     char line[MAX_LINE_LENGTH];
-    FILE *stream = fmemopen((void *) data, strlen(data), "r");
+    size_t data_len = strlen(data);
+    stats_add(STATS_BYTES_YAML, data_len);
+    FILE *stream = fmemopen((void *) data, data_len, "r");
     while (fgets(line, sizeof(line), stream)) {
         if (strncmp(line, path, strlen(path)) == 0 && line[strlen(path)] == ':') {
             fclose(stream);
@@ -30,10 +34,11 @@ visible char *yaml_get_area(const char *data, const char *path) {
     bool in_area = false;
     size_t area_data_size = strlen(data) + 1;
     char area_data[area_data_size];
+    stats_add(STATS_BYTES_YAML, area_data_size - 1);
 
     area_data[0] = '\0';
 
-    FILE *stream = fmemopen((void *) data, strlen(data), "r");
+    FILE *stream = fmemopen((void *) data, area_data_size - 1, "r");
     if (!stream) {
         return NULL;  // Check for stream creation failure
     }
@@ -75,7 +80,9 @@ visible char *yaml_get_value(const char *data, const char *name) {
 
     value[0] = '\0';
 
-    FILE *stream = fmemopen((void *) data, strlen(data), "r");
+    size_t data_len = strlen(data);
+    stats_add(STATS_BYTES_YAML, data_len);
+    FILE *stream = fmemopen((void *) data, data_len, "r");
     if (!stream) {
         return NULL;
     }
@@ -105,19 +112,25 @@ visible char **yaml_get_array(const char *data, const char *name, int *count) {
     FILE *stream = fmemopen(area_data, strlen(area_data), "r");
     while (fgets(line, sizeof(line), stream)) {
         if (line[0] == '-') {
-            char *tmp = strip(line + 2);
-            array_add(a, tmp);
-            free(tmp);
+            // Trim in place so the item is copied only once
+            char *item = line + 2;
+            while (isspace((unsigned char) *item)) {
+                item++;
+            }
+            size_t item_len = strlen(item);
+            while (item_len > 0 && isspace((unsigned char) item[item_len - 1])) {
+                item[--item_len] = '\0';
+            }
+            array_add(a, item);
         }
     }
     fclose(stream);
     free(area_data);
     size_t len;
-    char **ret = array_get(a, &len);
+    char **ret = array_steal(a, &len);
     if (count) {
         *count = len;
     }
-    array_unref(a);
     return ret;
 }
 
@@ -132,7 +145,9 @@ visible char **yaml_get_area_list(const char *fdata, const char *path, int *area
     bool e = false;
     *area_count = 0;
 
-    FILE *stream = fmemopen((void *) fdata, strlen(fdata), "r");
+    size_t data_len = strlen(fdata);
+    stats_add(STATS_BYTES_YAML, data_len);
+    FILE *stream = fmemopen((void *) fdata, data_len, "r");
     while (fgets(line, sizeof(line), stream)) {
         while (line[strlen(line) - 1] == '\n') {
             line[strlen(line) - 1] = '\0';